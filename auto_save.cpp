@@ -0,0 +1,150 @@
+#include "stdafx.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef WINDOWS
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "auto_save.h"
+#include "model.h"
+
+static double getMillis() {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AutoSave::AutoSave(const string& p, const string& s, int slots, int i)
+    : path(p), suffix(s), numSlots(slots), interval(i) {
+  CHECK(numSlots > 0);
+  time_t oldest = 0;
+  for (int slot : Range(numSlots)) {
+    struct stat buf;
+    if (stat(getSlotPath(slot).c_str(), &buf)) {
+      nextSlot = slot;
+      break;
+    }
+    if (slot == 0 || buf.st_mtime < oldest) {
+      nextSlot = slot;
+      oldest = buf.st_mtime;
+    }
+  }
+}
+
+AutoSave::~AutoSave() {
+  wait();
+}
+
+string AutoSave::getSlotPath(int slot) const {
+  return path + convertToString(slot + 1) + suffix;
+}
+
+void AutoSave::update(Model* model) {
+  poll();
+  int turn = model->getTurn();
+  if (lastTurn == -1)
+    lastTurn = turn;
+  else if (turn >= lastTurn + interval) {
+    lastTurn = turn;
+    save(model);
+  }
+}
+
+void AutoSave::save(Model* model) {
+  wait();
+  double time = getMillis();
+  string slotPath = getSlotPath(nextSlot);
+  nextSlot = (nextSlot + 1) % numSlots;
+#ifndef WINDOWS
+  // The child process gets a copy-on-write copy of the model, so the game is only stopped for the fork.
+  // It mustn't run the exit handlers, which would delete the shared state of the parent, like the log file.
+  // The child has only this thread. The pthread_atfork() handlers in util.cpp, profiler.cpp and
+  // view_object.cpp wait for runInParallel() tasks to finish and hold the mutexes during the fork, so
+  // none of them is left locked in the child.
+  writerPid = fork();
+  if (writerPid == 0)
+    _exit(write(model, slotPath) ? 0 : 1);
+  if (writerPid > 0) {
+    finishSave(model, time);
+    return;
+  }
+  Debug() << "Autosave couldn't fork, saving on a thread";
+#endif
+  SaveFile::Snapshot snapshot = SaveFile::snapshot(model, model->getGameType());
+  finishSave(model, time);
+  writer = thread([this, slotPath] (SaveFile::Snapshot snapshot) {
+      write(snapshot, slotPath);
+      lastWriteTime = getMillis() - writeStart;
+  }, std::move(snapshot));
+}
+
+void AutoSave::finishSave(Model* model, double startTime) {
+  writeStart = getMillis();
+  lastStopTime = writeStart - startTime;
+  maxStopTime = max(maxStopTime, lastStopTime);
+  Debug() << "Autosave of turn " << model->getTurn() << " stopped the game for " << lastStopTime << " ms";
+}
+
+// The slot is replaced only when the new save is complete, so that a crash doesn't leave it broken.
+template <class Source>
+bool AutoSave::write(const Source& source, const string& slotPath) {
+  string tmpPath = slotPath + ".tmp";
+  try {
+    writeFile(source, tmpPath);
+  } catch (string s) {
+    Debug() << "Autosave failed: " << s;
+    remove(tmpPath.c_str());
+    return false;
+  }
+  remove(slotPath.c_str());
+  rename(tmpPath.c_str(), slotPath.c_str());
+  return true;
+}
+
+void AutoSave::writeFile(Model* model, const string& path) {
+  SaveFile::save(model, model->getGameType(), path);
+}
+
+void AutoSave::writeFile(const SaveFile::Snapshot& snapshot, const string& path) {
+  SaveFile::write(snapshot, path);
+}
+
+void AutoSave::poll() {
+#ifndef WINDOWS
+  if (writerPid > 0 && waitpid(writerPid, nullptr, WNOHANG) == writerPid) {
+    writerPid = -1;
+    lastWriteTime = getMillis() - writeStart;
+  }
+#endif
+}
+
+void AutoSave::wait() {
+#ifndef WINDOWS
+  if (writerPid > 0) {
+    waitpid(writerPid, nullptr, 0);
+    writerPid = -1;
+    lastWriteTime = getMillis() - writeStart;
+  }
+#endif
+  if (writer.joinable())
+    writer.join();
+}
+
+void AutoSave::removeSlots() {
+  wait();
+  for (int slot : Range(numSlots))
+    remove(getSlotPath(slot).c_str());
+}
+
+double AutoSave::getLastStopTime() const {
+  return lastStopTime;
+}
+
+double AutoSave::getMaxStopTime() const {
+  return maxStopTime;
+}
+
+double AutoSave::getLastWriteTime() const {
+  return lastWriteTime;
+}
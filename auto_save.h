@@ -0,0 +1,69 @@
+#ifndef _AUTO_SAVE_H
+#define _AUTO_SAVE_H
+
+#include "util.h"
+#include "save_file.h"
+
+class Model;
+
+/** Saves the game every few hundred turns, rotating through a few slots, while the game goes on. Where fork()
+  * is available, a child process saves its copy-on-write copy of the model. Otherwise the game is stopped
+  * while the model is serialized into memory, and the snapshot is compressed and written on another thread.*/
+class AutoSave {
+  public:
+  /** The slots are saved in \paramname{path} followed by the slot number and \paramname{suffix}. The first save
+    * goes into a missing slot, or overwrites the oldest one.*/
+  AutoSave(const string& path, const string& suffix, int numSlots = 3, int interval = 500);
+
+  /** Waits until the last save is written.*/
+  ~AutoSave();
+
+  /** Has to be called between the updates of the model. Saves it if \paramname{interval} turns have passed
+    * since the last save, or since the first call.*/
+  void update(Model*);
+
+  /** Takes a snapshot of the model and starts writing it into the next slot. Waits for the previous save
+    * first if it isn't written yet. Mustn't be called from inside runInParallel().*/
+  void save(Model*);
+
+  /** Waits until the last save is written.*/
+  void wait();
+
+  /** Waits for the last save and removes all slots.*/
+  void removeSlots();
+
+  string getSlotPath(int slot) const;
+
+  /** Returns the real time in milliseconds that the game was stopped for by the last save.*/
+  double getLastStopTime() const;
+
+  /** Returns the longest real time in milliseconds that the game was stopped for by a save.*/
+  double getMaxStopTime() const;
+
+  /** Returns the real time in milliseconds that the last save took to be written. Only known after it's
+    * written, which is checked by update() and wait().*/
+  double getLastWriteTime() const;
+
+  private:
+  void finishSave(Model*, double startTime);
+  template <class Source>
+  bool write(const Source&, const string& slotPath);
+  static void writeFile(Model*, const string& path);
+  static void writeFile(const SaveFile::Snapshot&, const string& path);
+  void poll();
+
+  string path;
+  string suffix;
+  int numSlots;
+  int interval;
+  int nextSlot = 0;
+  int lastTurn = -1;
+  thread writer;
+  int writerPid = -1;
+  double writeStart = 0;
+  double lastStopTime = 0;
+  double maxStopTime = 0;
+  double lastWriteTime = 0;
+};
+
+#endif
@@ -0,0 +1,1032 @@
+#include "stdafx.h"
+
+#include <atomic>
+#include <chrono>
+
+#include "debug.h"
+#include "util.h"
+#include "time_queue.h"
+#include "shortest_path.h"
+#include "creature_factory.h"
+#include "tribe.h"
+#include "model.h"
+#include "level.h"
+#include "quest.h"
+#include "statistics.h"
+#include "options.h"
+#include "technology.h"
+#include "collective.h"
+#include "collective_action.h"
+#include "level_maker.h"
+#include "square_factory.h"
+#include "monster_ai.h"
+#include "map_gui.h"
+#include "map_layout.h"
+#include "view_index.h"
+#include "view_object.h"
+#include "map_memory.h"
+
+static double getMillis() {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// All allocations made by the benchmarks are counted, so that they can report how many they make.
+static std::atomic<long long> numAllocations(0);
+
+void* operator new(size_t size) {
+  ++numAllocations;
+  if (void* ret = malloc(size))
+    return ret;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+static void report(const string& name, double millis, int iterations) {
+  std::cout << name << ": " << millis << " ms total, " << 1000000 * millis / iterations << " ns per iteration"
+    << std::endl;
+}
+
+// The time queue used before TimeQueue became an indexed heap, kept as a reference point.
+class LegacyTimeQueue {
+  public:
+  LegacyTimeQueue() : queue([](QElem e1, QElem e2) {
+      return e1.time > e2.time || (e1.time == e2.time && e1.creature->getUniqueId() > e2.creature->getUniqueId());
+  }) {}
+
+  void addCreature(PCreature c) {
+    queue.push({c.get(), c->getTime()});
+    creatures.push_back(std::move(c));
+  }
+
+  PCreature removeCreature(Creature* cRef) {
+    int ind = -1;
+    for (int i : All(creatures))
+      if (creatures[i].get() == cRef) {
+        ind = i;
+        break;
+      }
+    CHECK(ind > -1) << "Creature not found";
+    PCreature ret = std::move(creatures[ind]);
+    creatures.erase(creatures.begin() + ind);
+    dead.insert(ret.get());
+    return ret;
+  }
+
+  Creature* getNextCreature() {
+    removeDead();
+    QElem elem = queue.top();
+    if (elem.time == elem.creature->getTime())
+      return elem.creature;
+    queue.pop();
+    removeDead();
+    queue.push({elem.creature, elem.creature->getTime()});
+    return queue.top().creature;
+  }
+
+  private:
+  void removeDead() {
+    while (!queue.empty() && dead.count(queue.top().creature))
+      queue.pop();
+  }
+
+  struct QElem {
+    Creature* creature;
+    double time;
+  };
+  vector<PCreature> creatures;
+  priority_queue<QElem, vector<QElem>, function<bool(QElem, QElem)>> queue;
+  unordered_set<Creature*> dead;
+};
+
+// Simulates creatures of different speeds taking turns, with one in twenty moves killing a creature
+// and spawning a replacement. Creatures are made up front so that only the queue is measured.
+template <class Queue>
+static void benchmarkTimeQueue(const string& name, int numCreatures, int numMoves) {
+  RandomGen random;
+  random.init(1234);
+  Queue q;
+  vector<PCreature> spare;
+  for (int i : Range(numCreatures + numMoves / 10))
+    spare.push_back(CreatureFactory::fromId(CreatureId::RAT, Tribes::get(TribeId::PEST)));
+  vector<PCreature> graveyard;
+  auto spawn = [&] (double time) {
+    CHECK(!spare.empty());
+    spare.back()->setTime(time + random.getDouble());
+    q.addCreature(std::move(spare.back()));
+    spare.pop_back();
+  };
+  for (int i : Range(numCreatures))
+    spawn(0);
+  double time1 = getMillis();
+  for (int i : Range(numMoves)) {
+    Creature* c = q.getNextCreature();
+    if (random.roll(20)) {
+      graveyard.push_back(q.removeCreature(c));
+      spawn(c->getTime());
+    } else
+      c->setTime(c->getTime() + 0.5 + random.getDouble());
+  }
+  report(name, getMillis() - time1, numMoves);
+}
+
+// The shortest path search used before PathEngine, kept as a reference point. It uses global scratch tables,
+// std::function callbacks and a priority queue that looks up distances on every comparison.
+const int revShortestLimit = 15;
+
+class LegacyShortestPath {
+  public:
+  LegacyShortestPath(Rectangle a, function<double(Vec2)> entryFun, function<double(Vec2)> lengthFun,
+      vector<Vec2> dir, Vec2 to, Vec2 from, double mult = 0) : target(to), directions(dir), bounds(a) {
+    if (mult == 0)
+      init(entryFun, lengthFun, target, from);
+    else {
+      init(entryFun, lengthFun, target, Nothing(), revShortestLimit);
+      setDistance(target, ShortestPath::infinity);
+      reverse(entryFun, lengthFun, mult, from, revShortestLimit);
+    }
+  }
+
+  const vector<Vec2>& getPath() const {
+    return path;
+  }
+
+  private:
+  double getDistance(Vec2 v) const {
+    return dirty[v] < counter ? ShortestPath::infinity : ddist[v];
+  }
+
+  void setDistance(Vec2 v, double d) {
+    ddist[v] = d;
+    dirty[v] = counter;
+  }
+
+  void init(function<double(Vec2)> entryFun, function<double(Vec2)> lengthFun, Vec2 target,
+      Optional<Vec2> from, Optional<int> limit = Nothing()) {
+    ++counter;
+    function<bool(Vec2, Vec2)> comparator;
+    if (from)
+      comparator = [=](Vec2 pos1, Vec2 pos2) {
+        return this->getDistance(pos1) + lengthFun(*from - pos1) > this->getDistance(pos2) + lengthFun(*from - pos2); };
+    else
+      comparator = [this](Vec2 pos1, Vec2 pos2) { return this->getDistance(pos1) > this->getDistance(pos2); };
+    priority_queue<Vec2, vector<Vec2>, decltype(comparator)> q(comparator) ;
+    setDistance(target, 0);
+    q.push(target);
+    while (!q.empty()) {
+      Vec2 pos = q.top();
+      if (from == pos || (limit && getDistance(pos) >= *limit)) {
+        Debug() << "Shortest path from " << (from ? *from : Vec2(-1, -1)) << " to " << target;
+        constructPath(pos);
+        return;
+      }
+      q.pop();
+      for (Vec2 dir : directions) {
+        Vec2 next = pos + dir;
+        if (next.inRectangle(bounds)) {
+          double cdist = getDistance(pos);
+          double ndist = getDistance(next);
+          if (cdist < ndist) {
+            double dist = cdist + entryFun(next);
+            if (dist < ndist) {
+              setDistance(next, dist);
+              q.push(next);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  void reverse(function<double(Vec2)> entryFun, function<double(Vec2)> lengthFun, double mult, Vec2 from,
+      int limit) {
+    function<bool(Vec2, Vec2)> comparator = [=](Vec2 pos1, Vec2 pos2) {
+      return this->getDistance(pos1) + lengthFun(from - pos1) > this->getDistance(pos2) + lengthFun(from - pos2); };
+    priority_queue<Vec2, vector<Vec2>, decltype(comparator)> q(comparator) ;
+    for (Vec2 v : bounds) {
+      double dist = getDistance(v);
+      if (dist <= limit) {
+        setDistance(v, mult * dist);
+        q.push(v);
+      }
+    }
+    while (!q.empty()) {
+      Vec2 pos = q.top();
+      if (from == pos) {
+        Debug() << "Rev shortest path from " << target;
+        constructPath(pos, true);
+        return;
+      }
+      q.pop();
+      for (Vec2 dir : directions)
+        if ((pos + dir).inRectangle(bounds)) {
+          if (getDistance(pos + dir) > getDistance(pos) + entryFun(pos + dir) && getDistance(pos + dir) < 0) {
+            setDistance(pos + dir, getDistance(pos) + entryFun(pos + dir));
+            q.push(pos + dir);
+          }
+        }
+    }
+  }
+
+  void constructPath(Vec2 pos, bool reversed = false) {
+    vector<Vec2> ret;
+    while (pos != target) {
+      Vec2 next;
+      double lowest = getDistance(pos);
+      for (Vec2 dir : directions) {
+        double dist;
+        if ((pos + dir).inRectangle(bounds) && (dist = getDistance(pos + dir)) < lowest) {
+          lowest = dist;
+          next = pos + dir;
+        }
+      }
+      if (lowest >= getDistance(pos))
+        break;
+      ret.push_back(pos);
+      pos = next;
+    }
+    if (!reversed)
+      ret.push_back(target);
+    path = vector<Vec2>(ret.rbegin(), ret.rend());
+  }
+
+  static Table<double> ddist;
+  static Table<int> dirty;
+  static int counter;
+  vector<Vec2> path;
+  Vec2 target;
+  vector<Vec2> directions;
+  Rectangle bounds;
+};
+
+Table<double> LegacyShortestPath::ddist(600, 600);
+Table<int> LegacyShortestPath::dirty(600, 600, 0);
+int LegacyShortestPath::counter = 1;
+
+struct PathQuery {
+  Rectangle bounds;
+  vector<Vec2> directions;
+  Vec2 target;
+  Vec2 from;
+  double mult;
+  bool road;
+};
+
+// Generates queries similar to the ones made when building roads on the top level, and by creatures
+// walking towards or running away from something.
+static vector<PathQuery> getPathQueries(RandomGen& random, Rectangle area) {
+  vector<PathQuery> ret;
+  auto randomPos = [&] (Rectangle r) {
+    return Vec2(random.getRandom(r.getPX(), r.getKX()), random.getRandom(r.getPY(), r.getKY())); };
+  for (int i : Range(20))
+    ret.push_back({area, Vec2::directions4(), randomPos(area), randomPos(area), 0, true});
+  for (int i : Range(300)) {
+    Vec2 from = randomPos(area);
+    Vec2 to = randomPos(Rectangle(from - Vec2(40, 40), from + Vec2(40, 40)).intersection(area));
+    if (i % 5 > 0)
+      ret.push_back({area, Vec2::directions8(), to, from, 0, false});
+    else {
+      Rectangle bounds = area.intersection(Rectangle(min(to.x, from.x) - 15, min(to.y, from.y) - 15,
+          max(to.x, from.x) + 15, max(to.y, from.y) + 15));
+      ret.push_back({bounds, Vec2::directions8(), to, from, -1.5, false});
+    }
+  }
+  return ret;
+}
+
+static void benchmarkShortestPath() {
+  RandomGen random;
+  random.init(1234);
+  Rectangle area(600, 600);
+  Table<double> height(area);
+  Table<bool> blocked(area);
+  for (Vec2 v : area) {
+    height[v] = random.getDouble();
+    blocked[v] = random.roll(8);
+  }
+  vector<PathQuery> queries = getPathQueries(random, area);
+  for (PathQuery& q : queries)
+    blocked[q.target] = blocked[q.from] = false;
+  auto roadCost = [&] (Vec2 v) { return blocked[v] ? ShortestPath::infinity : 1 + pow(1 + height[v], 2); };
+  auto walkCost = [&] (Vec2 v) { return blocked[v] ? ShortestPath::infinity : 1.0; };
+  auto roadLength = [] (Vec2 v)->double { return v.length4(); };
+  auto fastLength = [] (Vec2 v)->double { return 2 * v.lengthD(); };
+  auto walkLength = [] (Vec2 v)->double { return v.length8(); };
+  int total = 0;
+  double time1 = getMillis();
+  for (PathQuery& q : queries)
+    if (q.road)
+      total += LegacyShortestPath(q.bounds, roadCost, roadLength, q.directions, q.target, q.from).getPath().size();
+    else
+      total += LegacyShortestPath(q.bounds, walkCost, q.mult == 0 ? fastLength : walkLength, q.directions,
+          q.target, q.from, q.mult).getPath().size();
+  report("legacy shortest path (total length " + convertToString(total) + ")", getMillis() - time1,
+      queries.size());
+  total = 0;
+  time1 = getMillis();
+  for (PathQuery& q : queries)
+    if (q.road)
+      total += ShortestPath(q.bounds, roadCost, roadLength, q.directions, q.target, q.from).getLength();
+    else if (q.mult == 0)
+      total += ShortestPath(q.bounds, walkCost, fastLength, q.directions, q.target, q.from).getLength();
+    else
+      total += ShortestPath(q.bounds, walkCost, walkLength, q.directions, q.target, q.from, q.mult).getLength();
+  report("path engine (total length " + convertToString(total) + ")", getMillis() - time1, queries.size());
+}
+
+// The visibility calculation used before OpacityMap, kept as a reference point. It reads every square
+// through std::function callbacks and stores the result in a char array.
+class LegacyVisibility {
+  public:
+  LegacyVisibility(const Table<PSquare>& squares, int x, int y) : px(x), py(y) {
+    memset(visible, 0, (2 * sightRange + 1) * (2 * sightRange + 1));
+    calculate(2 * sightRange, 2 * sightRange,2 * sightRange, 2,-1,1,1,1,
+        [&](int px, int py) { return !squares[x + px][y + py]->canSeeThru(); },
+        [&](int px, int py) { setVisible(px ,py); });
+    calculate(2 * sightRange, 2 * sightRange,2 * sightRange, 2,-1,1,1,1,
+        [&](int px, int py) { return !squares[x + py][y - px]->canSeeThru(); },
+        [&](int px, int py) { setVisible(py, -px); });
+    calculate(2 * sightRange, 2 * sightRange,2 * sightRange,2,-1,1,1,1,
+        [&](int px, int py) { return !squares[x - px][y - py]->canSeeThru(); },
+        [&](int px, int py) { setVisible(-px, -py); });
+    calculate(2 * sightRange, 2 * sightRange,2 * sightRange,2,-1,1,1,1,
+        [&](int px, int py) { return !squares[x - py][y + px]->canSeeThru(); },
+        [&](int px, int py) { setVisible(-py, px); });
+    setVisible(0, 0);
+  }
+
+  const vector<Vec2>& getVisibleTiles() const {
+    return visibleTiles;
+  }
+
+  static const int sightRange = 30;
+
+  private:
+  void setVisible(int x, int y) {
+    if (!visible[x + sightRange][y + sightRange] && x * x + y * y <= sightRange * sightRange) {
+      visible[x + sightRange][y + sightRange] = 1;
+      visibleTiles.push_back(Vec2(px + x, py + y));
+    }
+  }
+
+  void calculate(int left, int right, int up, int h, int x1, int y1, int x2, int y2,
+      function<bool (int, int)> isBlocking, function<void (int, int)> setVisible){
+    if (y2*x1>=y1*x2) return;
+    if (h>up) return;
+    int leftx=x1, lefty=y1, rightx=x2, righty=y2;
+    int left_v=(int)floor((double)x1/y1*(h)), 
+        right_v=(int)ceil((double)x2/y2*(h)),
+        left_b=(int)floor((double)x1/y1*(h-1));
+    if (left_v % 2)
+      ++left_v;
+    if (right_v % 2)
+      --right_v;
+    if(left_b % 2)
+      ++left_b;
+    if(left_b>=-left && left_b<=right && isBlocking(left_b/2,h/2)){
+      leftx=left_b+1;
+      lefty=h+(left_b>=0?-1:1);
+    }
+    if(left_v<-left) left_v=-left;
+    if(right_v>right) right_v=right;
+    bool prevBlocking = false;
+    for (int i=left_v/2;i<=right_v/2;++i){
+      setVisible(i, h / 2);
+      bool blocking = isBlocking(i, h / 2);
+      if(i > left_v / 2 && blocking && !prevBlocking)
+        calculate(left, right, up, h + 2, leftx, lefty, i * 2 - 1, h + (i<=0 ? -1:1), isBlocking, setVisible);
+      if(blocking){
+        leftx=i*2+1;
+        lefty=h+(i>=0?-1:1);
+      }
+      prevBlocking = blocking;
+    }
+    calculate(left, right, up, h + 2, leftx, lefty, rightx, righty, isBlocking, setVisible);
+  }
+
+  char visible[sightRange * 2 + 1][sightRange * 2 + 1];
+  vector<Vec2> visibleTiles;
+  int px;
+  int py;
+};
+
+static void benchmarkFieldOfView(const string& name, const vector<Vec2>& origins, const Table<PSquare>& squares,
+    const OpacityMap& opacity) {
+  int total = 0;
+  double time1 = getMillis();
+  for (Vec2 v : origins)
+    total += LegacyVisibility(squares, v.x, v.y).getVisibleTiles().size();
+  report("legacy field of view, " + name + " (" + convertToString(origins.size()) + " squares, "
+      + convertToString(total) + " visible)", getMillis() - time1, origins.size());
+  total = 0;
+  FieldOfView fov(opacity);
+  time1 = getMillis();
+  for (Vec2 v : origins)
+    total += fov.getVisibleTiles(v).size();
+  report("bitmap field of view, " + name + " (" + convertToString(origins.size()) + " squares, "
+      + convertToString(total) + " visible)", getMillis() - time1, origins.size());
+  for (Vec2 v : origins) {
+    vector<Vec2> legacy = LegacyVisibility(squares, v.x, v.y).getVisibleTiles();
+    vector<Vec2> current = fov.getVisibleTiles(v);
+    sort(legacy.begin(), legacy.end());
+    sort(current.begin(), current.end());
+    CHECK(legacy == current) << "Field of view differs at " << v;
+  }
+}
+
+// Creatures wandering around open ground and looking around, with different limits on the number
+// of cached results.
+static void benchmarkVisibilityCache(const OpacityMap& opacity, const vector<Vec2>& ground) {
+  for (int cacheSize : {256, 1024, FieldOfView::defaultCacheSize, 100000}) {
+    RandomGen random;
+    random.init(1234);
+    FieldOfView fov(opacity, cacheSize);
+    vector<Vec2> walkers;
+    for (int i : Range(300))
+      walkers.push_back(ground[random.getRandom(ground.size())]);
+    int numSeen = 0;
+    double time1 = getMillis();
+    for (int turn : Range(300))
+      for (Vec2& pos : walkers) {
+        Vec2 next = pos + Vec2::directions8()[random.getRandom(8)];
+        if (next.inRectangle(Rectangle(opacity.getWidth(), opacity.getHeight()).minusMargin(1))
+            && !opacity.isOpaque(next))
+          pos = next;
+        for (int i : Range(5))
+          if (fov.canSee(pos, pos + Vec2(random.getRandom(-20, 21), random.getRandom(-20, 21))))
+            ++numSeen;
+      }
+    report("visibility cache of " + convertToString(cacheSize) + " (" + convertToString(fov.getNumHits())
+        + " hits, " + convertToString(fov.getNumMisses()) + " misses, " + convertToString(fov.getNumCached())
+        + " cached, " + convertToString(numSeen) + " seen)", getMillis() - time1, 300 * walkers.size() * 5);
+  }
+}
+
+// The cache used before the reverse index. A changed square computes its own visibility to find
+// the results that could see it.
+class LegacyFieldOfView {
+  public:
+  LegacyFieldOfView(const Table<PSquare>& s) : squares(s), visibility(s.getBounds()) {}
+
+  bool canSee(Vec2 from, Vec2 to) {
+    const vector<Vec2>& tiles = getVisibility(from).getVisibleTiles();
+    return std::find(tiles.begin(), tiles.end(), to) != tiles.end();
+  }
+
+  void squareChanged(Vec2 pos) {
+    for (Vec2 v : getVisibility(pos).getVisibleTiles())
+      if (visibility[v] && canSee(v, pos))
+        visibility[v] = Nothing();
+  }
+
+  private:
+  const LegacyVisibility& getVisibility(Vec2 from) {
+    if (!visibility[from])
+      visibility[from] = LegacyVisibility(squares, from.x, from.y);
+    return *visibility[from];
+  }
+
+  const Table<PSquare>& squares;
+  Table<Optional<LegacyVisibility>> visibility;
+};
+
+// Imps digging out a mountain, three squares a turn, closest to the start first, while creatures
+// around them keep looking at the squares being dug.
+static void benchmarkDigging(Table<PSquare>& squares, OpacityMap& opacity, Vec2 start) {
+  const int range = LegacyVisibility::sightRange;
+  Rectangle area = Rectangle(start - Vec2(range, range), start + Vec2(range, range))
+      .intersection(squares.getBounds().minusMargin(range + 1));
+  vector<Vec2> toDig;
+  for (Vec2 v : area)
+    if (opacity.isOpaque(v))
+      toDig.push_back(v);
+  sort(toDig.begin(), toDig.end(), [&](Vec2 a, Vec2 b) { return (a - start).lengthD() < (b - start).lengthD(); });
+  const int numTurns = 200;
+  const int perTurn = 3;
+  toDig.resize(min<int>(toDig.size(), numTurns * perTurn));
+  int numQueries = 0;
+  auto run = [&] (function<bool(Vec2, Vec2)> canSee, function<void(Vec2)> dig) {
+    RandomGen random;
+    random.init(1234);
+    vector<Vec2> walkers(30, start);
+    int numSeen = 0;
+    numQueries = 0;
+    for (int turn : Range((toDig.size() + perTurn - 1) / perTurn)) {
+      for (int i = turn * perTurn; i < toDig.size() && i < (turn + 1) * perTurn; ++i)
+        dig(toDig[i]);
+      for (Vec2& pos : walkers) {
+        Vec2 next = pos + Vec2::directions8()[random.getRandom(8)];
+        if (next.inRectangle(area) && !opacity.isOpaque(next))
+          pos = next;
+        for (int i = turn * perTurn; i < toDig.size() && i < (turn + 1) * perTurn; ++i) {
+          ++numQueries;
+          if (canSee(pos, toDig[i]))
+            ++numSeen;
+        }
+      }
+    }
+    return numSeen;
+  };
+  FieldOfView fov(opacity);
+  double time1 = getMillis();
+  int numSeen = run([&] (Vec2 from, Vec2 to) { return fov.canSee(from, to); },
+      [&] (Vec2 pos) { opacity.setOpaque(pos, false); fov.squareChanged(pos); });
+  report("digging with batched invalidation (" + convertToString(toDig.size()) + " dug, "
+      + convertToString(numSeen) + " seen, " + convertToString(fov.getNumMisses()) + " misses)",
+      getMillis() - time1, numQueries);
+  for (Vec2 v : toDig)
+    opacity.setOpaque(v, true);
+  LegacyFieldOfView legacy(squares);
+  time1 = getMillis();
+  int legacySeen = run([&] (Vec2 from, Vec2 to) { return legacy.canSee(from, to); },
+      [&] (Vec2 pos) {
+          opacity.setOpaque(pos, false);
+          squares[pos].reset(SquareFactory::get(SquareType::FLOOR));
+          legacy.squareChanged(pos); });
+  report("digging with legacy invalidation (" + convertToString(legacySeen) + " seen)",
+      getMillis() - time1, numQueries);
+  // Visibility isn't symmetric, so probing from the changed square can miss some stale results.
+  // The batched version is compared with results computed from scratch instead.
+  for (Vec2 v : toDig)
+    opacity.setOpaque(v, true);
+  int exactSeen = run([&] (Vec2 from, Vec2 to) { return FieldOfView(opacity, 1).canSee(from, to); },
+      [&] (Vec2 pos) { opacity.setOpaque(pos, false); });
+  CHECK(numSeen == exactSeen) << numSeen << " " << exactSeen;
+}
+
+// Computes visibility from every floor square of a level, and from every fourth square of open ground,
+// away from the edges, where the legacy version would read outside the level.
+static void benchmarkFieldOfView(Level* level) {
+  const int range = LegacyVisibility::sightRange;
+  Table<PSquare> squares(level->getBounds());
+  OpacityMap opacity(level->getWidth(), level->getHeight());
+  vector<Vec2> floor, ground;
+  for (Vec2 v : level->getBounds()) {
+    const Square* square = level->getSquare(v);
+    // Stand-ins with the same transparency, because the level's squares are private.
+    squares[v].reset(SquareFactory::get(square->canSeeThru() ? SquareType::FLOOR : SquareType::ROCK_WALL));
+    opacity.setOpaque(v, !square->canSeeThru());
+    if (!v.inRectangle(level->getBounds().minusMargin(range + 1)))
+      continue;
+    if (square->getName() == "floor")
+      floor.push_back(v);
+    else if (square->canSeeThru() && square->canEnterEmpty(Creature::getDefault()) && v.x % 4 == 0 && v.y % 4 == 0)
+      ground.push_back(v);
+  }
+  benchmarkFieldOfView("dungeon floor", floor, squares, opacity);
+  benchmarkFieldOfView("open ground", ground, squares, opacity);
+  benchmarkVisibilityCache(opacity, ground);
+  if (!floor.empty())
+    benchmarkDigging(squares, opacity, floor[floor.size() / 2]);
+}
+
+// Same initialization as in main.cpp. Needs the data files in the working directory.
+static void initGame() {
+  Random.init(1234);
+  Item::identifyEverything();
+  Quests::clearAll();
+  Creature::initialize();
+  Tribes::clearAll();
+  Technology::clearAll();
+  EventListener::initialize();
+  Tribe::init();
+  Technology::init();
+  Statistics::init();
+  Options::init("options.txt");
+  NameGenerator::init("first_names.txt", "aztec_names.txt", "creatures.txt",
+      "artifacts.txt", "world.txt", "town_names.txt", "dwarfs.txt", "gods.txt", "demons.txt", "dogs.txt",
+      "insults.txt");
+  ItemFactory::init();
+}
+
+// Finds long paths on a generated top level, once with an exact search to the target, and once by following
+// the waypoints of the level's cluster graph, one segment at a time.
+static void benchmarkLongPaths(Level* level) {
+  RandomGen random;
+  random.init(1234);
+  const Creature* walker = Creature::getDefault();
+  vector<Vec2> passable;
+  for (Vec2 v : level->getBounds())
+    if (level->getSquare(v)->canEnterEmpty(walker))
+      passable.push_back(v);
+  vector<pair<Vec2, Vec2>> queries;
+  while (queries.size() < 100) {
+    Vec2 from = passable[random.getRandom(passable.size())];
+    Vec2 to = passable[random.getRandom(passable.size())];
+    if (from.dist8(to) > 100)
+      queries.push_back({from, to});
+  }
+  auto entryFun = [&] (Vec2 v) { return level->getSquare(v)->canEnterEmpty(walker) ? 1.0 : ShortestPath::infinity; };
+  auto lengthFun = [] (Vec2 v)->double { return 2 * v.lengthD(); };
+  int total = 0;
+  double time1 = getMillis();
+  for (auto& q : queries)
+    total += ShortestPath(level->getBounds(), entryFun, lengthFun, Vec2::directions8(), q.second, q.first)
+        .getLength();
+  report("exact long paths (total length " + convertToString(total) + ")", getMillis() - time1, queries.size());
+  time1 = getMillis();
+  // Builds the cluster graph of the whole level.
+  for (auto& q : queries)
+    level->getWaypoint(q.first, q.second);
+  report("cluster graph build and first waypoints", getMillis() - time1, queries.size());
+  total = 0;
+  int segments = 0;
+  double firstSegment = 0;
+  time1 = getMillis();
+  for (auto& q : queries) {
+    Vec2 pos = q.first;
+    while (pos != q.second) {
+      double time2 = getMillis();
+      Optional<Vec2> waypoint = level->getWaypoint(pos, q.second);
+      Vec2 to = waypoint ? *waypoint : q.second;
+      ShortestPath path(level->getBounds(), entryFun, lengthFun, Vec2::directions8(), to, pos);
+      if (pos == q.first)
+        firstSegment += getMillis() - time2;
+      if (path.getLength() < 2)
+        break;
+      total += path.getLength() - 1;
+      ++segments;
+      pos = to;
+    }
+  }
+  report("hierarchical long paths (total length " + convertToString(total) + ", "
+      + convertToString(segments) + " segments)", getMillis() - time1, queries.size());
+  report("hierarchical long paths, first segment only", firstSegment, queries.size());
+}
+
+// Many creatures of the same kind taking a step towards a common destination, first each with its own
+// search, then all with one flow field.
+static void benchmarkFlowField(Level* level) {
+  RandomGen random;
+  random.init(1234);
+  Vec2 center;
+  for (Creature* c : level->getAllCreatures())
+    if (c->getTribe() == Tribes::get(TribeId::KEEPER)) {
+      center = c->getPosition();
+      break;
+    }
+  Rectangle area = Rectangle(center - Vec2(50, 50), center + Vec2(50, 50)).intersection(level->getBounds());
+  vector<Vec2> free;
+  for (Vec2 v : area)
+    if (level->getSquare(v)->canEnter(Creature::getDefault()))
+      free.push_back(v);
+  random_shuffle(free.begin(), free.end(), [&](int n) { return random.getRandom(n); });
+  vector<Creature*> creatures;
+  for (int i : Range(150)) {
+    PCreature c = CreatureFactory::fromId(CreatureId::GOBLIN, Tribes::get(TribeId::KEEPER));
+    creatures.push_back(c.get());
+    level->addCreature(free[i], std::move(c));
+  }
+  vector<Vec2> targets(free.begin() + 150, free.begin() + 170);
+  int numMoves = 0;
+  double time1 = getMillis();
+  for (Vec2 target : targets)
+    for (Creature* c : creatures)
+      if (ShortestPath(level, c, target, c->getPosition()).isReachable(c->getPosition()))
+        ++numMoves;
+  report("separate searches (" + convertToString(numMoves) + " paths found)", getMillis() - time1,
+      targets.size() * creatures.size());
+  numMoves = 0;
+  time1 = getMillis();
+  for (Vec2 target : targets)
+    for (Creature* c : creatures)
+      if (c->getSharedMoveTowards({target}))
+        ++numMoves;
+  report("shared flow field (" + convertToString(numMoves) + " moves)", getMillis() - time1,
+      targets.size() * creatures.size());
+}
+
+// Flood fills from the keeper's position over squares that a creature can enter, like Collective::tick does,
+// first asking the squares, then the level's passability table.
+static void benchmarkPassability(Level* level) {
+  const Creature* walker = Creature::getDefault();
+  Vec2 start;
+  for (Creature* c : level->getAllCreatures())
+    if (c->getTribe() == Tribes::get(TribeId::KEEPER)) {
+      start = c->getPosition();
+      break;
+    }
+  const int numFills = 20;
+  auto fill = [&] (function<bool(Vec2)> passable) {
+    Table<bool> visited(level->getBounds(), false);
+    vector<Vec2> queue {start};
+    visited[start] = true;
+    for (int i = 0; i < queue.size(); ++i)
+      for (Vec2 v : queue[i].neighbors8())
+        if (v.inRectangle(level->getBounds()) && !visited[v] && passable(v)) {
+          visited[v] = true;
+          queue.push_back(v);
+        }
+    return queue.size();
+  };
+  int numSquares = 0;
+  double time1 = getMillis();
+  for (int i : Range(numFills))
+    numSquares = fill([&] (Vec2 v) { return level->getSquare(v)->canEnterEmpty(walker); });
+  report("flood fill through squares (" + convertToString(numSquares) + " squares)", getMillis() - time1,
+      numFills * numSquares);
+  Level::Passability movement = level->getPassability(walker);
+  time1 = getMillis();
+  for (int i : Range(numFills))
+    CHECK(fill([&] (Vec2 v) { return movement.canEnterEmpty(v); }) == numSquares);
+  report("flood fill through passability table", getMillis() - time1, numFills * numSquares);
+}
+
+// Every creature on a crowded level looks for visible enemies, first by checking all creatures on the level,
+// then through the level's creature index.
+static void benchmarkVisibleEnemies(Level* level) {
+  RandomGen random;
+  random.init(1234);
+  vector<Vec2> free;
+  for (Vec2 v : level->getBounds())
+    if (level->getSquare(v)->canEnter(Creature::getDefault()))
+      free.push_back(v);
+  random_shuffle(free.begin(), free.end(), [&](int n) { return random.getRandom(n); });
+  for (int i : Range(1000))
+    level->addCreature(free[i], CreatureFactory::fromId(i % 2 ? CreatureId::GOBLIN : CreatureId::BANDIT,
+        Tribes::get(i % 2 ? TribeId::KEEPER : TribeId::BANDIT)));
+  vector<Creature*> creatures = level->getAllCreatures();
+  int numLegacy = 0;
+  double time1 = getMillis();
+  for (Creature* c : creatures) {
+    vector<const Creature*> enemies;
+    for (const Creature* other : level->getAllCreatures())
+      if (c->isEnemy(other) && c->canSee(other))
+        enemies.push_back(other);
+    for (const Creature* other : c->getUnknownAttacker())
+      if (!contains(enemies, other))
+        enemies.push_back(other);
+    numLegacy += enemies.size();
+  }
+  report("visible enemies, all creatures checked (" + convertToString(creatures.size()) + " creatures)",
+      getMillis() - time1, creatures.size());
+  int numIndexed = 0;
+  time1 = getMillis();
+  for (Creature* c : creatures) {
+    c->updateVisibleEnemies();
+    numIndexed += c->getVisibleEnemies().size();
+  }
+  report("visible enemies, creature index (" + convertToString(numIndexed) + " seen)", getMillis() - time1,
+      creatures.size());
+  CHECK(numLegacy == numIndexed) << numLegacy << " " << numIndexed;
+}
+
+// The squares around a creature that a map view shows, while creatures walk around the level between frames.
+// Computing them all every frame is compared to computing only the ones that may look different.
+static void benchmarkViewRefresh(Level* level) {
+  const int numFrames = 100;
+  RandomGen random;
+  random.init(1234);
+  vector<Creature*> creatures = level->getAllCreatures();
+  const Creature* viewer = creatures[0];
+  Rectangle area = Rectangle(viewer->getPosition() - Vec2(40, 25), viewer->getPosition() + Vec2(40, 25))
+      .intersection(level->getBounds());
+  Table<bool> visible(level->getBounds(), false);
+  for (Vec2 v : area)
+    visible[v] = viewer->canSee(v);
+  int numViewChanges = level->getNumViewChanges();
+  int numComputed = 0;
+  double allTime = 0;
+  double changedTime = 0;
+  for (int i : Range(numFrames)) {
+    for (int j : Range(100)) {
+      Creature* c = creatures[random.getRandom(creatures.size())];
+      Vec2 dir(random.getRandom(-1, 2), random.getRandom(-1, 2));
+      if (dir != Vec2(0, 0) && level->canMoveCreature(c, dir))
+        level->moveCreature(c, dir);
+    }
+    double time1 = getMillis();
+    for (Vec2 v : area)
+      viewer->getViewIndex(v);
+    allTime += getMillis() - time1;
+    time1 = getMillis();
+    for (Vec2 v : area) {
+      bool canSee = viewer->canSee(v);
+      if (canSee == visible[v] && !level->isOccupied(v) && !level->viewChangedSince(v, numViewChanges))
+        continue;
+      visible[v] = canSee;
+      viewer->getViewIndex(v);
+      ++numComputed;
+    }
+    numViewChanges = level->getNumViewChanges();
+    changedTime += getMillis() - time1;
+  }
+  report("map view, all squares (" + convertToString(area.getW() * area.getH()) + ")", allTime, numFrames);
+  report("map view, changed squares (" + convertToString(numComputed / numFrames) + " on average)",
+      changedTime, numFrames);
+}
+
+// The squares around a creature are computed and stored for the map view, and the visible ones are
+// remembered, the same way as the window and the collective do it every frame. Then the memory is saved and
+// loaded again.
+static void benchmarkViewAllocations(Level* level) {
+  const int numFrames = 20;
+  const Creature* viewer = level->getAllCreatures()[0];
+  Rectangle area = Rectangle(viewer->getPosition() - Vec2(40, 25), viewer->getPosition() + Vec2(40, 25))
+      .intersection(level->getBounds());
+  Table<Optional<ViewIndex>> objects(level->getBounds());
+  long long allocations = numAllocations;
+  double time1 = getMillis();
+  for (int i : Range(numFrames))
+    for (Vec2 v : area) {
+      ViewIndex index = viewer->getViewIndex(v);
+      objects[v] = index;
+    }
+  report("map view objects (" + convertToString(int((numAllocations - allocations) / numFrames))
+      + " allocations per frame)", getMillis() - time1, numFrames);
+  MapMemory memory;
+  allocations = numAllocations;
+  time1 = getMillis();
+  for (int i : Range(numFrames))
+    for (Vec2 v : area)
+      if (viewer->canSee(v)) {
+        ViewIndex index = viewer->getViewIndex(v);
+        memory.clearSquare(v);
+        for (ViewLayer l : { ViewLayer::ITEM, ViewLayer::FLOOR_BACKGROUND, ViewLayer::FLOOR, ViewLayer::LARGE_ITEM})
+          if (index.hasObject(l))
+            memory.addObject(v, index.getObject(l));
+      }
+  report("map memory update (" + convertToString(int((numAllocations - allocations) / numFrames))
+      + " allocations per frame)", getMillis() - time1, numFrames);
+  allocations = numAllocations;
+  time1 = getMillis();
+  std::stringstream stream;
+  {
+    boost::archive::binary_oarchive output(stream);
+    output << memory;
+  }
+  MapMemory loaded;
+  {
+    boost::archive::binary_iarchive input(stream);
+    input >> loaded;
+  }
+  report("map memory save and load (" + convertToString(int(numAllocations - allocations)) + " allocations, "
+      + convertToString(int(stream.str().size())) + " bytes)", getMillis() - time1, 1);
+}
+
+// Poison gas clouds and a forest fire on the level. Only the parts of the level with fire or gas in them are
+// updated, so the time per turn should follow the size of the fire rather than the size of the level.
+static void benchmarkFireAndGas(Level* level) {
+  RandomGen random;
+  random.init(1234);
+  vector<Vec2> open;
+  vector<Vec2> flammable;
+  for (Vec2 v : level->getBounds())
+    if (level->canSeeThru(v)) {
+      open.push_back(v);
+      if (level->isFlammable(v))
+        flammable.push_back(v);
+    }
+  const int numTurns = 200;
+  int turn = 0;
+  double time1 = getMillis();
+  for (int i : Range(numTurns))
+    level->tick(++turn);
+  report("quiet level", getMillis() - time1, numTurns);
+  for (int i : Range(50))
+    level->getSquare(open[random.getRandom(open.size())])->addPoisonGas(3);
+  int numActive = level->getFields().getNumActiveChunks();
+  time1 = getMillis();
+  for (int i : Range(numTurns / 10))
+    level->tick(++turn);
+  report("50 gas clouds (" + convertToString(numActive) + " active chunks)", getMillis() - time1, numTurns / 10);
+  if (flammable.empty())
+    return;
+  for (int i : Range(20))
+    level->getSquare(flammable[random.getRandom(flammable.size())])->setOnFire(1);
+  int maxBurning = 0;
+  time1 = getMillis();
+  for (int i : Range(numTurns)) {
+    level->tick(++turn);
+    if (i % 20 == 0) {
+      int numBurning = 0;
+      for (Vec2 v : flammable)
+        numBurning += level->isBurning(v);
+      maxBurning = max(maxBurning, numBurning);
+    }
+  }
+  report("forest fire (up to " + convertToString(maxBurning) + " squares burning, "
+      + convertToString(level->getFields().getNumActiveChunks()) + " active chunks at the end)",
+      getMillis() - time1, numTurns);
+}
+
+class MountainMaker : public LevelMaker {
+  public:
+  virtual void make(Level::Builder* builder, Rectangle area) override {
+    for (Vec2 v : area)
+      builder->putSquare(v, v.x >= 2 * area.getW() / 3 ? SquareType::FLOOR : SquareType::ROCK_WALL);
+  }
+};
+
+// Fifty imps standing in front of a mountain get their first tasks, with five hundred squares marked for
+// digging. Most of the squares are inside the mountain, where no imp can get to them yet.
+static void benchmarkTaskAssignment() {
+  const int numRounds = 5;
+  const int numImps = 50;
+  double total = 0;
+  int numAssigned = 0;
+  for (int round : Range(numRounds)) {
+    vector<PCreature> creatures;
+    Level::Builder builder(120, 60, "mountain");
+    MountainMaker maker;
+    PLevel level = builder.build(nullptr, &maker, false);
+    Collective collective(nullptr, Tribes::get(TribeId::KEEPER));
+    collective.setLevel(level.get());
+    for (int i : Range(numImps + 1)) {
+      creatures.push_back(CreatureFactory::fromId(i == 0 ? CreatureId::KEEPER : CreatureId::IMP,
+          Tribes::get(TribeId::KEEPER), MonsterAIFactory::collective(&collective)));
+      level->putCreature(Vec2(85 + i % 15, 10 + 2 * (i / 15)), creatures.back().get());
+      collective.addCreature(creatures.back().get(), i == 0 ? MinionType::KEEPER : MinionType::IMP);
+    }
+    for (Vec2 v : Rectangle(Vec2(60, 5), Vec2(80, 30)))
+      collective.processInput(nullptr, CollectiveAction(CollectiveAction::BUILD, v, 0));
+    collective.processInput(nullptr, CollectiveAction(CollectiveAction::BUTTON_RELEASE, 0));
+    double time1 = getMillis();
+    for (int i : Range(1, numImps + 1))
+      if (collective.getMove(creatures[i].get()))
+        ++numAssigned;
+    total += getMillis() - time1;
+  }
+  report("first tasks of 50 imps, 500 squares to dig (" + convertToString(numAssigned / numRounds)
+      + " imps with a move)", total, numRounds * numImps);
+}
+
+// A keeper with a dungeon of 2100 squares, and a bandit walking back and forth just outside of it.
+static void benchmarkCollectiveTick() {
+  const int numTicks = 200;
+  Level::Builder builder(120, 60, "dungeon");
+  MountainMaker maker;
+  PLevel level = builder.build(nullptr, &maker, false);
+  Collective collective(nullptr, Tribes::get(TribeId::KEEPER));
+  collective.setLevel(level.get());
+  PCreature keeper = CreatureFactory::fromId(CreatureId::KEEPER, Tribes::get(TribeId::KEEPER),
+      MonsterAIFactory::collective(&collective));
+  level->putCreature(Vec2(100, 30), keeper.get());
+  collective.addCreature(keeper.get(), MinionType::KEEPER);
+  for (Vec2 v : Rectangle(Vec2(85, 0), Vec2(120, 60)))
+    collective.onConstructed(v, SquareType::FLOOR);
+  PCreature bandit = CreatureFactory::fromId(CreatureId::BANDIT, Tribes::get(TribeId::HUMAN));
+  level->putCreature(Vec2(80, 10), bandit.get());
+  double time1 = getMillis();
+  for (int i : Range(numTicks)) {
+    level->moveCreature(bandit.get(), Vec2(0, i % 40 < 20 ? 1 : -1));
+    collective.tick();
+  }
+  report("collective tick (2100 squares)", getMillis() - time1, numTicks);
+}
+
+// Builds the draw list of a zoomed out map full of floors, walls, items and creatures, without a window.
+static void benchmarkMapDrawList() {
+  const int numFrames = 100;
+  Table<Optional<ViewIndex>> objects(120, 80);
+  for (Vec2 v : objects.getBounds()) {
+    ViewIndex index;
+    index.insert(ViewObject(v.x % 7 == 0 ? ViewId::WALL : ViewId::FLOOR, ViewLayer::FLOOR, "floor"));
+    if (v.y % 5 == 0)
+      index.insert(ViewObject(ViewId::GOLD, ViewLayer::ITEM, "gold"));
+    if ((v.x + v.y) % 9 == 0)
+      index.insert(ViewObject(ViewId::IMP, ViewLayer::CREATURE, "imp"));
+    if (v.x > 80)
+      index.setHighlight(HighlightType::MEMORY);
+    objects[v] = index;
+  }
+  MapLayout layout(18, 18, allLayers);
+  layout.updatePlayerPos(Vec2(60 * 18, 40 * 18));
+  MapGui mapGui(Rectangle(0, 0, 1600, 1000), objects);
+  mapGui.setLayout(&layout);
+  mapGui.setSpriteMode(true);
+  mapGui.setLevelBounds(objects.getBounds());
+  mapGui.updateObjects(nullptr);
+  DrawList list;
+  double time1 = getMillis();
+  for (int i : Range(numFrames))
+    mapGui.buildDrawList(list, Nothing());
+  report("map draw list (" + convertToString(list.getNumQuads()) + " sprites in "
+      + convertToString(list.getNumDrawCalls()) + " draw calls)", getMillis() - time1, numFrames);
+}
+
+int main() {
+  Debug::init();
+  initGame();
+  for (int numCreatures : {100, 1000}) {
+    string suffix = " (" + convertToString(numCreatures) + " creatures)";
+    benchmarkTimeQueue<LegacyTimeQueue>("legacy time queue" + suffix, numCreatures, 200000);
+    benchmarkTimeQueue<TimeQueue>("indexed time queue" + suffix, numCreatures, 200000);
+  }
+  benchmarkShortestPath();
+  benchmarkTaskAssignment();
+  benchmarkCollectiveTick();
+  benchmarkMapDrawList();
+  Model* model = Model::collectiveModel(nullptr);
+  benchmarkLongPaths(model->getLevels()[0]);
+  benchmarkPassability(model->getLevels()[0]);
+  benchmarkFlowField(model->getLevels()[0]);
+  benchmarkFieldOfView(model->getLevels()[0]);
+  benchmarkVisibleEnemies(model->getLevels()[0]);
+  benchmarkViewRefresh(model->getLevels()[0]);
+  benchmarkViewAllocations(model->getLevels()[0]);
+  benchmarkFireAndGas(model->getLevels()[0]);
+}
@@ -0,0 +1,173 @@
+#include "stdafx.h"
+
+#include "cluster_graph.h"
+#include "level.h"
+
+ClusterGraph::ClusterGraph(const Level* l, const Creature* w) : level(l), walker(w), passable(l->getBounds()),
+    clusters((l->getWidth() + clusterSize - 1) / clusterSize, (l->getHeight() + clusterSize - 1) / clusterSize) {
+  Level::Passability movement = level->getPassability(walker);
+  for (Vec2 v : level->getBounds())
+    passable[v] = movement.canEnterEmpty(v);
+}
+
+Vec2 ClusterGraph::getCluster(Vec2 pos) const {
+  return Vec2(pos.x / clusterSize, pos.y / clusterSize);
+}
+
+Rectangle ClusterGraph::getClusterBounds(Vec2 cluster) const {
+  return Rectangle(cluster * clusterSize, cluster * clusterSize + Vec2(clusterSize, clusterSize))
+      .intersection(passable.getBounds());
+}
+
+void ClusterGraph::squareChanged(Vec2 pos) {
+  bool value = level->getPassability(walker).canEnterEmpty(pos);
+  if (value == passable[pos])
+    return;
+  passable[pos] = value;
+  for (Vec2 v : concat<Vec2>({Vec2(0, 0)}, Vec2::directions4()))
+    if ((pos + v).inRectangle(passable.getBounds()))
+      clusters[getCluster(pos + v)].dirty = true;
+}
+
+void ClusterGraph::addBorderEntrances(Vec2 cluster, Vec2 dir) {
+  if (!(cluster + dir).inRectangle(clusters.getBounds()))
+    return;
+  Rectangle bounds = getClusterBounds(cluster);
+  vector<Vec2> border;
+  if (dir.x == 0)
+    for (int x : Range(bounds.getPX(), bounds.getKX()))
+      border.push_back(Vec2(x, dir.y > 0 ? bounds.getKY() - 1 : bounds.getPY()));
+  else
+    for (int y : Range(bounds.getPY(), bounds.getKY()))
+      border.push_back(Vec2(dir.x > 0 ? bounds.getKX() - 1 : bounds.getPX(), y));
+  Cluster& c = clusters[cluster];
+  auto addEntrance = [&] (Vec2 pos) {
+    int ind = getEntranceIndex(c, pos);
+    if (ind == -1) {
+      c.entrances.push_back({pos, {}});
+      ind = c.entrances.size() - 1;
+    }
+    c.entrances[ind].partners.push_back(pos + dir);
+  };
+  int runStart = -1;
+  for (int i : Range(border.size() + 1)) {
+    bool open = i < border.size() && passable[border[i]] && passable[border[i] + dir];
+    if (open && runStart == -1)
+      runStart = i;
+    if (!open && runStart > -1) {
+      // Long openings get an entrance on each end, short ones in the middle.
+      if (i - runStart >= clusterSize / 2) {
+        addEntrance(border[runStart]);
+        addEntrance(border[i - 1]);
+      } else
+        addEntrance(border[(runStart + i - 1) / 2]);
+      runStart = -1;
+    }
+  }
+}
+
+Table<int> ClusterGraph::getLocalDistance(Vec2 cluster, Vec2 pos) const {
+  Table<int> ret(getClusterBounds(cluster), -1);
+  queue<Vec2> q;
+  ret[pos] = 0;
+  q.push(pos);
+  while (!q.empty()) {
+    Vec2 v = q.front();
+    q.pop();
+    for (Vec2 next : v.neighbors8())
+      if (next.inRectangle(ret.getBounds()) && ret[next] == -1 && passable[next]) {
+        ret[next] = ret[v] + 1;
+        q.push(next);
+      }
+  }
+  return ret;
+}
+
+void ClusterGraph::rebuild(Vec2 cluster) {
+  Cluster& c = clusters[cluster];
+  c.entrances.clear();
+  for (Vec2 dir : Vec2::directions4())
+    addBorderEntrances(cluster, dir);
+  c.distance.clear();
+  for (Entrance& e : c.entrances) {
+    Table<int> dist = getLocalDistance(cluster, e.pos);
+    c.distance.emplace_back();
+    for (Entrance& e2 : c.entrances)
+      c.distance.back().push_back(dist[e2.pos]);
+  }
+  c.dirty = false;
+}
+
+ClusterGraph::Cluster& ClusterGraph::getUpdated(Vec2 cluster) {
+  if (clusters[cluster].dirty)
+    rebuild(cluster);
+  return clusters[cluster];
+}
+
+int ClusterGraph::getEntranceIndex(const Cluster& c, Vec2 pos) const {
+  for (int i : All(c.entrances))
+    if (c.entrances[i].pos == pos)
+      return i;
+  return -1;
+}
+
+Optional<Vec2> ClusterGraph::getWaypoint(Vec2 from, Vec2 to) {
+  if (from.dist8(to) < minDistance || !passable[from] || !passable[to])
+    return Nothing();
+  Vec2 toCluster = getCluster(to);
+  Table<int> fromDist = getLocalDistance(getCluster(from), from);
+  Table<int> toDist = getLocalDistance(toCluster, to);
+  unordered_map<Vec2, int> distance;
+  unordered_map<Vec2, Vec2> previous;
+  struct QElem {
+    int priority;
+    int distance;
+    Vec2 pos;
+    bool operator < (const QElem& other) const {
+      return priority > other.priority;
+    }
+  };
+  priority_queue<QElem> q;
+  auto relax = [&] (Vec2 pos, Vec2 prev, int dist) {
+    auto elem = distance.find(pos);
+    if (elem == distance.end() || elem->second > dist) {
+      distance[pos] = dist;
+      previous[pos] = prev;
+      q.push({dist + 2 * pos.dist8(to), dist, pos});
+    }
+  };
+  for (const Entrance& e : getUpdated(getCluster(from)).entrances)
+    if (fromDist[e.pos] >= 0)
+      relax(e.pos, from, fromDist[e.pos]);
+  while (!q.empty()) {
+    QElem elem = q.top();
+    q.pop();
+    if (elem.distance > distance.at(elem.pos))
+      continue;
+    if (elem.pos == to) {
+      vector<Vec2> path;
+      for (Vec2 v = to; v != from; v = previous.at(v))
+        path.push_back(v);
+      Optional<Vec2> ret;
+      for (int i = path.size() - 1; i >= 0 && from.dist8(path[i]) <= waypointDistance; --i)
+        ret = path[i];
+      if (ret == to)
+        return Nothing();
+      return ret;
+    }
+    Vec2 cluster = getCluster(elem.pos);
+    const Cluster& c = getUpdated(cluster);
+    if (cluster == toCluster && toDist[elem.pos] >= 0)
+      relax(to, elem.pos, elem.distance + toDist[elem.pos]);
+    int ind = getEntranceIndex(c, elem.pos);
+    CHECK(ind > -1) << "Entrance not found " << elem.pos;
+    for (int i : All(c.entrances))
+      if (c.distance[ind][i] > 0)
+        relax(c.entrances[i].pos, elem.pos, elem.distance + c.distance[ind][i]);
+    for (Vec2 partner : c.entrances[ind].partners) {
+      getUpdated(getCluster(partner));
+      relax(partner, elem.pos, elem.distance + 1);
+    }
+  }
+  return Nothing();
+}
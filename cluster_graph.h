@@ -0,0 +1,56 @@
+#ifndef _CLUSTER_GRAPH_H
+#define _CLUSTER_GRAPH_H
+
+#include "util.h"
+
+class Level;
+class Creature;
+
+/** Abstract graph used for long distance pathfinding. The level is divided into square clusters,
+  * and adjacent clusters are connected by entrances on their common border. Distances between
+  * entrances of a cluster are precomputed, so a long path can be found by searching the entrances only.
+  * Changed squares only cause their clusters to be rebuilt before the next query.*/
+class ClusterGraph {
+  public:
+  /** Builds the graph for squares that \paramname{walker} can enter.*/
+  ClusterGraph(const Level*, const Creature* walker);
+
+  /** Marks the square as changed.*/
+  void squareChanged(Vec2 pos);
+
+  /** Returns an intermediate square on the way from \paramname{from} to \paramname{to}, at most
+    * waypointDistance squares away from \paramname{from}. Returns nothing if the squares are close
+    * enough for an exact search, or the graph can't connect them.*/
+  Optional<Vec2> getWaypoint(Vec2 from, Vec2 to);
+
+  static const int clusterSize = 16;
+  static const int minDistance = 2 * clusterSize;
+  static const int waypointDistance = 2 * clusterSize;
+
+  private:
+  struct Entrance {
+    Vec2 pos;
+    vector<Vec2> partners;
+  };
+
+  struct Cluster {
+    vector<Entrance> entrances;
+    vector<vector<int>> distance;
+    bool dirty = true;
+  };
+
+  Vec2 getCluster(Vec2 pos) const;
+  Rectangle getClusterBounds(Vec2 cluster) const;
+  void addBorderEntrances(Vec2 cluster, Vec2 dir);
+  void rebuild(Vec2 cluster);
+  Cluster& getUpdated(Vec2 cluster);
+  int getEntranceIndex(const Cluster&, Vec2 pos) const;
+  Table<int> getLocalDistance(Vec2 cluster, Vec2 pos) const;
+
+  const Level* level;
+  const Creature* walker;
+  Table<bool> passable;
+  Table<Cluster> clusters;
+};
+
+#endif
@@ -338,11 +338,11 @@ void Collective::retire() {
   retired = true;
 }
 
-vector<pair<Item*, Vec2>> Collective::getTrapItems(TrapType type, set<Vec2> squares) const {
+vector<pair<Item*, Vec2>> Collective::getTrapItems(TrapType type, const set<Vec2>& squares) const {
   vector<pair<Item*, Vec2>> ret;
-  if (squares.empty())
-    squares = mySquares.at(SquareType::WORKSHOP);
-  for (Vec2 pos : squares) {
+  for (Vec2 pos : squares.empty() ? mySquares.at(SquareType::WORKSHOP) : squares) {
+    if (!level->hasItems(pos))
+      continue;
     vector<Item*> v = level->getSquare(pos)->getItems([type, this](Item* it) {
         return it->getTrapType() == type && !isItemMarked(it); });
     for (Item* it : v)
@@ -592,7 +592,8 @@ void Collective::handleEquipment(View* view, Creature* creature, int prevItem) {
 vector<Item*> Collective::getAllItems(ItemPredicate predicate, bool includeMinions) const {
   vector<Item*> allItems;
   for (Vec2 v : myTiles)
-    append(allItems, level->getSquare(v)->getItems(predicate));
+    if (level->hasItems(v))
+      append(allItems, level->getSquare(v)->getItems(predicate));
   if (includeMinions)
     for (Creature* c : creatures)
       append(allItems, c->getEquipment().getItems(predicate));
@@ -1155,6 +1156,10 @@ ViewIndex Collective::getViewIndex(Vec2 pos) const {
   return index;
 }
 
+int Collective::getViewVersion() const {
+  return viewVersion + taskMap.getNumMarkChanges();
+}
+
 bool Collective::staticPosition() const {
   return false;
 }
@@ -1183,6 +1188,8 @@ Task* Collective::TaskMap::addTask(PTask task, const Creature* c) {
 }
 
 Task* Collective::TaskMap::addTask(PTask task, CostInfo cost) {
+  if (areas)
+    (*areas)[getArea(task->getPosition())].push_back(task.get());
   tasks.push_back(std::move(task));
   completionCost[tasks.back().get()] = cost;
   return tasks.back().get();
@@ -1194,8 +1201,16 @@ Collective::CostInfo Collective::TaskMap::removeTask(Task* task) {
     cost = completionCost.at(task);
     completionCost.erase(task);
   }
-  if (marked.count(task->getPosition()))
+  if (marked.count(task->getPosition())) {
     marked.erase(task->getPosition());
+    ++numMarkChanges;
+  }
+  if (areas) {
+    vector<Task*>& area = areas->at(getArea(task->getPosition()));
+    removeElement(area, task);
+    if (area.empty())
+      areas->erase(getArea(task->getPosition()));
+  }
   for (int i : All(tasks))
     if (tasks[i].get() == task) {
       removeIndex(tasks, i);
@@ -1234,12 +1249,18 @@ bool Collective::TaskMap::isMarked(Vec2 pos) const {
 void Collective::TaskMap::markSquare(Vec2 pos, PTask task) {
   addTask(std::move(task));
   marked[pos] = tasks.back().get();
+  ++numMarkChanges;
 }
 
 void Collective::TaskMap::unmarkSquare(Vec2 pos) {
   Task* t = marked.at(pos);
   removeTask(t);
   marked.erase(pos);
+  ++numMarkChanges;
+}
+
+int Collective::TaskMap::getNumMarkChanges() const {
+  return numMarkChanges;
 }
 
 bool Collective::hasGold(CostInfo cost) const {
@@ -1327,7 +1348,7 @@ bool Collective::canBuildDoor(Vec2 pos) const {
 
 bool Collective::canPlacePost(Vec2 pos) const {
   return !guardPosts.count(pos) && !traps.count(pos) &&
-      level->getSquare(pos)->canEnterEmpty(Creature::getDefault()) && knownPos(pos);
+      level->getPassability(Creature::getDefault()).canEnterEmpty(pos) && knownPos(pos);
 }
   
 void Collective::freeFromGuardPost(const Creature* c) {
@@ -1358,6 +1379,8 @@ void Collective::handleCreatureButton(Creature* c, View* view) {
 void Collective::processInput(View* view, CollectiveAction action) {
   if (retired)
     return;
+  if (action.getType() != CollectiveAction::IDLE)
+    ++viewVersion;
   switch (action.getType()) {
     case CollectiveAction::EDIT_TEAM:
         CHECK(!team.empty());
@@ -1571,8 +1594,13 @@ void Collective::addKnownTile(Vec2 pos) {
 }
 
 void Collective::onConstructed(Vec2 pos, SquareType type) {
-  if (!contains({SquareType::ANIMAL_TRAP, SquareType::TREE_TRUNK}, type))
+  if (!contains({SquareType::ANIMAL_TRAP, SquareType::TREE_TRUNK}, type) && !myTiles.count(pos)) {
     myTiles.insert(pos);
+    if (territoryDistance) {
+      (*territoryDistance)[pos] = 0;
+      extendTerritory({pos});
+    }
+  }
   CHECK(!mySquares[type].count(pos));
   mySquares[type].insert(pos);
   if (contains({SquareType::FLOOR, SquareType::BRIDGE}, type))
@@ -1599,6 +1627,10 @@ void Collective::onCantPickItem(EntitySet items) {
 void Collective::onBrought(Vec2 pos, vector<Item*> items) {
 }
 
+void Collective::onTaskMoved(Task* task, Vec2 from) {
+  taskMap.taskMoved(task, from);
+}
+
 void Collective::onAppliedItem(Vec2 pos, Item* item) {
   CHECK(item->getTrapType());
   if (traps.count(pos)) {
@@ -1755,15 +1787,17 @@ double Collective::getTime() const {
 void Collective::delayDangerousTasks(const vector<Vec2>& enemyPos, double delayTime) {
   int infinity = 1000000;
   int radius = 10;
-  Table<int> dist(Rectangle::boundingBox(enemyPos).minusMargin(-radius).intersection(level->getBounds()), infinity);
-  queue<Vec2> q;
+  if (!threatDistance)
+    threatDistance.reset(new Table<int>(level->getBounds(), infinity));
+  Table<int>& dist = *threatDistance;
+  // The visited squares are kept in order, so that they work as the queue and can be reset afterwards.
+  vector<Vec2> q;
   for (Vec2 v : enemyPos) {
     dist[v] = 0;
-    q.push(v);
+    q.push_back(v);
   }
-  while (!q.empty()) {
-    Vec2 pos = q.front();
-    q.pop();
+  for (int i = 0; i < q.size(); ++i) {
+    Vec2 pos = q[i];
     delayedPos[pos] = delayTime;
     if (dist[pos] >= radius)
       continue;
@@ -1771,7 +1805,76 @@ void Collective::delayDangerousTasks(const vector<Vec2>& enemyPos, double delayT
       if (v.inRectangle(dist.getBounds()) && dist[v] == infinity &&
           /*level->getSquare(v)->canEnterEmpty(Creature::getDefault()) &&*/ myTiles.count(v)) {
         dist[v] = dist[pos] + 1;
-        q.push(v);
+        q.push_back(v);
+      }
+  }
+  for (Vec2 v : q)
+    dist[v] = infinity;
+}
+
+const int Collective::maxThreatRadius;
+
+const Table<int>& Collective::getTerritoryDistance() {
+  if (territoryDistance && level->getNumSquareChanges() > territorySquareChanges) {
+    Optional<vector<Vec2>> changes = level->getSquareChangesSince(territorySquareChanges);
+    territorySquareChanges = level->getNumSquareChanges();
+    Level::Passability movement = level->getPassability(Creature::getDefault());
+    if (!changes)
+      territoryDistance.reset();
+    else
+      for (Vec2 pos : *changes) {
+        int d = (*territoryDistance)[pos];
+        // A square that was on the way from myTiles got closed, so some distances may grow.
+        if (d > 0 && d < maxThreatRadius && !movement.canEnterEmpty(pos)) {
+          territoryDistance.reset();
+          break;
+        }
+      }
+    if (territoryDistance) {
+      // The other changes can only open new ways, so the distances are lowered starting from the
+      // neighbors of the changed squares.
+      vector<Vec2> neighbors;
+      for (Vec2 pos : *changes)
+        for (Vec2 v : pos.neighbors8())
+          if (level->inBounds(v) && (*territoryDistance)[v] < maxThreatRadius - 1)
+            neighbors.push_back(v);
+      extendTerritory(neighbors);
+    }
+  }
+  if (!territoryDistance) {
+    territoryDistance.reset(new Table<int>(level->getBounds(), maxThreatRadius));
+    territorySquareChanges = level->getNumSquareChanges();
+    for (Vec2 pos : myTiles)
+      (*territoryDistance)[pos] = 0;
+    extendTerritory(vector<Vec2>(myTiles.begin(), myTiles.end()));
+  }
+  return *territoryDistance;
+}
+
+void Collective::checkConsistency() {
+  if (!territoryDistance)
+    return;
+  getTerritoryDistance();
+  unique_ptr<Table<int>> kept = std::move(territoryDistance);
+  const Table<int>& distance = getTerritoryDistance();
+  for (Vec2 pos : level->getBounds())
+    CHECK((*kept)[pos] == distance[pos]) << "Territory distance out of sync at " << pos << " "
+        << (*kept)[pos] << " " << distance[pos];
+}
+
+void Collective::extendTerritory(vector<Vec2> positions) {
+  Table<int>& distance = *territoryDistance;
+  Level::Passability movement = level->getPassability(Creature::getDefault());
+  // The starting distances can differ, so a square may be lowered more than once.
+  for (int i = 0; i < positions.size(); ++i) {
+    Vec2 pos = positions[i];
+    int d = distance[pos] + 1;
+    if (d >= maxThreatRadius)
+      continue;
+    for (Vec2 v : pos.neighbors8())
+      if (level->inBounds(v) && distance[v] > d && movement.canEnterEmpty(v)) {
+        distance[v] = d;
+        positions.push_back(v);
       }
   }
 }
@@ -1803,39 +1906,11 @@ void Collective::tick() {
       warning[int(Warning::NO_WEAPONS)] = true;
   }
 
-  map<Vec2, int> extendedTiles;
-  queue<Vec2> extendedQueue;
   vector<Vec2> enemyPos;
-  for (Vec2 pos : myTiles) {
-    if (Creature* c = level->getSquare(pos)->getCreature()) {
-      if (c->getTribe() != tribe)
-        enemyPos.push_back(c->getPosition());
-    }
- /*   if (taskMap.isMarked(pos) && marked.at(pos)->isImpossible(level) && !taken.count(marked.at(pos)))
-      removeTask(marked.at(pos));*/
-    for (Vec2 v : pos.neighbors8())
-      if (v.inRectangle(level->getBounds()) && !myTiles.count(v) && !extendedTiles.count(v) 
-          && level->getSquare(v)->canEnterEmpty(Creature::getDefault())) {
-        extendedTiles[v] = 1;
-        extendedQueue.push(v);
-      }
-  }
-  const int maxRadius = 10;
-  while (!extendedQueue.empty()) {
-    Vec2 pos = extendedQueue.front();
-    extendedQueue.pop();
-    if (Creature* c = level->getSquare(pos)->getCreature())
-      if (c->getTribe() != tribe)
-        enemyPos.push_back(c->getPosition());
-    for (Vec2 v : pos.neighbors8())
-      if (v.inRectangle(level->getBounds()) && !myTiles.count(v) && !extendedTiles.count(v) 
-          && level->getSquare(v)->canEnterEmpty(Creature::getDefault())) {
-        int a = extendedTiles[v] = extendedTiles[pos] + 1;
-        if (a < maxRadius)
-          extendedQueue.push(v);
-      }
-
-  }
+  const Table<int>& territory = getTerritoryDistance();
+  for (const Creature* c : level->getAllCreatures())
+    if (c->getTribe() != tribe && territory[c->getPosition()] < maxThreatRadius)
+      enemyPos.push_back(c->getPosition());
   if (!enemyPos.empty())
     delayDangerousTasks(enemyPos, getTime() + 20);
   else
@@ -1863,7 +1938,8 @@ void Collective::tick() {
   updateConstructions();
   for (ItemFetchInfo elem : getFetchInfo()) {
     for (Vec2 pos : myTiles)
-      fetchItems(pos, elem);
+      if (level->hasItems(pos))
+        fetchItems(pos, elem);
     for (SquareType type : elem.additionalPos)
       for (Vec2 pos : mySquares.at(type))
         fetchItems(pos, elem);
@@ -1924,6 +2000,8 @@ void Collective::setLevel(Level* l) {
       getMemory(l).addObject(v, l->getSquare(v)->getViewObject());
   level = l;
   knownTiles = Table<bool>(level->getBounds(), false);
+  territoryDistance.reset();
+  threatDistance.reset();
 }
 
 vector<const Creature*> Collective::getUnknownAttacker() const {
@@ -2201,31 +2279,152 @@ MoveInfo Collective::getMinionMove(Creature* c) {
 }
 
 bool Collective::underAttack() const {
-  for (Vec2 v : myTiles)
-    if (const Creature* c = level->getSquare(v)->getCreature())
-      if (c->getTribe() != tribe)
+  for (const Creature* c : level->getAllCreatures())
+    if (c->getTribe() != tribe && myTiles.count(c->getPosition()))
+      return true;
+  return false;
+}
+
+Vec2 Collective::TaskMap::getArea(Vec2 pos) {
+  // Rounds down, so that the areas next to each other are one unit apart also at negative coordinates.
+  return Vec2(pos.x >= 0 ? pos.x / areaSize : (pos.x + 1) / areaSize - 1,
+      pos.y >= 0 ? pos.y / areaSize : (pos.y + 1) / areaSize - 1);
+}
+
+unordered_map<Vec2, vector<Task*>>& Collective::TaskMap::getAreas() {
+  if (!areas) {
+    areas.reset(new unordered_map<Vec2, vector<Task*>>());
+    for (PTask& task : tasks)
+      (*areas)[getArea(task->getPosition())].push_back(task.get());
+  }
+  return *areas;
+}
+
+void Collective::TaskMap::taskMoved(Task* task, Vec2 from) {
+  if (!areas || !areas->count(getArea(from)) || !contains(areas->at(getArea(from)), task))
+    return;
+  vector<Task*>& area = areas->at(getArea(from));
+  removeElement(area, task);
+  if (area.empty())
+    areas->erase(getArea(from));
+  (*areas)[getArea(task->getPosition())].push_back(task);
+}
+
+bool Collective::TaskMap::isAvailable(const Creature* c, Task* task, int distance) const {
+  return (!taken.count(task) || (task->canTransfer()
+          && (task->getPosition() - taken.at(task)->getPosition()).length8() > distance))
+      && !isLocked(c, task)
+      && (!delayedTasks.count(task->getUniqueId()) || delayedTasks.at(task->getUniqueId()) < c->getTime());
+}
+
+bool Collective::TaskMap::canReach(const Level* level, const Level::Passability& movement, Vec2 pos) {
+  // A creature has to stand on the task's square or next to it, so the squares deep inside a mountain
+  // are skipped without searching for a path to them.
+  if (!level->inBounds(pos) || movement.canEnterEmpty(pos) || movement.canDestroy(pos))
+    return true;
+  for (int dx = -1; dx <= 1; ++dx)
+    for (int dy = -1; dy <= 1; ++dy) {
+      Vec2 v = pos + Vec2(dx, dy);
+      if (level->inBounds(v) && (movement.canEnterEmpty(v) || movement.canDestroy(v)))
         return true;
+    }
   return false;
 }
 
 Task* Collective::TaskMap::getTaskForImp(Creature* c) {
-  Task* closest = nullptr;
-  for (PTask& task : tasks) {
-    double dist = (task->getPosition() - c->getPosition()).length8();
-    if ((!taken.count(task.get()) || (task->canTransfer() 
-                                && (task->getPosition() - taken.at(task.get())->getPosition()).length8() > dist))
-        && (!closest ||
-           dist < (closest->getPosition() - c->getPosition()).length8())
-        && !isLocked(c, task.get())
-        && (!delayedTasks.count(task->getUniqueId()) || delayedTasks.at(task->getUniqueId()) < c->getTime())) {
-      bool valid = task->getMove(c);
-      if (valid)
-        closest = task.get();
+  unordered_map<Vec2, vector<Task*>>& areas = getAreas();
+  Vec2 center = getArea(c->getPosition());
+  int maxRing = 0;
+  for (auto& elem : areas)
+    maxRing = max(maxRing, (elem.first - center).length8());
+  Level::Passability movement = c->getLevel()->getPassability(c);
+  priority_queue<Candidate> candidates;
+  auto addCandidates = [&] (Vec2 area) {
+    if (areas.count(area))
+      for (Task* task : areas.at(area)) {
+        int distance = (task->getPosition() - c->getPosition()).length8();
+        if (isAvailable(c, task, distance) && canReach(c->getLevel(), movement, task->getPosition()))
+          candidates.push({distance, task->getUniqueId(), task});
+      }
+  };
+  // Looks at the areas in growing rings around the creature. The tasks beyond a ring are more than
+  // ring * areaSize squares away, so all candidates up to that distance can be checked before going further.
+  for (int ring = 0; ring <= maxRing; ++ring) {
+    if (ring == 0)
+      addCandidates(center);
+    for (int i = -ring; i <= ring && ring > 0; ++i) {
+      addCandidates(center + Vec2(i, -ring));
+      addCandidates(center + Vec2(i, ring));
+      if (abs(i) < ring) {
+        addCandidates(center + Vec2(-ring, i));
+        addCandidates(center + Vec2(ring, i));
+      }
+    }
+    int maxDistance = ring < maxRing ? ring * areaSize : std::numeric_limits<int>::max();
+    while (!candidates.empty() && candidates.top().distance <= maxDistance) {
+      Task* task = candidates.top().task;
+      candidates.pop();
+      if (task->getMove(c))
+        return task;
       else
-        lock(c, task.get());
+        lock(c, task);
     }
   }
-  return closest;
+  return nullptr;
+}
+
+void Collective::TaskMap::assignTasks(const vector<Creature*>& creatures) {
+  // Every creature gets a list of the tasks it could take, with the closest one at the back. The closest
+  // pairs are matched first, and a creature that lost its task to someone else moves on to its next one.
+  vector<vector<Candidate>> candidates(creatures.size());
+  priority_queue<Candidate> queue;
+  auto pushNext = [&] (int index) {
+    if (!candidates[index].empty()) {
+      Candidate next = candidates[index].back();
+      candidates[index].pop_back();
+      queue.push({next.distance, index, next.task});
+    }
+  };
+  vector<Task*> allTasks;
+  for (auto& area : getAreas())
+    append(allTasks, area.second);
+  // Which tasks can be reached at all is the same for all creatures that move the same way.
+  vector<pair<FlowField::MovementClass, vector<bool>>> reachable;
+  for (int i : All(creatures)) {
+    Creature* c = creatures[i];
+    FlowField::MovementClass movementClass = FlowField::getMovementClass(c);
+    const vector<bool>* canReachTask = nullptr;
+    for (auto& elem : reachable)
+      if (elem.first == movementClass)
+        canReachTask = &elem.second;
+    if (!canReachTask) {
+      Level::Passability movement = c->getLevel()->getPassability(c);
+      reachable.emplace_back(movementClass, vector<bool>());
+      for (Task* task : allTasks)
+        reachable.back().second.push_back(canReach(c->getLevel(), movement, task->getPosition()));
+      canReachTask = &reachable.back().second;
+    }
+    for (int j : All(allTasks)) {
+      int distance = (allTasks[j]->getPosition() - c->getPosition()).length8();
+      if ((*canReachTask)[j] && isAvailable(c, allTasks[j], distance))
+        candidates[i].push_back({distance, allTasks[j]->getUniqueId(), allTasks[j]});
+    }
+    sort(candidates[i].begin(), candidates[i].end());
+    pushNext(i);
+  }
+  while (!queue.empty()) {
+    Candidate elem = queue.top();
+    queue.pop();
+    Creature* c = creatures[elem.index];
+    if (isAvailable(c, elem.task, elem.distance)) {
+      if (elem.task->getMove(c)) {
+        takeTask(c, elem.task);
+        continue;
+      } else
+        lock(c, elem.task);
+    }
+    pushNext(elem.index);
+  }
 }
 
 void Collective::TaskMap::takeTask(const Creature* c, Task* task) {
@@ -2250,15 +2449,28 @@ MoveInfo Collective::getMove(Creature* c) {
     } else
       return task->getMove(c);
   }
-  if (Task* closest = taskMap.getTaskForImp(c)) {
-    taskMap.takeTask(c, closest);
-    return closest->getMove(c);
-  } else {
+  if (getTime() > lastTaskAssignment) {
+    lastTaskAssignment = getTime();
+    idleImps.clear();
+    for (Creature* imp : minionByType.at(MinionType::IMP))
+      if (imp->getLevel() == level && !taskMap.getTask(imp))
+        idleImps.push_back(imp);
+    taskMap.assignTasks(idleImps);
+    idleImps = filter(idleImps, [this] (const Creature* imp) { return !taskMap.getTask(imp); });
+  }
+  // The imps left in idleImps got no task at the last assignment, so there was none for them.
+  Task* task = taskMap.getTask(c);
+  if (!task && !contains(idleImps, c))
+    if ((task = taskMap.getTaskForImp(c)))
+      taskMap.takeTask(c, task);
+  if (task)
+    return task->getMove(c);
+  else {
     if (!myTiles.count(c->getPosition()) && keeper->getLevel() == c->getLevel()) {
       Vec2 keeperPos = keeper->getPosition();
       if (keeperPos.dist8(c->getPosition()) < 3)
         return NoMove;
-      if (auto move = c->getMoveTowards(keeperPos))
+      if (auto move = c->getSharedMoveTowardsMoving(keeperPos))
         return {1.0, [=] {
           c->move(*move);
         }};
@@ -2325,9 +2537,10 @@ void Collective::addCreature(Creature* c, MinionType type) {
     type = MinionType::KEEPER;
     minionByType[type].push_back(c);
     Vec2 radius(30, 30);
+    Level::Passability movement = level->getPassability(Creature::getDefault());
     for (Vec2 pos : Rectangle(c->getPosition() - radius, c->getPosition() + radius))
       if (pos.distD(c->getPosition()) <= radius.x && pos.inRectangle(level->getBounds()) 
-          && level->getSquare(pos)->canEnterEmpty(Creature::getDefault()))
+          && movement.canEnterEmpty(pos))
         for (Vec2 v : concat({pos}, pos.neighbors8()))
           if (v.inRectangle(level->getBounds()))
             addKnownTile(v);
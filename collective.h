@@ -9,6 +9,7 @@
 #include "minion_equipment.h"
 #include "task.h"
 #include "entity_set.h"
+#include "level.h"
 
 enum class MinionType {
   IMP,
@@ -31,6 +32,7 @@ class Collective : public CreatureView, public EventListener {
   virtual const MapMemory& getMemory() const override;
   MapMemory& getMemory(Level* l);
   virtual ViewIndex getViewIndex(Vec2 pos) const override;
+  virtual int getViewVersion() const override;
   virtual void refreshGameInfo(View::GameInfo&) const  override;
   virtual Vec2 getPosition() const  override;
   virtual bool canSee(const Creature*) const  override;
@@ -57,6 +59,9 @@ class Collective : public CreatureView, public EventListener {
 
   void processInput(View* view, CollectiveAction);
   void tick();
+
+  /** Checks that the territory distances kept between turns agree with the ones computed from scratch.*/
+  void checkConsistency();
   void update(Creature*);
   MoveInfo getMove(Creature* c);
   void addCreature(Creature* c, MinionType);
@@ -71,6 +76,7 @@ class Collective : public CreatureView, public EventListener {
   void onAppliedItemCancel(Vec2 pos);
   void onPickedUp(Vec2 pos, EntitySet);
   void onCantPickItem(EntitySet items);
+  void onTaskMoved(Task*, Vec2 from);
 
   bool isRetired() const;
   const Creature* getKeeper() const;
@@ -235,6 +241,11 @@ class Collective : public CreatureView, public EventListener {
   bool isDownstairsVisible() const;
   void delayDangerousTasks(const vector<Vec2>& enemyPos, double delayTime);
   bool isDelayed(Vec2 pos);
+  /** Returns the distances from myTiles through the squares that an ordinary creature can enter. The
+    * squares at maxThreatRadius or further are all at maxThreatRadius.*/
+  const Table<int>& getTerritoryDistance();
+  /** Lowers the territory distances around squares that got closer to myTiles.*/
+  void extendTerritory(vector<Vec2> positions);
   double getTime() const;
   unordered_map<Vec2, double> SERIAL(delayedPos);
   int numGold(ResourceId) const;
@@ -279,7 +290,7 @@ class Collective : public CreatureView, public EventListener {
   bool tryLockingDoor(Vec2 pos);
   void addKnownTile(Vec2 pos);
 
-  vector<pair<Item*, Vec2>> getTrapItems(TrapType, set<Vec2> = {}) const;
+  vector<pair<Item*, Vec2>> getTrapItems(TrapType, const set<Vec2>& = {}) const;
   ItemPredicate unMarkedItems(ItemType) const;
   MarkovChain<MinionTask> getTasksForMinion(Creature* c);
   vector<Creature*> SERIAL(creatures);
@@ -287,6 +298,8 @@ class Collective : public CreatureView, public EventListener {
   unordered_map<MinionType, vector<Creature*>> SERIAL(minionByType);
   EntitySet SERIAL(markedItems);
 
+  /** Tasks of the collective and the creatures that took them. The tasks are also indexed by the area of the
+    * level they are in, so that a creature can find the closest ones without looking at all of them.*/
   class TaskMap {
     public:
     Task* addTask(PTask, CostInfo = {ResourceId::GOLD, 0});
@@ -301,24 +314,58 @@ class Collective : public CreatureView, public EventListener {
     void lock(const Creature*, const Task*);
     void clearAllLocked();
     vector<Task*> getTasks();
+
+    /** Returns the closest task that the creature can take and has a move for, or null. Tasks are checked
+      * closest first, and the ones without a move are locked for the creature. A task taken by someone
+      * else can be transferred to a creature that is closer to it.*/
     Task* getTaskForImp(Creature*);
+
+    /** Gives tasks to all the creatures at once. The closest pairs of a creature and a task are matched
+      * first, so the creatures don't take each other's tasks.*/
+    void assignTasks(const vector<Creature*>&);
+
     void takeTask(const Creature*, Task*);
     void freeTask(Task*);
     void freeTaskDelay(Task*, double delayTime);
 
+    /** Updates the index after the task's position changed.*/
+    void taskMoved(Task*, Vec2 from);
+
+    /** Returns the number of times that a square was marked or unmarked so far.*/
+    int getNumMarkChanges() const;
+
     template <class Archive>
     void serialize(Archive& ar, const unsigned int version);
 
     SERIAL_CHECKER;
 
     private:
+    bool isAvailable(const Creature*, Task*, int distance) const;
+    unordered_map<Vec2, vector<Task*>>& getAreas();
+    static Vec2 getArea(Vec2 pos);
+    static bool canReach(const Level*, const Level::Passability&, Vec2 pos);
+
+    struct Candidate {
+      int distance;
+      int index;
+      Task* task;
+      bool operator < (const Candidate& other) const {
+        return distance > other.distance || (distance == other.distance && index > other.index);
+      }
+    };
+
     vector<PTask> SERIAL(tasks);
-    map<Vec2, Task*> SERIAL(marked);
-    map<Task*, const Creature*> SERIAL(taken);
-    map<const Creature*, Task*> SERIAL(taskMap);
-    map<Task*, CostInfo> SERIAL(completionCost);
-    set<pair<const Creature*, UniqueId>> SERIAL(lockedTasks);
-    map<UniqueId, double> SERIAL(delayedTasks);
+    unordered_map<Vec2, Task*> SERIAL(marked);
+    unordered_map<Task*, const Creature*> SERIAL(taken);
+    unordered_map<const Creature*, Task*> SERIAL(taskMap);
+    unordered_map<Task*, CostInfo> SERIAL(completionCost);
+    unordered_set<pair<const Creature*, UniqueId>, PairHash> SERIAL(lockedTasks);
+    unordered_map<UniqueId, double> SERIAL(delayedTasks);
+    /** Tasks by the area of their position. Built when first queried.*/
+    unique_ptr<unordered_map<Vec2, vector<Task*>>> areas;
+    /** Counted by getNumMarkChanges. Not saved.*/
+    int numMarkChanges = 0;
+    static const int areaSize = 8;
   } SERIAL(taskMap);
 
   struct TrapInfo {
@@ -374,6 +421,20 @@ class Collective : public CreatureView, public EventListener {
   unordered_map<const Creature*, double> SERIAL(lastCombat);
   double SERIAL2(lastControlKeeperQuestion, -100);
   int SERIAL2(startImpNum, -1);
+  /** Time when the idle imps were last given tasks all at once, and the imps that got no task then.*/
+  double lastTaskAssignment = -1;
+  vector<Creature*> idleImps;
+  /** Distances returned by getTerritoryDistance. Built when first queried, and then updated as myTiles
+    * grows and the squares of the level change. Enemies closer than maxThreatRadius are a threat.*/
+  unique_ptr<Table<int>> territoryDistance;
+  /** Level::getNumSquareChanges when territoryDistance was last updated.*/
+  int territorySquareChanges;
+  static const int maxThreatRadius = 10;
+  /** Distances from the enemies used by delayDangerousTasks. Kept between calls, and reset only where
+    * they were set.*/
+  unique_ptr<Table<int>> threatDistance;
+  /** Incremented by the player's actions, which can change getViewIndex. Not saved.*/
+  int viewVersion = 0;
   bool SERIAL2(retired, false);
   Tribe* SERIAL2(tribe, nullptr);
   struct AlarmInfo {
@@ -7,6 +7,7 @@
 #include "ranged_weapon.h"
 #include "statistics.h"
 #include "options.h"
+#include "profiler.h"
 
 template <class Archive> 
 void Creature::Vision::serialize(Archive& ar, const unsigned int version) {
@@ -301,14 +302,17 @@ void Creature::makeMove() {
   updateVisibleEnemies();
   if (swapPositionCooldown)
     --swapPositionCooldown;
-  MEASURE(controller->makeMove(), "creature move time");
+  {
+    PROFILE_ZONE("controller move");
+    controller->makeMove();
+  }
   CHECK(!inEquipChain) << "Someone forgot to finishEquipChain()";
   if (!hidden)
     viewObject.removeModifier(ViewObject::HIDDEN);
   unknownAttacker.clear();
   if (fireCreature && Random.roll(5))
     getSquare()->setOnFire(1);
-  if (!getSquare()->isCovered())
+  if (!level->isCovered(position))
     shineLight();
 }
 
@@ -555,7 +559,7 @@ bool Creature::canHide() const {
 void Creature::hide() {
   knownHiding.clear();
   viewObject.setModifier(ViewObject::HIDDEN);
-  for (const Creature* c : getLevel()->getAllCreatures())
+  for (const Creature* c : getLevel()->getCreaturesInRadius(position, FieldOfView::sightRange))
     if (c->canSee(this) && c->isEnemy(this)) {
       knownHiding.insert(c);
       if (!isBlind())
@@ -706,12 +710,14 @@ void Creature::onTimedOut(LastingEffect effect, bool msg) {
 void Creature::addEffect(LastingEffect effect, double time, bool msg) {
   if (affects(effect)) {
     lastingEffects[effect] = getTime() + time;
+    invalidateAttributes();
     onAffected(effect, msg);
   }
 }
 
 void Creature::removeEffect(LastingEffect effect, bool msg) {
   lastingEffects.erase(effect);
+  invalidateAttributes();
   onRemoved(effect, msg);
 }
 
@@ -742,7 +748,50 @@ int strPenNoArm = 2;
 int strPenNoLeg = 5;
 int strPenNoWing = 2;
 
+bool Creature::cacheChecks = false;
+
+void Creature::setCacheChecks(bool on) {
+  cacheChecks = on;
+}
+
+void Creature::invalidateAttributes() {
+  attrCache.valid = false;
+}
+
+void Creature::resetAttrCache() const {
+  for (int& value : attrCache.values)
+    value = -1;
+  attrCache.valid = true;
+  attrCache.health = health;
+  attrCache.equipmentVersion = equipment.getVersion();
+  attrCache.itemVersion = Item::getModifierVersion();
+  attrCache.handicap = tribe->getHandicap();
+  // The effects that have already run out can't start again, so only the next one to run out matters.
+  attrCache.validUntil = std::numeric_limits<double>::max();
+  for (auto elem : lastingEffects)
+    if (elem.second >= getTime())
+      attrCache.validUntil = min(attrCache.validUntil, elem.second);
+}
+
 int Creature::getAttr(AttrType type) const {
+  if (!attrCache.valid || attrCache.health != health || getTime() > attrCache.validUntil
+      || attrCache.equipmentVersion != equipment.getVersion()
+      || attrCache.itemVersion != Item::getModifierVersion() || attrCache.handicap != tribe->getHandicap())
+    resetAttrCache();
+  int& value = attrCache.values[int(type)];
+  if (value == -1)
+    value = computeAttr(type);
+#ifndef RELEASE
+  if (cacheChecks) {
+    int computed = computeAttr(type);
+    CHECK(value == computed) << "Cached attribute " << int(type) << " of " << getName() << " is " << value
+        << ", should be " << computed;
+  }
+#endif
+  return value;
+}
+
+int Creature::computeAttr(AttrType type) const {
   int def = getAttrVal(type);
   for (Item* item : equipment.getItems())
     if (equipment.isEquiped(item))
@@ -896,6 +945,7 @@ double Creature::getTime() const {
 
 void Creature::setTime(double t) {
   time = t;
+  invalidateAttributes();
 }
 
 void Creature::tick(double realTime) {
@@ -908,6 +958,7 @@ void Creature::tick(double realTime) {
   for (auto elem : copyThis(lastingEffects))
     if (elem.second < realTime) {
       lastingEffects.erase(elem.first);
+      invalidateAttributes();
       onTimedOut(elem.first, true);
     }
   else if (isAffected(POISON)) {
@@ -978,6 +1029,7 @@ static string getAttackParam(AttackType type) {
 }
 
 void Creature::injureLeg(bool drop) {
+  invalidateAttributes();
   if (legs == 0)
     return;
   if (drop) {
@@ -999,6 +1051,7 @@ void Creature::injureLeg(bool drop) {
 }
 
 void Creature::injureArm(bool dropArm) {
+  invalidateAttributes();
   if (dropArm) {
     Statistics::add(StatId::CHOPPED_LIMB);
     --arms;
@@ -1019,6 +1072,7 @@ void Creature::injureArm(bool dropArm) {
 }
 
 void Creature::injureWing(bool drop) {
+  invalidateAttributes();
   if (drop) {
     Statistics::add(StatId::CHOPPED_LIMB);
     --wings;
@@ -1042,6 +1096,7 @@ void Creature::injureWing(bool drop) {
 }
 
 void Creature::injureHead(bool drop) {
+  invalidateAttributes();
   if (drop) {
     Statistics::add(StatId::CHOPPED_HEAD);
     --heads;
@@ -1331,6 +1386,7 @@ string Creature::getDescription() const {
 
 void Creature::setSpeed(double value) {
   speed = value;
+  invalidateAttributes();
 }
 
 double Creature::getSpeed() const {
@@ -1344,6 +1400,7 @@ CreatureSize Creature::getSize() const {
 void Creature::heal(double amount, bool replaceLimbs) {
   Debug() << getTheName() << " heal";
   if (health < 1) {
+    invalidateAttributes();
     health = min(1., health + amount);
     if (health >= 0.5) {
       if (injuredArms > 0) {
@@ -1474,7 +1531,7 @@ void Creature::die(const Creature* attacker, bool dropInventory, bool dCorpse) {
 }
 
 bool Creature::canFlyAway() const {
-  return canFly() && !getConstSquare()->isCovered();
+  return canFly() && !level->isCovered(position);
 }
 
 void Creature::flyAway() {
@@ -1671,6 +1728,41 @@ bool Creature::canSee(const Creature* c) const {
          getLevel()->canSee(position, c->getPosition());
 }
 
+vector<Creature*> Creature::getCreaturesInSight() const {
+  if (!visions.empty())
+    return getLevel()->getCreaturesInRadius(position, FieldOfView::sightRange);
+  if (isBlind())
+    return {};
+  if (!isSightCacheValid())
+    setSightCache(level->getVisibleCreatures(position));
+#ifndef RELEASE
+  else if (cacheChecks)
+    CHECK(sightCache.creatures == level->getVisibleCreatures(position)) << "Cached sight of " << getName()
+        << " at " << position << " is out of date";
+#endif
+  return sightCache.creatures;
+}
+
+bool Creature::isSightCacheValid() const {
+  return sightCache.level == level && sightCache.position == position
+      && !level->sightChangedSince(position, sightCache.numChanges);
+}
+
+bool Creature::needsSightUpdate() const {
+  return visions.empty() && !isBlind() && !isSightCacheValid();
+}
+
+void Creature::updateSight() {
+  setSightCache(level->getVisibleCreaturesReadOnly(position));
+}
+
+void Creature::setSightCache(vector<Creature*> creatures) const {
+  sightCache.level = level;
+  sightCache.position = position;
+  sightCache.numChanges = level->getNumSightChanges();
+  sightCache.creatures = std::move(creatures);
+}
+
 bool Creature::canSee(Vec2 pos) const {
   return !isBlind() && 
       getLevel()->canSee(position, pos);
@@ -1798,6 +1890,7 @@ Gender Creature::getGender() const {
 void Creature::increaseExpLevel(double amount) {
   if (increaseExperience) {
     expLevel = min<double>(maxLevel, amount + expLevel);
+    invalidateAttributes();
  //   viewObject.setSizeIncrease(0.3);
     if (skillGain.count(getExpLevel()) && isHumanoid()) {
       you(MsgType::ARE, "more experienced");
@@ -1832,6 +1925,34 @@ Optional<Vec2> Creature::getMoveTowards(Vec2 pos, bool avoidEnemies) {
   return getMoveTowards(pos, false, avoidEnemies);
 }
 
+Optional<Vec2> Creature::getSharedMoveTowards(const vector<Vec2>& targets) {
+  FlowField& field = getLevel()->getFlowField(targets, this);
+  if (Optional<Vec2> move = field.getNextMove(this))
+    return move;
+  // Stuck in a crowd, search a path that goes around the other creatures.
+  if (Optional<int> dist = field.getDistance(this, getPosition()))
+    if (*dist > 0) {
+      Vec2 closest = targets[0];
+      for (Vec2 v : targets)
+        if (v.dist8(getPosition()) < closest.dist8(getPosition()))
+          closest = v;
+      return getMoveTowards(closest);
+    }
+  return Nothing();
+}
+
+Optional<Vec2> Creature::getSharedMoveTowardsMoving(Vec2 target) {
+  if (getPosition().dist8(target) < ClusterGraph::clusterSize)
+    return getMoveTowards(target);
+  FlowField& field = getLevel()->getClusterFlowField(target, this);
+  if (Optional<Vec2> move = field.getNextMove(this))
+    return move;
+  if (Optional<int> dist = field.getDistance(this, getPosition()))
+    if (*dist > 0)
+      return getMoveTowards(target);
+  return Nothing();
+}
+
 Optional<Vec2> Creature::getMoveTowards(Vec2 pos, bool away, bool avoidEnemies) {
   Debug() << "" << getPosition() << (away ? "Moving away from" : " Moving toward ") << pos;
   bool newPath = false;
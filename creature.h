@@ -29,6 +29,10 @@ class Creature : public CreatureAttributes, public CreatureView, public UniqueEn
   static void noExperienceLevels();
   static void initialize();
 
+  /** If on, the cached results of getAttr() and getCreaturesInSight() are checked against a fresh calculation
+    * every time they are used. Does nothing in RELEASE builds.*/
+  static void setCacheChecks(bool);
+
   const ViewObject& getViewObject() const;
   virtual ViewIndex getViewIndex(Vec2 pos) const override;
   void makeMove();
@@ -57,6 +61,14 @@ class Creature : public CreatureAttributes, public CreatureView, public UniqueEn
   virtual bool canSee(const Creature*) const override;
   virtual bool canSee(Vec2 pos) const override;
   virtual bool isEnemy(const Creature*) const override;
+  virtual vector<Creature*> getCreaturesInSight() const override;
+
+  /** Checks if getCreaturesInSight() needs to look at the level again.*/
+  bool needsSightUpdate() const;
+
+  /** Looks at the level for getCreaturesInSight() ahead of time. Doesn't change anything else, so it can be
+    * called for many creatures in parallel, right after Level::precomputeSight.*/
+  void updateSight();
   void tick(double realTime);
 
   string getTheName() const;
@@ -178,6 +190,12 @@ class Creature : public CreatureAttributes, public CreatureView, public UniqueEn
   Item* getWeapon() const;
 
   Optional<Vec2> getMoveTowards(Vec2 pos, bool avoidEnemies = false);
+  /** Moves towards the closest of \paramname{targets} using a flow field shared with other creatures
+    * heading the same way. Use for common destinations.*/
+  Optional<Vec2> getSharedMoveTowards(const vector<Vec2>& targets);
+  /** Moves towards a target that changes position often, like the keeper. Creatures far away share
+    * a flow field towards the target's cluster, close ones search their own path.*/
+  Optional<Vec2> getSharedMoveTowardsMoving(Vec2 target);
   Optional<Vec2> getMoveAway(Vec2 pos, bool pathfinding = true);
   Optional<Vec2> continueMoving();
   bool atTarget() const;
@@ -207,6 +225,8 @@ class Creature : public CreatureAttributes, public CreatureView, public UniqueEn
   double getSpeed() const;
   CreatureSize getSize() const;
 
+  /** Lets the creature see other creatures regardless of its field of view, but never further
+    * than FieldOfView::sightRange.*/
   class Vision {
     public:
     virtual bool canSee(const Creature*, const Creature*) = 0;
@@ -251,6 +271,10 @@ class Creature : public CreatureAttributes, public CreatureView, public UniqueEn
   void updateViewObject();
   int getStrengthAttackBonus() const;
   int getAttrVal(AttrType type) const;
+  int computeAttr(AttrType type) const;
+  /** Forgets the cached attributes. Must be called whenever something that getAttr() depends on changes.*/
+  void invalidateAttributes();
+  void resetAttrCache() const;
   int getToHit() const;
   BodyPart getBodyPart(AttackLevel attack) const;
   bool isFireResistant() const;
@@ -301,6 +325,32 @@ class Creature : public CreatureAttributes, public CreatureView, public UniqueEn
   mutable vector<const Creature*> SERIAL(kills);
   mutable double SERIAL2(difficultyPoints, 0);
   int SERIAL2(points, 0);
+  /** Results of getAttr(), -1 if not computed yet. Besides invalidateAttributes(), they are dropped when the
+    * equipment, health or tribe handicap changes, or when a lasting effect runs out, as those can happen
+    * without the creature being told.*/
+  struct AttrCache {
+    static const int numTypes = int(AttrType::INV_LIMIT) + 1;
+    int values[numTypes];
+    bool valid = false;
+    double health;
+    double validUntil;
+    int equipmentVersion;
+    int itemVersion;
+    int handicap;
+  };
+  mutable AttrCache attrCache;
+  /** Result of Level::getVisibleCreatures() for the creature's position, kept until the level tells that
+    * something nearby has changed.*/
+  struct SightCache {
+    const Level* level = nullptr;
+    Vec2 position;
+    int numChanges;
+    vector<Creature*> creatures;
+  };
+  mutable SightCache sightCache;
+  bool isSightCacheValid() const;
+  void setSightCache(vector<Creature*>) const;
+  static bool cacheChecks;
 };
 
 struct SpellInfo {
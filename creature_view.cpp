@@ -12,7 +12,7 @@ SERIALIZABLE(CreatureView);
 
 void CreatureView::updateVisibleEnemies() {
   visibleEnemies.clear();
-  for (const Creature* c : getLevel()->getAllCreatures()) 
+  for (const Creature* c : getCreaturesInSight())
     if (isEnemy(c) && (canSee(c)))
       visibleEnemies.push_back(c);
   for (const Creature* c : getUnknownAttacker())
@@ -20,6 +20,10 @@ void CreatureView::updateVisibleEnemies() {
       visibleEnemies.push_back(c);
 }
 
+vector<Creature*> CreatureView::getCreaturesInSight() const {
+  return getLevel()->getAllCreatures();
+}
+
 vector<const Creature*> CreatureView::getVisibleEnemies() const {
   return visibleEnemies;
 }
@@ -10,6 +10,11 @@ class CreatureView {
   public:
   virtual const MapMemory& getMemory() const = 0;
   virtual ViewIndex getViewIndex(Vec2 pos) const = 0;
+
+  /** Returns a number that changes whenever getViewIndex may change for a reason that the level doesn't
+    * record with Level::addViewChange, like the player marking squares.*/
+  virtual int getViewVersion() const { return 0; }
+
   virtual void refreshGameInfo(View::GameInfo&) const = 0;
   virtual Vec2 getPosition() const = 0;
   virtual bool staticPosition() const { return true; }
@@ -20,6 +25,9 @@ class CreatureView {
   virtual Tribe* getTribe() const = 0;
   virtual bool isEnemy(const Creature*) const = 0;
 
+  /** Returns the creatures that canSee(const Creature*) may be true for. By default all creatures on the level.*/
+  virtual vector<Creature*> getCreaturesInSight() const;
+
   void updateVisibleEnemies();
   vector<const Creature*> getVisibleEnemies() const;
 
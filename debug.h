@@ -18,23 +18,6 @@
 #define TRY(exp, msg) exp
 #endif
 
-#ifndef WINDOWS
-
-#define MEASURE(exp, text) do { \
-  timeval time1; \
-  gettimeofday(&time1, nullptr); \
-  suseconds_t m1 = time1.tv_usec + time1.tv_sec * 1000000; \
-  exp; \
-  gettimeofday(&time1, nullptr); \
-  suseconds_t m2 = time1.tv_usec + time1.tv_sec * 1000000; \
-  Debug() << text << " " << int(m2 - m1);} while(0);
-
-#else
-
-#define MEASURE(exp, text) exp;
-
-#endif
-
 enum DebugType { INFO, FATAL };
 
 class NoDebug {
@@ -301,7 +301,7 @@ static void teleport(Creature* c) {
   vector<Vec2> good;
   int maxW = 0;
   for (Vec2 v : l->getBounds().intersection(Rectangle(pos - teleRadius, pos + teleRadius))) {
-    if (!l->canMoveCreature(c, v - pos) || l->getSquare(v)->isBurning() || l->getSquare(v)->getPoisonGasAmount() > 0)
+    if (!l->canMoveCreature(c, v - pos) || l->isBurning(v) || l->hasPoisonGas(v))
       continue;
     if (weight[v] == maxW)
       good.push_back(v);
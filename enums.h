@@ -268,6 +268,7 @@ enum class ItemId { KNIFE,
   TERROR_TRAP_ITEM,
 };
 
+/** FLOOR_BACKGROUND has to stay the last layer, ViewIndex keeps an object for each one up to it.*/
 enum class ViewLayer {
   CREATURE,
   LARGE_ITEM,
@@ -45,12 +45,14 @@ EquipmentSlot Equipment::getSlot(const Item* item) const {
 }
 
 void Equipment::equip(Item* item, EquipmentSlot slot) {
+  ++version;
   items[slot] = item;
   CHECK(hasItem(item));
 }
 
 void Equipment::unequip(EquipmentSlot slot) {
   CHECK(items.count(slot) > 0);
+  ++version;
   items.erase(slot);
 }
 
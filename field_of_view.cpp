@@ -3,18 +3,59 @@
 #include "field_of_view.h"
 
 template <class Archive> 
-void FieldOfView::serialize(Archive& ar, const unsigned int version) {
-  ar & SVAR(squares)
-     & SVAR(visibility);
+void OpacityMap::serialize(Archive& ar, const unsigned int version) {
+  ar & SVAR(width)
+     & SVAR(height)
+     & SVAR(rows)
+     & SVAR(columns);
   CHECK_SERIAL;
 }
 
+SERIALIZABLE(OpacityMap);
+
+template <class Archive>
+void FieldOfView::CacheEntry::serialize(Archive& ar, const unsigned int version) {
+  ar & BOOST_SERIALIZATION_NVP(origin)
+     & BOOST_SERIALIZATION_NVP(visibility)
+     & BOOST_SERIALIZATION_NVP(used);
+}
+
+template <class Archive>
+void FieldOfView::save(Archive& ar, const unsigned int version) const {
+  ar << BOOST_SERIALIZATION_NVP(opacity)
+     << BOOST_SERIALIZATION_NVP(cacheSize)
+     << BOOST_SERIALIZATION_NVP(serializeCache);
+  if (serializeCache)
+    ar << BOOST_SERIALIZATION_NVP(cache)
+       << BOOST_SERIALIZATION_NVP(clockHand)
+       << BOOST_SERIALIZATION_NVP(changedSquares);
+}
+
+template <class Archive>
+void FieldOfView::load(Archive& ar, const unsigned int version) {
+  ar >> BOOST_SERIALIZATION_NVP(opacity)
+     >> BOOST_SERIALIZATION_NVP(cacheSize)
+     >> BOOST_SERIALIZATION_NVP(serializeCache);
+  initAreas();
+  if (serializeCache) {
+    ar >> BOOST_SERIALIZATION_NVP(cache)
+       >> BOOST_SERIALIZATION_NVP(clockHand)
+       >> BOOST_SERIALIZATION_NVP(changedSquares);
+    for (int i : All(cache)) {
+      cacheIndex[cache[i].origin] = i;
+      areas[getArea(cache[i].origin)].push_back(i);
+    }
+  }
+}
+
 SERIALIZABLE(FieldOfView);
+// serialize() is inline, so other files call save and load directly.
+template void FieldOfView::save(boost::archive::binary_oarchive&, unsigned) const;
+template void FieldOfView::load(boost::archive::binary_iarchive&, unsigned);
 
 template <class Archive> 
 void FieldOfView::Visibility::serialize(Archive& ar, const unsigned int version) {
   ar& SVAR(visible)
-    & SVAR(visibleTiles)
     & SVAR(px)
     & SVAR(py);
   CHECK_SERIAL;
@@ -22,113 +63,330 @@ void FieldOfView::Visibility::serialize(Archive& ar, const unsigned int version)
 
 SERIALIZABLE(FieldOfView::Visibility);
 
-FieldOfView::FieldOfView(const Table<PSquare>& s) : squares(&s), visibility(s.getWidth(), s.getHeight()) {
+// Lines are padded with 64 opaque squares on both sides, so that any 64 squares starting
+// within the bounds can be read from two neighboring words.
+static int getLineWords(int length) {
+  return (length + 128 + 63) / 64;
 }
 
-bool FieldOfView::canSee(Vec2 from, Vec2 to) {
-  if ((from - to).lengthD() > sightRange)
-    return false;
-  if (!visibility[from])
-    visibility[from] = Visibility(*squares, from.x, from.y);
-  return visibility[from]->checkVisible(to.x - from.x, to.y - from.y);
+OpacityMap::OpacityMap(int w, int h) : width(w), height(h), rows(h * getLineWords(w), ~0ull),
+    columns(w * getLineWords(h), ~0ull) {
+  for (Vec2 v : Rectangle(w, h))
+    setOpaque(v, false);
 }
-  
-void FieldOfView::squareChanged(Vec2 pos) {
-  vector<Vec2> updateList;
-  if (!visibility[pos])
-    visibility[pos] = Visibility(*squares, pos.x, pos.y);
-  vector<Vec2> visible = visibility[pos]->getVisibleTiles();
-  for (Vec2 v : visible)
-    if (visibility[v] && visibility[v]->checkVisible(pos.x - v.x, pos.y - v.y)) {
-      visibility[v] = Nothing();
+
+uint64_t OpacityMap::getBits(const vector<uint64_t>& lines, int lineLength, int line, int start) {
+  int index = start + 64;
+  const uint64_t* words = lines.data() + line * getLineWords(lineLength) + index / 64;
+  int shift = index % 64;
+  if (shift == 0)
+    return words[0];
+  else
+    return (words[0] >> shift) | (words[1] << (64 - shift));
+}
+
+void OpacityMap::setBit(vector<uint64_t>& lines, int lineLength, int line, int index, bool value) {
+  uint64_t& word = lines[line * getLineWords(lineLength) + (index + 64) / 64];
+  uint64_t bit = 1ull << ((index + 64) % 64);
+  if (value)
+    word |= bit;
+  else
+    word &= ~bit;
+}
+
+void OpacityMap::setOpaque(Vec2 pos, bool opaque) {
+  setBit(rows, width, pos.y, pos.x, opaque);
+  setBit(columns, height, pos.x, pos.y, opaque);
+}
+
+bool OpacityMap::isOpaque(Vec2 pos) const {
+  return getRow(pos.y, pos.x) & 1;
+}
+
+int OpacityMap::getWidth() const {
+  return width;
+}
+
+int OpacityMap::getHeight() const {
+  return height;
+}
+
+uint64_t OpacityMap::getRow(int y, int x) const {
+  if (y < 0 || y >= height || x < -64 || x >= width)
+    return ~0ull;
+  return getBits(rows, width, y, x);
+}
+
+uint64_t OpacityMap::getColumn(int x, int y) const {
+  if (x < 0 || x >= width || y < -64 || y >= height)
+    return ~0ull;
+  return getBits(columns, height, x, y);
+}
+
+FieldOfView::FieldOfView(const OpacityMap& o, int size, bool serialize) : opacity(&o), cacheSize(size),
+    serializeCache(serialize) {
+  CHECK(cacheSize > 0);
+  initAreas();
+}
+
+void FieldOfView::initAreas() {
+  areas = Table<vector<int>>((opacity->getWidth() + areaSize - 1) / areaSize,
+      (opacity->getHeight() + areaSize - 1) / areaSize);
+}
+
+Vec2 FieldOfView::getArea(Vec2 pos) const {
+  return Vec2(pos.x / areaSize, pos.y / areaSize);
+}
+
+const FieldOfView::Visibility& FieldOfView::getVisibility(Vec2 from) {
+  applyChanges();
+  auto elem = cacheIndex.find(from);
+  if (elem != cacheIndex.end()) {
+    ++numHits;
+    cache[elem->second].used = true;
+    return cache[elem->second].visibility;
+  }
+  ++numMisses;
+  return addToCache(from, Visibility(*opacity, from.x, from.y));
+}
+
+const FieldOfView::Visibility& FieldOfView::addToCache(Vec2 from, const Visibility& visibility) {
+  int index;
+  if (cache.size() < cacheSize) {
+    index = cache.size();
+    cache.push_back({from, visibility, true});
+  } else {
+    // Give every recently used entry a second chance.
+    while (cache[clockHand].used) {
+      cache[clockHand].used = false;
+      clockHand = (clockHand + 1) % cache.size();
     }
+    index = clockHand;
+    clockHand = (clockHand + 1) % cache.size();
+    cacheIndex.erase(cache[index].origin);
+    removeElement(areas[getArea(cache[index].origin)], index);
+    cache[index] = {from, visibility, true};
+  }
+  cacheIndex[from] = index;
+  areas[getArea(from)].push_back(index);
+  return cache[index].visibility;
 }
 
-void FieldOfView::Visibility::setVisible(int x, int y) {
-  if (!visible[x + sightRange][y + sightRange] && x * x + y * y <= sightRange * sightRange) {
-    visible[x + sightRange][y + sightRange] = 1;
-    visibleTiles.push_back(Vec2(px + x, py + y));
+void FieldOfView::precompute(const vector<Vec2>& from) {
+  applyChanges();
+  vector<Vec2> missing;
+  for (Vec2 v : from)
+    if (!cacheIndex.count(v))
+      missing.push_back(v);
+  sort(missing.begin(), missing.end());
+  missing.erase(unique(missing.begin(), missing.end()), missing.end());
+  vector<unique_ptr<Visibility>> results(missing.size());
+  vector<function<void()>> tasks;
+  for (int i : All(missing))
+    tasks.push_back([&, i] { results[i].reset(new Visibility(*opacity, missing[i].x, missing[i].y)); });
+  runInParallel(tasks);
+  numMisses += missing.size();
+  for (int i : All(missing))
+    addToCache(missing[i], *results[i]);
+}
+
+void FieldOfView::removeFromCache(int index) {
+  cacheIndex.erase(cache[index].origin);
+  removeElement(areas[getArea(cache[index].origin)], index);
+  int last = cache.size() - 1;
+  if (index < last) {
+    cache[index] = cache.back();
+    cacheIndex[cache[index].origin] = index;
+    vector<int>& area = areas[getArea(cache[index].origin)];
+    *std::find(area.begin(), area.end(), last) = index;
   }
+  cache.pop_back();
+  if (clockHand >= cache.size())
+    clockHand = 0;
+}
+
+void FieldOfView::squareChanged(Vec2 pos) {
+  changedSquares.push_back(pos);
 }
 
-static int totalIter = 0;
-static int numSamples = 0;
-
-FieldOfView::Visibility::Visibility(const Table<PSquare>& squares, int x, int y) : px(x), py(y) {
-  memset(visible, 0, (2 * sightRange + 1) * (2 * sightRange + 1));
-  calculate(2 * sightRange, 2 * sightRange,2 * sightRange, 2,-1,1,1,1,
-      [&](int px, int py) { return !squares[x + px][y + py]->canSeeThru(); },
-      [&](int px, int py) { setVisible(px ,py); });
-  calculate(2 * sightRange, 2 * sightRange,2 * sightRange, 2,-1,1,1,1,
-      [&](int px, int py) { return !squares[x + py][y - px]->canSeeThru(); },
-      [&](int px, int py) { setVisible(py, -px); });
-  calculate(2 * sightRange, 2 * sightRange,2 * sightRange,2,-1,1,1,1,
-      [&](int px, int py) { return !squares[x - px][y - py]->canSeeThru(); },
-      [&](int px, int py) { setVisible(-px, -py); });
-  calculate(2 * sightRange, 2 * sightRange,2 * sightRange,2,-1,1,1,1,
-      [&](int px, int py) { return !squares[x - py][y + px]->canSeeThru(); },
-      [&](int px, int py) { setVisible(-py, px); });
-  setVisible(0, 0);
-  ++numSamples;
-  totalIter += visibleTiles.size();
-  if (numSamples%100 == 0)
-    Debug() << numSamples << " iterations " << totalIter / numSamples << " avg";
-}
-
-const vector<Vec2>& FieldOfView::Visibility::getVisibleTiles() const {
-  return visibleTiles;
-}
-
-const vector<Vec2>& FieldOfView::getVisibleTiles(Vec2 from) {
-  if (!visibility[from]) {
-    visibility[from] = Visibility(*squares, from.x, from.y);
+void FieldOfView::applyChanges() {
+  if (changedSquares.empty())
+    return;
+  sort(changedSquares.begin(), changedSquares.end());
+  changedSquares.erase(unique(changedSquares.begin(), changedSquares.end()), changedSquares.end());
+  for (Vec2 pos : changedSquares) {
+    Rectangle nearby = Rectangle(getArea(pos - Vec2(sightRange, sightRange)),
+        getArea(pos + Vec2(sightRange, sightRange)) + Vec2(1, 1)).intersection(areas.getBounds());
+    for (Vec2 area : nearby)
+      for (int i = areas[area].size() - 1; i >= 0; --i) {
+        // Removing a result may move the last one into its place, so the index is read again.
+        int index = areas[area][i];
+        Vec2 origin = cache[index].origin;
+        if (cache[index].visibility.checkVisible(pos.x - origin.x, pos.y - origin.y))
+          removeFromCache(index);
+      }
   }
-  return visibility[from]->getVisibleTiles();
+  changedSquares.clear();
+}
+
+int FieldOfView::getNumHits() const {
+  return numHits;
+}
+
+int FieldOfView::getNumMisses() const {
+  return numMisses;
+}
+
+int FieldOfView::getNumCached() const {
+  return cache.size();
 }
 
+bool FieldOfView::canSee(Vec2 from, Vec2 to) {
+  if ((from - to).lengthD() > sightRange)
+    return false;
+  return getVisibility(from).checkVisible(to.x - from.x, to.y - from.y);
+}
 
-void FieldOfView::Visibility::calculate(int left, int right, int up, int h, int x1, int y1, int x2, int y2,
-    function<bool (int, int)> isBlocking, function<void (int, int)> setVisible){
-  if (y2*x1>=y1*x2) return;
-  if (h>up) return;
-  int leftx=x1, lefty=y1, rightx=x2, righty=y2;
-  int left_v=(int)floor((double)x1/y1*(h)), 
-      right_v=(int)ceil((double)x2/y2*(h)),
-      left_b=(int)floor((double)x1/y1*(h-1)),
-      right_b=(int)ceil((double)x2/y2*(h+1));
+bool FieldOfView::canSeeReadOnly(Vec2 from, Vec2 to) const {
+  CHECK(changedSquares.empty()) << "Changed squares not applied";
+  if ((from - to).lengthD() > sightRange)
+    return false;
+  auto elem = cacheIndex.find(from);
+  if (elem != cacheIndex.end())
+    return cache[elem->second].visibility.checkVisible(to.x - from.x, to.y - from.y);
+  return Visibility(*opacity, from.x, from.y).checkVisible(to.x - from.x, to.y - from.y);
+}
+  
+static uint64_t reverseBits(uint64_t x) {
+  x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+  x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+  x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+  x = ((x >> 8) & 0x00FF00FF00FF00FFull) | ((x & 0x00FF00FF00FF00FFull) << 8);
+  x = ((x >> 16) & 0x0000FFFF0000FFFFull) | ((x & 0x0000FFFF0000FFFFull) << 16);
+  return (x >> 32) | (x << 32);
+}
+
+// Transposes a 64x64 bit matrix, where bit j of a[i] is the element in row i and column j.
+static void transpose(uint64_t a[64]) {
+  uint64_t mask = 0x00000000FFFFFFFFull;
+  for (int j = 32; j > 0; j /= 2, mask ^= mask << j)
+    for (int k = 0; k < 64; k = (k + j + 1) & ~j) {
+      uint64_t t = ((a[k] >> j) ^ a[k + j]) & mask;
+      a[k] ^= t << j;
+      a[k + j] ^= t;
+    }
+}
+
+// Shadowcasting within one quadrant. Row r of blocking and visible holds the squares at distance r
+// from the origin along the quadrant's axis, bit i + range for the square i to the side. The arguments
+// are the same as in the original per-square version, with the coordinates doubled.
+static void castQuadrant(const uint64_t* blocking, uint64_t* visible, int range, int h,
+    int x1, int y1, int x2, int y2) {
+  if (y2 * x1 >= y1 * x2 || h > 2 * range)
+    return;
+  int leftx = x1, lefty = y1;
+  int left_v = (int)floor((double)x1 / y1 * h),
+      right_v = (int)ceil((double)x2 / y2 * h),
+      left_b = (int)floor((double)x1 / y1 * (h - 1));
   if (left_v % 2)
     ++left_v;
   if (right_v % 2)
     --right_v;
-  if(left_b % 2)
+  if (left_b % 2)
     ++left_b;
-  if(right_b % 2)
-    --right_b;
-
-  if(left_b>=-left && left_b<=right && isBlocking(left_b/2,h/2)){
-    leftx=left_b+1;
-    lefty=h+(left_b>=0?-1:1);
+  uint64_t row = blocking[h / 2];
+  if (left_b >= -2 * range && left_b <= 2 * range && ((row >> (left_b / 2 + range)) & 1)) {
+    leftx = left_b + 1;
+    lefty = h + (left_b >= 0 ? -1 : 1);
   }
-  if(left_v<-left) left_v=-left;
-  if(right_v>right) right_v=right;
-  bool prevBlocking = false;
-  for (int i=left_v/2;i<=right_v/2;++i){
-    setVisible(i, h / 2);
-    bool blocking = isBlocking(i, h / 2);
-    if(i > left_v / 2 && blocking && !prevBlocking)
-      calculate(left, right, up, h + 2, leftx, lefty, i * 2 - 1, h + (i<=0 ? -1:1), isBlocking, setVisible);
-    if(blocking){
-      leftx=i*2+1;
-      lefty=h+(i>=0?-1:1);
+  left_v = max(left_v, -2 * range);
+  right_v = min(right_v, 2 * range);
+  int first = left_v / 2 + range, last = right_v / 2 + range;
+  if (first <= last) {
+    uint64_t span = ((2ull << (last - first)) - 1) << first;
+    visible[h / 2] |= span;
+    // Every run of blocking squares casts a shadow. The unblocked part before it is continued
+    // in a separate call.
+    for (uint64_t runs = row & span; runs; ) {
+      int start = __builtin_ctzll(runs);
+      int length = __builtin_ctzll(~(runs >> start));
+      int i = start - range, end = start + length - 1 - range;
+      if (start > first)
+        castQuadrant(blocking, visible, range, h + 2, leftx, lefty, i * 2 - 1, h + (i <= 0 ? -1 : 1));
+      leftx = end * 2 + 1;
+      lefty = h + (end >= 0 ? -1 : 1);
+      runs &= ~(((1ull << length) - 1) << start);
     }
-    prevBlocking = blocking;
   }
-  calculate(left, right, up, h + 2, leftx, lefty, rightx, righty, isBlocking, setVisible);
+  castQuadrant(blocking, visible, range, h + 2, leftx, lefty, x2, y2);
+}
+
+static vector<uint64_t> getCircleMask(int range) {
+  vector<uint64_t> ret;
+  for (int dy : Range(-range, range + 1)) {
+    ret.push_back(0);
+    for (int dx : Range(-range, range + 1))
+      if (dx * dx + dy * dy <= range * range)
+        ret.back() |= 1ull << (dx + range);
+  }
+  return ret;
+}
+
+FieldOfView::Visibility::Visibility(const OpacityMap& opacity, int x, int y) : px(x), py(y) {
+  const int range = sightRange;
+  const int width = 2 * range + 1;
+  // The quadrants are rotated to point up, their rows are read from the map, reversing them
+  // where the quadrant's x axis points opposite to the map's.
+  uint64_t blocking[4][range + 1];
+  uint64_t quadrant[4][range + 1] = {};
+  for (int r : Range(range + 1)) {
+    blocking[0][r] = opacity.getRow(y + r, x - range);
+    blocking[1][r] = reverseBits(opacity.getColumn(x + r, y - range)) >> (64 - width);
+    blocking[2][r] = reverseBits(opacity.getRow(y - r, x - range)) >> (64 - width);
+    blocking[3][r] = opacity.getColumn(x - r, y - range);
+  }
+  for (int i : Range(4))
+    castQuadrant(blocking[i], quadrant[i], range, 2, -1, 1, 1, 1);
+  // Quadrants 0 and 2 give rows of the result, 1 and 3 give columns.
+  uint64_t columns[64] = {};
+  memset(visible, 0, sizeof(visible));
+  for (int r : Range(range + 1)) {
+    visible[range + r] |= quadrant[0][r];
+    visible[range - r] |= reverseBits(quadrant[2][r]) >> (64 - width);
+    columns[range + r] |= reverseBits(quadrant[1][r]) >> (64 - width);
+    columns[range - r] |= quadrant[3][r];
+  }
+  transpose(columns);
+  visible[range] |= 1ull << range;
+  static const vector<uint64_t> circle = getCircleMask(range);
+  // Squares outside the level are opaque, so they may be marked as seen.
+  uint64_t inside = 0;
+  for (int i : Range(width))
+    if (x + i - range >= 0 && x + i - range < opacity.getWidth())
+      inside |= 1ull << i;
+  for (int i : Range(width)) {
+    visible[i] = (visible[i] | columns[i]) & circle[i];
+    if (y + i - range < 0 || y + i - range >= opacity.getHeight())
+      visible[i] = 0;
+    visible[i] &= inside;
+  }
+}
+
+vector<Vec2> FieldOfView::Visibility::getVisibleTiles() const {
+  vector<Vec2> ret;
+  for (int i : Range(2 * sightRange + 1))
+    for (uint64_t bits = visible[i]; bits; bits &= bits - 1)
+      ret.push_back(Vec2(px + __builtin_ctzll(bits) - sightRange, py + i - sightRange));
+  return ret;
+}
+
+vector<Vec2> FieldOfView::getVisibleTiles(Vec2 from) {
+  return getVisibility(from).getVisibleTiles();
 }
 
 bool FieldOfView::Visibility::checkVisible(int x, int y) const {
   return x >= -sightRange && y >= -sightRange && x <= sightRange && y <= sightRange && 
-    visible[sightRange + x][sightRange + y] == 1;
+    ((visible[sightRange + y] >> (sightRange + x)) & 1);
 }
 
 
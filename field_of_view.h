@@ -1,49 +1,133 @@
 #ifndef _FIELD_OF_VIEW_H
 #define _FIELD_OF_VIEW_H
 
+#include <cstdint>
+
 #include "util.h"
 #include "square.h"
 
+/** Bitmap of squares that block vision. It's stored both by rows and by columns, so that a line of squares
+  * in either direction can be read a word at a time. Squares outside the bounds are opaque.*/
+class OpacityMap {
+  public:
+  OpacityMap(int width, int height);
+
+  void setOpaque(Vec2 pos, bool opaque);
+  bool isOpaque(Vec2 pos) const;
+  int getWidth() const;
+  int getHeight() const;
+
+  /** Returns 64 squares of row \paramname{y} starting at \paramname{x}, lowest bit first.*/
+  uint64_t getRow(int y, int x) const;
+
+  /** Returns 64 squares of column \paramname{x} starting at \paramname{y}, lowest bit first.*/
+  uint64_t getColumn(int x, int y) const;
+
+  SERIALIZATION_DECL(OpacityMap);
+
+  private:
+  static uint64_t getBits(const vector<uint64_t>& lines, int lineLength, int line, int start);
+  static void setBit(vector<uint64_t>& lines, int lineLength, int line, int index, bool value);
+
+  int SERIAL(width);
+  int SERIAL(height);
+  vector<uint64_t> SERIAL(rows);
+  vector<uint64_t> SERIAL(columns);
+};
+
+/** Calculates which squares are visible from other squares. Results are kept in a cache of limited size,
+  * where the least recently used ones are replaced, using the clock approximation.*/
 class FieldOfView {
   public:
-  FieldOfView(const Table<PSquare>& squares);
+  /** Keeps at most \paramname{cacheSize} results. If \paramname{serializeCache} is false, the results
+    * aren't saved, and are calculated again when needed after loading.*/
+  FieldOfView(const OpacityMap&, int cacheSize = defaultCacheSize, bool serializeCache = false);
   bool canSee(Vec2 from, Vec2 to);
-  const vector<Vec2>& getVisibleTiles(Vec2 from);
+  vector<Vec2> getVisibleTiles(Vec2 from);
+
+  /** Calculates the results for the squares in \paramname{from} that aren't cached yet, in parallel.*/
+  void precompute(const vector<Vec2>& from);
+
+  /** Same as canSee, but doesn't change the cache, so it can be called from many threads at a time.
+    * Results that aren't cached are calculated every time. Changed squares must be applied first,
+    * which precompute() does.*/
+  bool canSeeReadOnly(Vec2 from, Vec2 to) const;
+
+  /** Marks the results that see \paramname{pos} as invalid. Changes are collected and applied together
+    * before the next query, so a square that is changed many times within a turn costs one lookup.*/
   void squareChanged(Vec2 pos);
 
-  SERIALIZATION_DECL(FieldOfView);
+  int getNumHits() const;
+  int getNumMisses() const;
 
-  private:
+  /** Returns the number of cached results.*/
+  int getNumCached() const;
+
+  static const int defaultCacheSize = 4096;
+
+  template <class Archive>
+  void save(Archive& ar, const unsigned int version) const;
+
+  template <class Archive>
+  void load(Archive& ar, const unsigned int version);
+
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+
+  FieldOfView() {}
 
+  /** Squares further than this, measured with Vec2::dist8, are never visible.*/
   const static int sightRange = 30;
 
+  private:
+
   class Visibility {
     public:
 
     bool checkVisible(int x,int y) const;
-    const vector<Vec2>& getVisibleTiles() const;
+    vector<Vec2> getVisibleTiles() const;
 
-    Visibility(const Table<PSquare>& squares, int x, int y);
-    Visibility(Visibility&&) = default;
-    Visibility& operator = (Visibility&&) = default;
+    Visibility(const OpacityMap&, int x, int y);
 
     SERIALIZATION_DECL(Visibility);
 
     private:
-    char visible[sightRange * 2 + 1][sightRange * 2 + 1];
+    /** Row y + sightRange holds the visible squares with that y offset, bit x + sightRange for offset x.*/
+    uint64_t visible[sightRange * 2 + 1];
     SERIAL3(visible);
-    vector<Vec2> SERIAL(visibleTiles);
-    void calculate(int,int,int,int, int, int, int, int,
-        function<bool (int, int)> isBlocking,
-        function<void (int, int)> setVisible);
-    void setVisible(int, int);
 
     int SERIAL(px);
     int SERIAL(py);
   };
+
+  struct CacheEntry {
+    Vec2 origin;
+    Visibility visibility;
+    bool used;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version);
+  };
+
+  const Visibility& getVisibility(Vec2 from);
+  const Visibility& addToCache(Vec2 from, const Visibility&);
+  void removeFromCache(int index);
+  void applyChanges();
+  Vec2 getArea(Vec2 pos) const;
+  void initAreas();
   
-  const Table<PSquare>* SERIAL(squares);
-  Table<Optional<Visibility>> SERIAL(visibility);
+  const OpacityMap* opacity;
+  int cacheSize;
+  bool serializeCache;
+  vector<CacheEntry> cache;
+  unordered_map<Vec2, int> cacheIndex;
+  /** Indexes of cached results by the area of their origin. A changed square can only be seen
+    * from the areas within sightRange.*/
+  Table<vector<int>> areas;
+  static const int areaSize = 16;
+  vector<Vec2> changedSquares;
+  int clockHand = 0;
+  int numHits = 0;
+  int numMisses = 0;
 };
 
 #endif
@@ -0,0 +1,305 @@
+#include "stdafx.h"
+
+#include "field_simulation.h"
+#include "level.h"
+#include "creature.h"
+
+template <class Archive>
+void FieldSimulation::Chunk::serialize(Archive& ar, const unsigned int version) {
+  ar& BOOST_SERIALIZATION_NVP(gas)
+    & BOOST_SERIALIZATION_NVP(fire)
+    & BOOST_SERIALIZATION_NVP(burnt)
+    & BOOST_SERIALIZATION_NVP(weight)
+    & BOOST_SERIALIZATION_NVP(flamability)
+    & BOOST_SERIALIZATION_NVP(active);
+}
+
+template <class Archive>
+void FieldSimulation::serialize(Archive& ar, const unsigned int version) {
+  ar& SVAR(bounds)
+    & SVAR(activeChunks)
+    & SVAR(seed);
+  // Only the allocated chunks are saved, with their positions.
+  vector<Vec2> used;
+  if (!Archive::is_loading::value) {
+    for (Vec2 v : chunks.getBounds())
+      if (chunks[v])
+        used.push_back(v);
+  } else
+    chunks = Table<unique_ptr<Chunk>>((bounds.getW() + chunkSize - 1) / chunkSize,
+        (bounds.getH() + chunkSize - 1) / chunkSize);
+  ar& BOOST_SERIALIZATION_NVP(used);
+  for (Vec2 v : used) {
+    if (Archive::is_loading::value)
+      chunks[v].reset(new Chunk());
+    ar& boost::serialization::make_nvp("chunk", *chunks[v]);
+  }
+  CHECK_SERIAL;
+}
+
+SERIALIZABLE(FieldSimulation);
+
+// Same as in Fire.
+const float epsilon = 0.001;
+const float minGas = 0.1;
+const float gasDecrease = 0.001;
+const float maxGas = 3;
+// The most gas that moves to a neighbor in one turn, diagonal neighbors get half.
+const float gasSpread = 0.1;
+
+static const Vec2 directions[8] = {{0, -1}, {1, 0}, {0, 1}, {-1, 0}, {1, -1}, {1, 1}, {-1, 1}, {-1, -1}};
+static const float spreadWeights[8] = {
+    gasSpread, gasSpread, gasSpread, gasSpread, gasSpread / 2, gasSpread / 2, gasSpread / 2, gasSpread / 2};
+
+FieldSimulation::FieldSimulation(Rectangle b, int s) : bounds(b),
+    chunks((b.getW() + chunkSize - 1) / chunkSize, (b.getH() + chunkSize - 1) / chunkSize), seed(s) {
+}
+
+int FieldSimulation::getIndex(Vec2 pos) {
+  return (pos.y % chunkSize) * chunkSize + pos.x % chunkSize;
+}
+
+FieldSimulation::Chunk& FieldSimulation::getChunk(Vec2 pos) {
+  unique_ptr<Chunk>& chunk = chunks[pos / chunkSize];
+  if (!chunk)
+    chunk.reset(new Chunk());
+  return *chunk;
+}
+
+const FieldSimulation::Chunk* FieldSimulation::findChunk(Vec2 pos) const {
+  return chunks[pos / chunkSize].get();
+}
+
+void FieldSimulation::activate(Vec2 pos) {
+  Chunk& chunk = getChunk(pos);
+  if (!chunk.active) {
+    chunk.active = true;
+    activeChunks.push_back(pos / chunkSize);
+  }
+}
+
+bool FieldSimulation::setOnFire(Vec2 pos, double amount, double weight, double flamability) {
+  if (amount <= epsilon || flamability <= 0 || isBurntOut(pos))
+    return false;
+  Chunk& chunk = getChunk(pos);
+  int index = getIndex(pos);
+  bool wasBurning = chunk.fire[index] > 0;
+  chunk.weight[index] = weight;
+  chunk.flamability[index] = flamability;
+  chunk.fire[index] = max<float>(chunk.fire[index], amount * flamability);
+  activate(pos);
+  return !wasBurning;
+}
+
+void FieldSimulation::raiseFire(Vec2 pos, double amount) {
+  Chunk& chunk = getChunk(pos);
+  int index = getIndex(pos);
+  if (amount > epsilon)
+    chunk.fire[index] = max<float>(chunk.fire[index], amount * chunk.flamability[index]);
+}
+
+double FieldSimulation::getFire(Vec2 pos) const {
+  if (const Chunk* chunk = findChunk(pos))
+    return chunk->fire[getIndex(pos)];
+  return 0;
+}
+
+bool FieldSimulation::isBurntOut(Vec2 pos) const {
+  if (const Chunk* chunk = findChunk(pos))
+    return chunk->burnt[getIndex(pos)] > 1 - epsilon && chunk->fire[getIndex(pos)] == 0;
+  return false;
+}
+
+void FieldSimulation::addGas(Vec2 pos, double amount) {
+  CHECK(amount > 0);
+  Chunk& chunk = getChunk(pos);
+  float& gas = chunk.gas[getIndex(pos)];
+  gas = min<float>(maxGas, gas + amount);
+  activate(pos);
+}
+
+double FieldSimulation::getGas(Vec2 pos) const {
+  if (!pos.inRectangle(bounds))
+    return 0;
+  if (const Chunk* chunk = findChunk(pos))
+    return chunk->gas[getIndex(pos)];
+  return 0;
+}
+
+void FieldSimulation::clear(Vec2 pos) {
+  if (chunks[pos / chunkSize]) {
+    Chunk& chunk = getChunk(pos);
+    int index = getIndex(pos);
+    chunk.gas[index] = chunk.fire[index] = chunk.burnt[index] = 0;
+  }
+}
+
+int FieldSimulation::getNumActiveChunks() const {
+  return activeChunks.size();
+}
+
+float FieldSimulation::getRandom(int time, Vec2 pos, int index) const {
+  uint64_t x = uint64_t(seed) * 0x9e3779b97f4a7c15ull + uint64_t(time) * 0xc2b2ae3d27d4eb4full
+      + uint64_t(pos.x) * 0x165667b19e3779f9ull + uint64_t(pos.y) * 0xd6e8feb86659fd93ull + index;
+  // The finalizer of splitmix64.
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return float(x >> 40) / float(1 << 24);
+}
+
+// The amount of gas that moves from a square with gas1 to a neighbor with gas2.
+static float getGasFlow(float gas1, float gas2, float maxFlow) {
+  return gas1 > gas2 ? min(maxFlow, (gas1 - gas2) / 2) : 0;
+}
+
+void FieldSimulation::tickGas(Level* level) {
+  // Gas moves at most one square per turn, so the chunks next to gas on the border of an active chunk
+  // must be active too.
+  int numActive = activeChunks.size();
+  for (int i = 0; i < numActive; ++i) {
+    Vec2 origin = activeChunks[i] * chunkSize;
+    const Chunk& chunk = *chunks[activeChunks[i]];
+    for (int x : Range(chunkSize))
+      for (int y : Range(chunkSize))
+        if ((x == 0 || y == 0 || x == chunkSize - 1 || y == chunkSize - 1)
+            && chunk.gas[y * chunkSize + x] >= minGas)
+          for (Vec2 v : (origin + Vec2(x, y)).neighbors8())
+            if (v.inRectangle(bounds) && v / chunkSize != activeChunks[i])
+              activate(v);
+  }
+  // Each chunk is computed from a copy of itself and two squares around it, so that the inner loops don't
+  // need to look up chunks. All chunks read the amounts from before the turn.
+  const int size = chunkSize + 4;
+  vector<float> newGas(activeChunks.size() * chunkArea);
+  for (int i : All(activeChunks)) {
+    Vec2 origin = activeChunks[i] * chunkSize - Vec2(2, 2);
+    float gas[size][size];
+    float open[size][size];
+    float outFlow[size][size];
+    float scale[size][size];
+    for (int x : Range(size))
+      for (int y : Range(size)) {
+        Vec2 v = origin + Vec2(x, y);
+        gas[x][y] = getGas(v);
+        open[x][y] = level->canSeeThru(v) ? 1 : 0;
+      }
+    // A square can't give away more gas than it has, so the flows out of it are scaled down if needed.
+    for (int x = 1; x < size - 1; ++x)
+      for (int y = 1; y < size - 1; ++y) {
+        float out = 0;
+        if (gas[x][y] >= minGas)
+          for (int d : Range(8))
+            out += open[x + directions[d].x][y + directions[d].y]
+                * getGasFlow(gas[x][y], gas[x + directions[d].x][y + directions[d].y], spreadWeights[d]);
+        outFlow[x][y] = out;
+        scale[x][y] = out > gas[x][y] ? gas[x][y] / out : 1;
+      }
+    for (int x = 2; x < size - 2; ++x)
+      for (int y = 2; y < size - 2; ++y) {
+        float value = 0;
+        if (gas[x][y] >= minGas)
+          value = max<float>(0, gas[x][y] - outFlow[x][y] * scale[x][y] - gasDecrease);
+        float in = 0;
+        for (int d : Range(8)) {
+          int nx = x + directions[d].x;
+          int ny = y + directions[d].y;
+          if (gas[nx][ny] >= minGas)
+            in += getGasFlow(gas[nx][ny], gas[x][y], spreadWeights[d]) * scale[nx][ny];
+        }
+        newGas[i * chunkArea + (y - 2) * chunkSize + x - 2] = value + in * open[x][y];
+      }
+  }
+  for (int i : All(activeChunks))
+    std::copy(newGas.begin() + i * chunkArea, newGas.begin() + (i + 1) * chunkArea,
+        chunks[activeChunks[i]]->gas);
+}
+
+void FieldSimulation::tickFire(Level* level, int time) {
+  vector<pair<Vec2, float>> spread;
+  vector<Vec2> burntOut;
+  vector<pair<Vec2, float>> creatures;
+  for (Vec2 chunkPos : activeChunks) {
+    Chunk& chunk = *chunks[chunkPos];
+    for (int i : Range(chunkArea))
+      if (chunk.fire[i] > 0) {
+        Vec2 pos = chunkPos * chunkSize + Vec2(i % chunkSize, i / chunkSize);
+        float size = chunk.fire[i];
+        for (int d : Range(8)) {
+          Vec2 v = pos + directions[d];
+          if (v.inRectangle(bounds) && size > getRandom(time, pos, d) * 40)
+            spread.push_back({v, size / 20});
+        }
+        // Same as Fire::tick.
+        float& burnt = chunk.burnt[i];
+        float weight = chunk.weight[i];
+        burnt = min<float>(1, burnt + size / weight);
+        size += (burnt * weight - size) / 10;
+        size *= 1 - burnt;
+        if (size < epsilon && burnt > 1 - epsilon) {
+          size = 0;
+          burnt = 1;
+          burntOut.push_back(pos);
+        } else if (level->isOccupied(pos))
+          creatures.push_back({pos, size});
+        chunk.fire[i] = size;
+      }
+  }
+  for (Vec2 pos : burntOut) {
+    Square* square = level->getSquare(pos);
+    level->globalMessage(pos, "The " + square->getName() + " burns out");
+    square->burnOut();
+  }
+  for (auto& elem : spread) {
+    Vec2 pos = elem.first;
+    bool hasObjects = level->isOccupied(pos) || level->hasItems(pos);
+    if (getFire(pos) > 0 && !hasObjects)
+      raiseFire(pos, elem.second);
+    else if (hasObjects || (level->isFlammable(pos) && !isBurntOut(pos)))
+      level->getSquare(pos)->setOnFire(elem.second);
+  }
+  for (auto& elem : creatures)
+    if (Creature* c = level->getSquare(elem.first)->getCreature())
+      c->setOnFire(elem.second);
+}
+
+void FieldSimulation::tick(Level* level, int time) {
+  tickGas(level);
+  vector<Vec2> gassed;
+  for (Vec2 chunkPos : activeChunks) {
+    const Chunk& chunk = *chunks[chunkPos];
+    for (int i : Range(chunkArea))
+      if (chunk.gas[i] > 0.2) {
+        Vec2 pos = chunkPos * chunkSize + Vec2(i % chunkSize, i / chunkSize);
+        if (level->isOccupied(pos))
+          gassed.push_back(pos);
+      }
+  }
+  for (Vec2 pos : gassed)
+    if (Creature* c = level->getSquare(pos)->getCreature())
+      c->poisonWithGas(min(1.0, getGas(pos)));
+  tickFire(level, time);
+  // Chunks without fire and gas are not updated anymore, and are freed unless they remember burnt squares.
+  // The squares of the chunks that were updated may look different now.
+  for (int i = activeChunks.size() - 1; i >= 0; --i) {
+    Vec2 chunkPos = activeChunks[i];
+    if (!chunks[chunkPos])
+      continue;
+    Chunk& chunk = *chunks[chunkPos];
+    bool active = false;
+    bool burnt = false;
+    for (int j : Range(chunkArea)) {
+      active |= chunk.gas[j] > 0 || chunk.fire[j] > 0;
+      burnt |= chunk.burnt[j] > 0;
+      Vec2 pos = chunkPos * chunkSize + Vec2(j % chunkSize, j / chunkSize);
+      if (pos.inRectangle(bounds))
+        level->addViewChange(pos);
+    }
+    if (!active) {
+      chunk.active = false;
+      activeChunks.erase(activeChunks.begin() + i);
+      if (!burnt)
+        chunks[chunkPos].reset();
+    }
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef _FIELD_SIMULATION_H
+#define _FIELD_SIMULATION_H
+
+#include "util.h"
+
+class Level;
+
+/** Fire and poison gas on the squares of a level. The amounts are kept in dense arrays for chunks of the
+  * level, and only the chunks with some fire or gas in them are updated every turn. Squares and creatures
+  * are only called when something happens to them: a square catches fire or burns out, or a creature
+  * stands in fire or gas. Random events are decided by hashing the turn and position, so the results
+  * don't depend on the order in which the chunks are updated.*/
+class FieldSimulation {
+  public:
+  FieldSimulation(Rectangle bounds, int seed);
+
+  /** Raises the fire on the square to \paramname{amount} times \paramname{flamability}, unless it has already
+    * burnt out. \paramname{weight} is how long it takes to burn out. Returns true if the square has just
+    * caught fire.*/
+  bool setOnFire(Vec2 pos, double amount, double weight, double flamability);
+  double getFire(Vec2 pos) const;
+  bool isBurntOut(Vec2 pos) const;
+
+  void addGas(Vec2 pos, double amount);
+  double getGas(Vec2 pos) const;
+
+  /** Forgets the fire and gas on a square that was replaced.*/
+  void clear(Vec2 pos);
+
+  /** Advances the fire and gas by one turn.*/
+  void tick(Level*, int time);
+
+  /** Returns the number of chunks that are updated every turn.*/
+  int getNumActiveChunks() const;
+
+  static const int chunkSize = 8;
+
+  SERIALIZATION_DECL(FieldSimulation);
+
+  private:
+  static const int chunkArea = chunkSize * chunkSize;
+
+  struct Chunk {
+    float gas[chunkArea];
+    float fire[chunkArea];
+    float burnt[chunkArea];
+    float weight[chunkArea];
+    float flamability[chunkArea];
+    bool active;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version);
+  };
+
+  static int getIndex(Vec2 pos);
+  Chunk& getChunk(Vec2 pos);
+  const Chunk* findChunk(Vec2 pos) const;
+  void activate(Vec2 pos);
+  void tickGas(Level*);
+  void tickFire(Level*, int time);
+  /** Sets the fire to at least \paramname{amount} if the square is already burning.*/
+  void raiseFire(Vec2 pos, double amount);
+  float getRandom(int time, Vec2 pos, int index) const;
+
+  Rectangle SERIAL(bounds);
+  /** Chunks that had fire or gas in them recently, or have some burnt squares. The others are null.*/
+  Table<unique_ptr<Chunk>> chunks;
+  vector<Vec2> SERIAL(activeChunks);
+  int SERIAL(seed);
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "stdafx.h"
+
+#include "flow_field.h"
+#include "level.h"
+#include "creature.h"
+
+const int FlowField::infinity;
+
+FlowField::MovementClass FlowField::getMovementClass(const Creature* c) {
+  return make_tuple(c->canWalk(), c->canFly(), c->canSwim(), c->getSize(), c->getTribe(), c->isBlind(),
+      c->isHeld(), c->isInvincible());
+}
+
+FlowField::FlowField(const Level* l, const vector<Vec2>& targets) : level(l), distance(l->getBounds(), infinity) {
+  for (Vec2 v : targets) {
+    distance[v] = 0;
+    queue.push_back({0, v});
+  }
+  make_heap(queue.begin(), queue.end());
+}
+
+// Returns 0 if the square can't be entered at all.
+static int getEntryCost(const Level::Passability& movement, Vec2 pos) {
+  if (movement.canEnterEmpty(pos))
+    return 1;
+  if (movement.canDestroy(pos))
+    return 5;
+  return 0;
+}
+
+void FlowField::expand(const Creature* c, Vec2 pos) {
+  static const vector<Vec2> directions = Vec2::directions8();
+  if (queue.empty() || queue.front().distance > distance[pos])
+    return;
+  Level::Passability movement = level->getPassability(c);
+  while (!queue.empty() && queue.front().distance <= distance[pos]) {
+    pop_heap(queue.begin(), queue.end());
+    QElem elem = queue.back();
+    queue.pop_back();
+    if (elem.distance > distance[elem.pos])
+      continue;
+    for (Vec2 dir : directions) {
+      Vec2 next = elem.pos + dir;
+      if (next.inRectangle(distance.getBounds()) && distance[next] > elem.distance + 1) {
+        int cost = getEntryCost(movement, next);
+        if (cost == 0)
+          // Remember blocked squares so that they are not checked again.
+          distance[next] = blocked;
+        else if (elem.distance + cost < distance[next]) {
+          distance[next] = elem.distance + cost;
+          queue.push_back({distance[next], next});
+          push_heap(queue.begin(), queue.end());
+        }
+      }
+    }
+  }
+}
+
+Optional<int> FlowField::getDistance(const Creature* c, Vec2 pos) {
+  expand(c, pos);
+  if (distance[pos] != blocked && distance[pos] < infinity)
+    return distance[pos];
+  else
+    return Nothing();
+}
+
+Optional<Vec2> FlowField::getNextMove(const Creature* c) {
+  Vec2 pos = c->getPosition();
+  if (!getDistance(c, pos))
+    return Nothing();
+  // All squares closer to the targets than pos are final after expanding up to pos.
+  Optional<Vec2> ret;
+  int lowest = distance[pos];
+  for (Vec2 dir : Vec2::directions8())
+    if ((pos + dir).inRectangle(distance.getBounds()) && distance[pos + dir] != blocked
+        && distance[pos + dir] < lowest && c->canMove(dir)) {
+      lowest = distance[pos + dir];
+      ret = dir;
+    }
+  if (ret)
+    return ret;
+  // The way is blocked, most likely by other creatures, which the distances don't account for.
+  // Step aside to make room or to get around them.
+  for (Vec2 dir : Vec2::directions8())
+    if ((pos + dir).inRectangle(distance.getBounds()) && distance[pos + dir] == distance[pos]
+        && c->canMove(dir))
+      return dir;
+  return Nothing();
+}
+
+bool FlowField::isAffected(Vec2 pos) const {
+  for (Vec2 v : concat<Vec2>({pos}, pos.neighbors8()))
+    if (v.inRectangle(distance.getBounds()) && distance[v] < infinity)
+      return true;
+  return false;
+}
@@ -0,0 +1,54 @@
+#ifndef _FLOW_FIELD_H
+#define _FLOW_FIELD_H
+
+#include "util.h"
+#include "creature_attributes.h"
+
+class Level;
+class Creature;
+class Tribe;
+
+/** Distances to the closest of a set of targets, shared by all creatures that move the same way.
+  * The distances are computed outwards from the targets, only as far as needed to answer the queries
+  * made so far, so nearby creatures don't pay for searching the whole level.*/
+class FlowField {
+  public:
+  /** Attributes of a creature that decide which squares it can enter or destroy: walking, flying, swimming,
+    * size, tribe, blindness, being held and invincibility.*/
+  typedef tuple<bool, bool, bool, CreatureSize, const Tribe*, bool, bool, bool> MovementClass;
+  static MovementClass getMovementClass(const Creature*);
+
+  FlowField(const Level*, const vector<Vec2>& targets);
+
+  /** Returns the direction of the next step towards the closest target. Squares taken by other creatures
+    * aren't accounted for in the distances, so if no closer square is free, a free one at the same
+    * distance is returned. Returns nothing if there isn't any.*/
+  Optional<Vec2> getNextMove(const Creature*);
+
+  /** Returns the distance from \paramname{pos} to the closest target, or nothing if it can't be reached.
+    * The \paramname{creature} must belong to the field's movement class.*/
+  Optional<int> getDistance(const Creature*, Vec2 pos);
+
+  /** Checks if the distances computed so far could depend on the square at \paramname{pos}.*/
+  bool isAffected(Vec2 pos) const;
+
+  private:
+  static const int infinity = 1000000000;
+  static const int blocked = -1;
+
+  struct QElem {
+    int distance;
+    Vec2 pos;
+    bool operator < (const QElem& other) const {
+      return distance > other.distance;
+    }
+  };
+
+  void expand(const Creature*, Vec2 pos);
+
+  const Level* level;
+  Table<int> distance;
+  vector<QElem> queue;
+};
+
+#endif
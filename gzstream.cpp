@@ -29,6 +29,13 @@
 #include "gzstream.h"
 #include <iostream>
 #include <string.h>  // for memcpy
+#include <stdio.h>   // for snprintf
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
 
 #ifdef GZSTREAM_NAMESPACE
 namespace GZSTREAM_NAMESPACE {
@@ -42,25 +49,34 @@ namespace GZSTREAM_NAMESPACE {
 // class gzstreambuf:
 // --------------------------------------
 
-gzstreambuf* gzstreambuf::open( const char* name, int open_mode) {
+gzstreambuf* gzstreambuf::open( const char* name, int open_mode, long offset, int level) {
     if ( is_open())
         return (gzstreambuf*)0;
     mode = open_mode;
-    // no append nor read/write mode
-    if ((mode & std::ios::ate) || (mode & std::ios::app)
-        || ((mode & std::ios::in) && (mode & std::ios::out)))
+    // no read/write mode, append only for writing, offset only for reading
+    if ((mode & std::ios::ate) || ((mode & std::ios::in) && (mode & std::ios::out))
+        || ((mode & std::ios::app) && (mode & std::ios::in)) || (offset > 0 && !(mode & std::ios::in)))
         return (gzstreambuf*)0;
     char  fmode[10];
-    char* fmodeptr = fmode;
     if ( mode & std::ios::in)
-        *fmodeptr++ = 'r';
-    else if ( mode & std::ios::out)
-        *fmodeptr++ = 'w';
-    *fmodeptr++ = 'b';
-    *fmodeptr = '\0';
-    file = gzopen( name, fmode);
+        snprintf( fmode, sizeof(fmode), "rb");
+    else if ( level == Z_DEFAULT_COMPRESSION)
+        snprintf( fmode, sizeof(fmode), "%cb", (mode & std::ios::app) ? 'a' : 'w');
+    else
+        snprintf( fmode, sizeof(fmode), "%cb%d", (mode & std::ios::app) ? 'a' : 'w', level);
+    if ( offset > 0) {
+        int fd = ::open( name, O_RDONLY | O_BINARY);
+        if ( fd < 0)
+            return (gzstreambuf*)0;
+        if ( lseek( fd, offset, SEEK_SET) != offset || (file = gzdopen( fd, fmode)) == 0) {
+            ::close( fd);
+            return (gzstreambuf*)0;
+        }
+    } else
+        file = gzopen( name, fmode);
     if (file == 0)
         return (gzstreambuf*)0;
+    gzbuffer( file, 2 * bufferSize);
     opened = 1;
     return this;
 }
@@ -137,17 +153,17 @@ int gzstreambuf::sync() {
 // class gzstreambase:
 // --------------------------------------
 
-gzstreambase::gzstreambase( const char* name, int mode) {
+gzstreambase::gzstreambase( const char* name, int mode, long offset, int level) {
     init( &buf);
-    open( name, mode);
+    open( name, mode, offset, level);
 }
 
 gzstreambase::~gzstreambase() {
     buf.close();
 }
 
-void gzstreambase::open( const char* name, int open_mode) {
-    if ( ! buf.open( name, open_mode))
+void gzstreambase::open( const char* name, int open_mode, long offset, int level) {
+    if ( ! buf.open( name, open_mode, offset, level))
         clear( rdstate() | std::ios::badbit);
 }
 
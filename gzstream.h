@@ -44,8 +44,7 @@ namespace GZSTREAM_NAMESPACE {
 
 class gzstreambuf : public std::streambuf {
 private:
-    static const int bufferSize = 47+256;    // size of data buff
-    // totals 512 bytes under g++ for igzstream at the end.
+    static const int bufferSize = 1 << 16;   // size of data buff
 
     gzFile           file;               // file handle for compressed file
     char             buffer[bufferSize]; // data buffer
@@ -62,7 +61,10 @@ public:
         // ASSERT: both input & output capabilities will not be used together
     }
     int is_open() { return opened; }
-    gzstreambuf* open( const char* name, int open_mode);
+    // offset: number of uncompressed bytes at the start of the file to skip when reading.
+    // level: zlib compression level used when writing.
+    gzstreambuf* open( const char* name, int open_mode, long offset = 0,
+        int level = Z_DEFAULT_COMPRESSION);
     gzstreambuf* close();
     ~gzstreambuf() { close(); }
     
@@ -76,9 +78,11 @@ protected:
     gzstreambuf buf;
 public:
     gzstreambase() { init(&buf); }
-    gzstreambase( const char* name, int open_mode);
+    gzstreambase( const char* name, int open_mode, long offset = 0,
+        int level = Z_DEFAULT_COMPRESSION);
     ~gzstreambase();
-    void open( const char* name, int open_mode);
+    void open( const char* name, int open_mode, long offset = 0,
+        int level = Z_DEFAULT_COMPRESSION);
     void close();
     gzstreambuf* rdbuf() { return &buf; }
 };
@@ -92,22 +96,22 @@ public:
 class igzstream : public gzstreambase, public std::istream {
 public:
     igzstream() : std::istream( &buf) {} 
-    igzstream( const char* name, int open_mode = std::ios::in)
-        : gzstreambase( name, open_mode), std::istream( &buf) {}  
+    igzstream( const char* name, int open_mode = std::ios::in, long offset = 0)
+        : gzstreambase( name, open_mode, offset), std::istream( &buf) {}  
     gzstreambuf* rdbuf() { return gzstreambase::rdbuf(); }
-    void open( const char* name, int open_mode = std::ios::in) {
-        gzstreambase::open( name, open_mode);
+    void open( const char* name, int open_mode = std::ios::in, long offset = 0) {
+        gzstreambase::open( name, open_mode, offset);
     }
 };
 
 class ogzstream : public gzstreambase, public std::ostream {
 public:
     ogzstream() : std::ostream( &buf) {}
-    ogzstream( const char* name, int mode = std::ios::out)
-        : gzstreambase( name, mode), std::ostream( &buf) {}  
+    ogzstream( const char* name, int mode = std::ios::out, int level = Z_DEFAULT_COMPRESSION)
+        : gzstreambase( name, mode, 0, level), std::ostream( &buf) {}  
     gzstreambuf* rdbuf() { return gzstreambase::rdbuf(); }
-    void open( const char* name, int open_mode = std::ios::out) {
-        gzstreambase::open( name, open_mode);
+    void open( const char* name, int open_mode = std::ios::out, int level = Z_DEFAULT_COMPRESSION) {
+        gzstreambase::open( name, open_mode, 0, level);
     }
 };
 
@@ -12,6 +12,7 @@ void Inventory::serialize(Archive& ar, const unsigned int version) {
 SERIALIZABLE(Inventory);
 
 void Inventory::addItem(PItem item) {
+  ++version;
   itemsCache.push_back(item.get());
   items.push_back(move(item));
 }
@@ -29,6 +30,7 @@ PItem Inventory::removeItem(Item* itemRef) {
       break;
     }
   CHECK(ind > -1) << "Tried to remove unknown item.";
+  ++version;
   PItem item = std::move(items[ind]);
   items.erase(items.begin() + ind);
   removeElement(itemsCache, itemRef);
@@ -43,6 +45,7 @@ vector<PItem> Inventory::removeItems(vector<Item*> items) {
 }
 
 vector<PItem> Inventory::removeAllItems() {
+  ++version;
   itemsCache.clear();
   return move(items);
 }
@@ -74,3 +77,7 @@ bool Inventory::isEmpty() const {
   return items.empty();
 }
 
+int Inventory::getVersion() const {
+  return version;
+}
+
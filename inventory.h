@@ -22,8 +22,14 @@ class Inventory {
 
   bool isEmpty() const;
 
+  /** Returns a number that changes whenever the contents change.*/
+  int getVersion() const;
+
   SERIALIZATION_DECL(Inventory);
 
+  protected:
+  int version = 0;
+
   private:
   vector<PItem> SERIAL(items);
   vector<Item*> SERIAL(itemsCache);
@@ -378,7 +378,14 @@ int Item::getAccuracy() const {
   return rangedWeaponAccuracy;
 }
 
+static int modifierVersion = 0;
+
+int Item::getModifierVersion() {
+  return modifierVersion;
+}
+
 void Item::addModifier(AttrType attributeType, int value) {
+  ++modifierVersion;
   switch (attributeType) {
     case AttrType::TO_HIT: toHit += value; break;
     case AttrType::THROWN_TO_HIT: thrownToHit += value; break;
@@ -50,6 +50,9 @@ class Item : private ItemAttributes, public UniqueEntity {
   void addModifier(AttrType attributeType, int value);
   int getModifier(AttrType attributeType) const;
 
+  /** Returns a number that changes whenever the modifiers of any item change.*/
+  static int getModifierVersion();
+
   void tick(double time, Level*, Vec2 position);
   
   string getApplyMsgThirdPerson() const;
@@ -225,7 +225,7 @@ class Corpse : public Item {
       viewObject = object2;
       corpseInfo.isSkeleton = true;
     } else if (getWeight() > 10 && !corpseInfo.isSkeleton && 
-        !level->getSquare(position)->isCovered() && Random.roll(35)) {
+        !level->isCovered(position) && Random.roll(35)) {
       for (Vec2 v : position.neighbors8(true))
         if (level->inBounds(v)) {
           PCreature vulture = CreatureFactory::fromId(
@@ -0,0 +1,139 @@
+#include "stdafx.h"
+
+#include <chrono>
+#ifndef WINDOWS
+#include <sys/resource.h>
+#endif
+
+#include "debug.h"
+#include "util.h"
+#include "model.h"
+#include "level.h"
+#include "null_view.h"
+#include "quest.h"
+#include "tribe.h"
+#include "message_buffer.h"
+#include "statistics.h"
+#include "options.h"
+#include "technology.h"
+#include "profiler.h"
+#include "save_file.h"
+#include "auto_save.h"
+
+// Runs the game without a window and measures how fast the simulation goes.
+// Usage: keeper-bench [keeper|adventurer] [turns] [seed] [check]
+// With "check", the cached square attributes of all levels and the territory of the keeper are verified every
+// turn, and cached creature attributes and sight every time they are used.
+// The time of each phase of a turn comes from the profiler, so it's not reported in RELEASE builds.
+// At the end the game is autosaved, and then saved to keeper-bench.sav and loaded back. The files are removed.
+// Needs the data files in the working directory.
+
+static double getMillis() {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Returns the peak resident set size of the process in kilobytes, or -1 if it's not known.
+static long getPeakMemory() {
+#ifndef WINDOWS
+  rusage usage;
+  if (!getrusage(RUSAGE_SELF, &usage))
+    return usage.ru_maxrss;
+#endif
+  return -1;
+}
+
+// Same initialization as in main.cpp.
+static void initGame(int seed, View* view) {
+  Random.init(seed);
+  Item::identifyEverything();
+  Quests::clearAll();
+  Creature::initialize();
+  Tribes::clearAll();
+  Technology::clearAll();
+  EventListener::initialize();
+  Tribe::init();
+  Technology::init();
+  Statistics::init();
+  Options::init("options.txt");
+  NameGenerator::init("first_names.txt", "aztec_names.txt", "creatures.txt",
+      "artifacts.txt", "world.txt", "town_names.txt", "dwarfs.txt", "gods.txt", "demons.txt", "dogs.txt",
+      "insults.txt");
+  ItemFactory::init();
+  messageBuffer.initialize(view);
+}
+
+int main(int argc, char* argv[]) {
+  Debug::init();
+  bool adventurer = argc > 1 && argv[1][0] == 'a';
+  int numTurns = argc > 2 ? convertFromString<int>(argv[2]) : 1000;
+  int seed = argc > 3 ? convertFromString<int>(argv[3]) : 1234;
+  bool check = argc > 4 && string(argv[4]) == "check";
+  NullView view;
+  view.initialize();
+  initGame(seed, &view);
+  double time1 = getMillis();
+  unique_ptr<Model> model(adventurer ? Model::heroModel(&view) : Model::collectiveModel(&view));
+  model->setView(&view);
+  model->setConsistencyChecks(check);
+  double generation = getMillis() - time1;
+  int turn = 0;
+  time1 = getMillis();
+  try {
+    while (turn < numTurns)
+      model->update(++turn);
+  } catch (GameOverException ex) {
+    std::cout << "Game over in turn " << turn << std::endl;
+  }
+  double total = getMillis() - time1;
+  std::cout << (adventurer ? "adventurer" : "keeper") << " game, seed " << seed << std::endl;
+  std::cout << "world generation: " << generation << " ms" << std::endl;
+  std::cout << turn << " turns: " << total << " ms, " << 1000 * turn / total << " turns/sec" << std::endl;
+#ifndef RELEASE
+  // The phases of Model::update are the zones directly inside it.
+  for (const Profiler::ZoneStats& zone : Profiler::getStats())
+    if (zone.depth == 1 && zone.path.compare(0, 7, "update/") == 0)
+      std::cout << "  " << zone.name << ": " << zone.total << " ms (" << int(100 * zone.total / total) << "%)"
+          << std::endl;
+#endif
+  long numTiles = 0;
+  for (const Level* level : model->getLevels())
+    numTiles += level->getWidth() * level->getHeight();
+  long memory = getPeakMemory();
+  std::cout << "peak memory: " << memory << " kB, " << numTiles << " tiles, "
+      << (memory > 0 ? 1024 * memory / numTiles : -1) << " bytes per tile" << std::endl;
+  AutoSave autosave("keeper-bench-autosave", ".sav", 1);
+  autosave.save(model.get());
+  autosave.wait();
+  CHECK(SaveFile::readHeader(autosave.getSlotPath(0))) << "Autosave failed";
+  autosave.removeSlots();
+  std::cout << "autosave: game stopped for " << autosave.getLastStopTime() << " ms, written in "
+      << autosave.getLastWriteTime() << " ms in the background" << std::endl;
+  string savePath = "keeper-bench.sav";
+  time1 = getMillis();
+  SaveFile::save(model.get(), model->getGameType(), savePath);
+  double saveTime = getMillis() - time1;
+  long saveSize = ifstream(savePath, std::ios::binary | std::ios::ate).tellg();
+  time1 = getMillis();
+  Optional<SaveFileHeader> header = SaveFile::readHeader(savePath);
+  CHECK(header && header->turn == model->getTurn());
+  double headerTime = getMillis() - time1;
+  // Loading starts from the same state as in main.cpp.
+  model.reset();
+  initGame(seed, &view);
+  time1 = getMillis();
+  unique_ptr<Model> loaded = SaveFile::load(savePath);
+  CHECK(loaded->getTurn() == header->turn);
+  double loadTime = getMillis() - time1;
+  remove(savePath.c_str());
+  std::cout << "save: " << saveTime << " ms, " << saveSize / 1024 << " kB, " << header->numSections
+      << " sections" << std::endl;
+  std::cout << "load: " << loadTime << " ms, header only: " << headerTime << " ms" << std::endl;
+#ifndef RELEASE
+  Profiler::dumpText(std::cout);
+#endif
+  // The loaded default creature has to go before its tribe, which a static destructor may delete first.
+  loaded.reset();
+  Creature::initialize();
+  return 0;
+}
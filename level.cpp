@@ -3,6 +3,7 @@
 #include "level.h"
 #include "location.h"
 #include "model.h"
+#include "profiler.h"
 
 template <class Archive> 
 void Level::serialize(Archive& ar, const unsigned int version) { 
@@ -12,28 +13,37 @@ void Level::serialize(Archive& ar, const unsigned int version) {
     & SVAR(tickingSquares)
     & SVAR(creatures)
     & SVAR(model)
+    & SVAR(opacity)
     & SVAR(fieldOfView)
     & SVAR(entryMessage)
     & SVAR(name)
     & SVAR(player)
     & SVAR(backgroundLevel)
-    & SVAR(backgroundOffset); 
+    & SVAR(backgroundOffset)
+    & SVAR(covered)
+    & SVAR(fog)
+    & SVAR(fields);
   CHECK_SERIAL;
+  if (Archive::is_loading::value)
+    initTileFlags();
 }  
 
 SERIALIZABLE(Level);
 
 Level::Level(Table<PSquare> s, Model* m, vector<Location*> l, const string& message, const string& n) 
-    : squares(std::move(s)), locations(l), model(m), fieldOfView(squares), entryMessage(message), 
-    name(n) {
+    : squares(std::move(s)), locations(l), model(m), opacity(squares.getWidth(), squares.getHeight()),
+    fieldOfView(opacity), entryMessage(message), name(n), covered(squares.getBounds(), false),
+    fields(squares.getBounds(), Random.getRandom(1000000000)), tileFlags(squares.getBounds(), 0) {
   for (Vec2 pos : squares.getBounds()) {
     squares[pos]->setLevel(this);
+    opacity.setOpaque(pos, !squares[pos]->canSeeThru());
     Optional<pair<StairDirection, StairKey>> link = squares[pos]->getLandingLink();
     if (link)
       landingSquares[*link].push_back(pos);
   }
   for (Location *l : locations)
     l->setLevel(this);
+  initTileFlags();
 }
 
 void Level::addCreature(Vec2 position, PCreature c) {
@@ -47,6 +57,7 @@ void Level::putCreature(Vec2 position, Creature* c) {
   CHECK(getSquare(position)->getCreature() == nullptr);
   c->setLevel(this);
   c->setPosition(position);
+  addToChunk(c, position);
   //getSquare(position)->putCreatureSilently(c);
   getSquare(position)->putCreature(c);
   notifyLocations(c);
@@ -59,13 +70,15 @@ void Level::notifyLocations(Creature* c) {
 }
 
 void Level::replaceSquare(Vec2 pos, PSquare square) {
-  if (contains(tickingSquares, getSquare(pos)))
+  if (tileFlags[pos] & TICKING) {
     removeElement(tickingSquares, getSquare(pos));
+    tileFlags[pos] &= ~TICKING;
+  }
+  fields.clear(pos);
   Creature* c = squares[pos]->getCreature();
   for (Item* it : squares[pos]->getItems())
     square->dropItem(squares[pos]->removeItem(it));
   squares[pos]->onConstructNewSquare(square.get());
-  square->setCovered(squares[pos]->isCovered());
   square->setBackground(squares[pos].get());
   squares[pos] = std::move(square);
   squares[pos]->setPosition(pos);
@@ -73,13 +86,23 @@ void Level::replaceSquare(Vec2 pos, PSquare square) {
   if (c) {
     squares[pos]->putCreatureSilently(c);
   }
-  updateVisibility(pos);
+  updateSquare(pos);
+  updateSquareFlags(pos);
 }
 
 const Creature* Level::getPlayer() const {
   return player;
 }
 
+bool Level::isCovered(Vec2 pos) const {
+  return covered[pos];
+}
+
+double Level::getFog(Vec2 pos) const {
+  auto it = fog.find(pos);
+  return it == fog.end() ? 0 : it->second;
+}
+
 const Location* Level::getLocation(Vec2 pos) const {
   for (Location* l : locations)
     if (pos.inRectangle(l->getBounds()))
@@ -121,18 +144,19 @@ Vec2 Level::landCreature(vector<Vec2> landing, Creature* creature) {
     creature->privateMessage(entryMessage);
     entryMessage = "";
   }
+  Passability movement = getPassability(creature);
   queue<pair<Vec2, Vec2>> q;
   for (Vec2 pos : randomPermutation(landing))
     q.push(make_pair(pos, pos));
   while (!q.empty()) {
     pair<Vec2, Vec2> v = q.front();
     q.pop();
-    if (squares[v.first]->canEnter(creature)) {
+    if (movement.canEnter(v.first)) {
       putCreature(v.first, creature);
       return v.second;
     } else
       for (Vec2 next : v.first.neighbors8(true))
-        if (next.inRectangle(squares.getBounds()) && squares[next]->canEnterEmpty(creature))
+        if (next.inRectangle(squares.getBounds()) && movement.canEnterEmpty(next))
           q.push(make_pair(next, v.second));
   }
   FAIL << "Failed to find any square to put creature";
@@ -169,14 +193,168 @@ void Level::throwItem(vector<PItem> item, const Attack& attack, int maxDist, Vec
 
 void Level::killCreature(Creature* creature) {
   removeElement(creatures, creature);
+  removeFromChunk(creature, creature->getPosition());
   getSquare(creature->getPosition())->removeCreature();
   model->removeCreature(creature);
   if (creature->isPlayer())
     setPlayer(nullptr);
 }
 
-void Level::updateVisibility(Vec2 changedSquare) {
-  fieldOfView.squareChanged(changedSquare);
+void Level::updateSquare(Vec2 pos) {
+  bool opaque = !squares[pos]->canSeeThru();
+  if (opaque != opacity.isOpaque(pos)) {
+    opacity.setOpaque(pos, opaque);
+    fieldOfView.squareChanged(pos);
+    addSightChange(pos);
+  }
+  for (auto& elem : passability)
+    (*elem.second)[pos] = 0;
+  if (squareChanges.size() >= maxSquareChanges) {
+    numOldSquareChanges += squareChanges.size();
+    squareChanges.clear();
+  }
+  squareChanges.push_back(pos);
+  addViewChange(pos);
+  if (clusterGraph)
+    clusterGraph->squareChanged(pos);
+  for (int i = flowFields.size() - 1; i >= 0; --i)
+    if (flowFields[i].field->isAffected(pos))
+      flowFields.erase(flowFields.begin() + i);
+}
+
+void Level::updateSquareFlags(Vec2 pos) {
+  const Square* square = squares[pos].get();
+  tileFlags[pos] = (tileFlags[pos] & TICKING)
+      | (square->getCreature() ? OCCUPIED : 0)
+      | (square->getFlamability() > 0 ? FLAMMABLE : 0)
+      | (square->hasItems() ? ITEMS : 0);
+  addViewChange(pos);
+}
+
+void Level::initTileFlags() {
+  tileFlags = Table<unsigned char>(squares.getBounds(), 0);
+  viewChanges = Table<int>(squares.getBounds(), 0);
+  sightChanges = Table<int>((getWidth() + chunkSize - 1) / chunkSize, (getHeight() + chunkSize - 1) / chunkSize, 0);
+  for (Vec2 pos : squares.getBounds())
+    updateSquareFlags(pos);
+  for (Square* square : tickingSquares)
+    tileFlags[square->getPosition()] |= TICKING;
+}
+
+bool Level::isOccupied(Vec2 pos) const {
+  return tileFlags[pos] & OCCUPIED;
+}
+
+bool Level::isBurning(Vec2 pos) const {
+  return fields.getFire(pos) > 0;
+}
+
+bool Level::hasPoisonGas(Vec2 pos) const {
+  return fields.getGas(pos) > 0;
+}
+
+bool Level::canSeeThru(Vec2 pos) const {
+  return !opacity.isOpaque(pos);
+}
+
+bool Level::isFlammable(Vec2 pos) const {
+  return tileFlags[pos] & FLAMMABLE;
+}
+
+bool Level::hasItems(Vec2 pos) const {
+  return tileFlags[pos] & ITEMS;
+}
+
+FieldSimulation& Level::getFields() {
+  return fields;
+}
+
+const FieldSimulation& Level::getFields() const {
+  return fields;
+}
+
+void Level::tick(double time) {
+  {
+    PROFILE_ZONE("fire and gas");
+    fields.tick(this, time);
+  }
+  // A square's tick can add ticking squares or replace squares, so iterate over the positions
+  // from before the loop and skip squares that stopped ticking.
+  vector<Vec2> positions;
+  for (Square* square : tickingSquares)
+    positions.push_back(square->getPosition());
+  for (Vec2 pos : positions)
+    if (tileFlags[pos] & TICKING)
+      squares[pos]->tick(time);
+}
+
+Level::Passability::Passability(const Level* l, const Creature* c, Table<unsigned char>& t)
+    : level(l), creature(c), table(t) {
+}
+
+unsigned char Level::Passability::get(Vec2 pos) const {
+  unsigned char& entry = table[pos];
+  if (!entry) {
+    const Square* square = level->getSquare(pos);
+    unsigned char value = KNOWN | (square->canEnterEmpty(creature) ? CAN_ENTER : 0)
+        | (square->canDestroy(creature) ? CAN_DESTROY : 0);
+    if (!square->isEntryCacheable())
+      return value;
+    entry = value;
+  }
+  return entry;
+}
+
+bool Level::Passability::canEnter(Vec2 pos) const {
+  return !level->isOccupied(pos) && (get(pos) & CAN_ENTER);
+}
+
+bool Level::Passability::canEnterEmpty(Vec2 pos) const {
+  return get(pos) & CAN_ENTER;
+}
+
+bool Level::Passability::canDestroy(Vec2 pos) const {
+  return get(pos) & CAN_DESTROY;
+}
+
+Level::Passability Level::getPassability(const Creature* c) const {
+  FlowField::MovementClass movement = FlowField::getMovementClass(c);
+  for (auto& elem : passability)
+    if (elem.first == movement)
+      return Passability(this, c, *elem.second);
+  passability.emplace_back(movement, unique_ptr<Table<unsigned char>>(
+        new Table<unsigned char>(getBounds(), 0)));
+  return Passability(this, c, *passability.back().second);
+}
+
+void Level::checkConsistency() const {
+#ifndef RELEASE
+  for (Vec2 pos : getBounds()) {
+    const Square* square = squares[pos].get();
+    CHECK(opacity.isOpaque(pos) == !square->canSeeThru()) << "Opacity out of sync at " << pos;
+    CHECK(isOccupied(pos) == (square->getCreature() != nullptr)) << "Occupancy out of sync at " << pos;
+    CHECK(isFlammable(pos) == (square->getFlamability() > 0)) << "Flammability out of sync at " << pos;
+    CHECK(hasItems(pos) == square->hasItems()) << "Items out of sync at " << pos;
+    CHECK(bool(tileFlags[pos] & TICKING) == contains(tickingSquares, square))
+        << "Ticking squares out of sync at " << pos;
+  }
+  // Passability can only be checked against a creature of the same movement class.
+  vector<bool> checked(passability.size(), false);
+  for (const Creature* c : creatures) {
+    FlowField::MovementClass movement = FlowField::getMovementClass(c);
+    for (int i : All(passability))
+      if (!checked[i] && passability[i].first == movement) {
+        checked[i] = true;
+        for (Vec2 pos : getBounds())
+          if (unsigned char entry = (*passability[i].second)[pos]) {
+            CHECK(bool(entry & CAN_ENTER) == squares[pos]->canEnterEmpty(c))
+                << "Passability out of sync at " << pos << " for " << c->getName();
+            CHECK(bool(entry & CAN_DESTROY) == squares[pos]->canDestroy(c))
+                << "Destructibility out of sync at " << pos << " for " << c->getName();
+          }
+      }
+  }
+#endif
 }
 
 void Level::globalMessage(Vec2 position, const string& ifPlayerCanSee, const string& cannot) const {
@@ -191,6 +369,7 @@ void Level::globalMessage(Vec2 position, const string& ifPlayerCanSee, const str
 void Level::changeLevel(StairDirection dir, StairKey key, Creature* c) {
   Vec2 fromPosition = c->getPosition();
   removeElement(creatures, c);
+  removeFromChunk(c, c->getPosition());
   getSquare(c->getPosition())->removeCreature();
   Vec2 toPosition = model->changeLevel(dir, key, c);
   EventListener::addChangeLevelEvent(c, this, fromPosition, c->getLevel(), toPosition);
@@ -199,6 +378,7 @@ void Level::changeLevel(StairDirection dir, StairKey key, Creature* c) {
 void Level::changeLevel(Level* destination, Vec2 landing, Creature* c) {
   Vec2 fromPosition = c->getPosition();
   removeElement(creatures, c);
+  removeFromChunk(c, c->getPosition());
   getSquare(c->getPosition())->removeCreature();
   model->changeLevel(destination, landing, c);
   EventListener::addChangeLevelEvent(c, this, fromPosition, destination, landing);
@@ -216,6 +396,104 @@ vector<Creature*>& Level::getAllCreatures() {
   return creatures;
 }
 
+Table<vector<Creature*>>& Level::getCreatureChunks() const {
+  if (!creatureChunks) {
+    creatureChunks.reset(new Table<vector<Creature*>>((getWidth() + chunkSize - 1) / chunkSize,
+        (getHeight() + chunkSize - 1) / chunkSize));
+    for (Creature* c : creatures)
+      (*creatureChunks)[c->getPosition() / chunkSize].push_back(c);
+  }
+  return *creatureChunks;
+}
+
+void Level::addToChunk(Creature* c, Vec2 pos) {
+  addSightChange(pos);
+  if (creatureChunks)
+    (*creatureChunks)[pos / chunkSize].push_back(c);
+}
+
+void Level::removeFromChunk(Creature* c, Vec2 pos) {
+  addSightChange(pos);
+  if (creatureChunks)
+    removeElement((*creatureChunks)[pos / chunkSize], c);
+}
+
+Rectangle Level::getChunkArea(Vec2 pos, int radius) const {
+  return Rectangle((pos - Vec2(radius, radius)) / chunkSize, (pos + Vec2(radius, radius)) / chunkSize + Vec2(1, 1))
+      .intersection(Rectangle((getWidth() + chunkSize - 1) / chunkSize, (getHeight() + chunkSize - 1) / chunkSize));
+}
+
+vector<Creature*> Level::getCreaturesInRadius(Vec2 pos, int radius) const {
+  Table<vector<Creature*>>& chunks = getCreatureChunks();
+  vector<Creature*> ret;
+  for (Vec2 v : getChunkArea(pos, radius))
+    for (Creature* c : chunks[v])
+      if (c->getPosition().dist8(pos) <= radius)
+        ret.push_back(c);
+  return ret;
+}
+
+vector<Creature*> Level::getVisibleCreatures(Vec2 pos) const {
+  vector<Creature*> ret;
+  for (Creature* c : getCreaturesInRadius(pos, FieldOfView::sightRange))
+    if (fieldOfView.canSee(pos, c->getPosition()))
+      ret.push_back(c);
+  return ret;
+}
+
+void Level::precomputeSight(const vector<Vec2>& positions) const {
+  getCreatureChunks();
+  fieldOfView.precompute(positions);
+}
+
+vector<Creature*> Level::getVisibleCreaturesReadOnly(Vec2 pos) const {
+  vector<Creature*> ret;
+  for (Creature* c : getCreaturesInRadius(pos, FieldOfView::sightRange))
+    if (fieldOfView.canSeeReadOnly(pos, c->getPosition()))
+      ret.push_back(c);
+  return ret;
+}
+
+void Level::addSightChange(Vec2 pos) {
+  ++numSightChanges;
+  Vec2 chunk = pos / chunkSize;
+  Vec2 radius(sightChunkRadius, sightChunkRadius);
+  for (Vec2 v : Rectangle(chunk - radius, chunk + radius + Vec2(1, 1)).intersection(sightChanges.getBounds()))
+    sightChanges[v] = numSightChanges;
+}
+
+int Level::getNumSightChanges() const {
+  return numSightChanges;
+}
+
+bool Level::sightChangedSince(Vec2 pos, int since) const {
+  // The creatures are found by chunks, and their order within a chunk changes too, so any change in the
+  // chunks that are searched counts. Those also cover all squares that can block the view.
+  return sightChanges[pos / chunkSize] > since;
+}
+
+int Level::getNumSquareChanges() const {
+  return numOldSquareChanges + squareChanges.size();
+}
+
+Optional<vector<Vec2>> Level::getSquareChangesSince(int since) const {
+  if (since < numOldSquareChanges)
+    return Nothing();
+  return vector<Vec2>(squareChanges.begin() + since - numOldSquareChanges, squareChanges.end());
+}
+
+void Level::addViewChange(Vec2 pos) {
+  viewChanges[pos] = ++numViewChanges;
+}
+
+int Level::getNumViewChanges() const {
+  return numViewChanges;
+}
+
+bool Level::viewChangedSince(Vec2 pos, int since) const {
+  return viewChanges[pos] > since;
+}
+
 bool Level::canSee(Vec2 from, Vec2 to) const {
   return fieldOfView.canSee(from, to);
 }
@@ -233,7 +511,7 @@ bool Level::canMoveCreature(const Creature* creature, Vec2 direction) const {
   Vec2 destination = position + direction;
   if (!inBounds(destination))
     return false;
-  return getSquare(destination)->canEnter(creature);
+  return !isOccupied(destination) && getSquare(destination)->canEnterEmpty(creature);
 }
 
 void Level::moveCreature(Creature* creature, Vec2 direction) {
@@ -242,7 +520,9 @@ void Level::moveCreature(Creature* creature, Vec2 direction) {
   Square* nextSquare = getSquare(position + direction);
   Square* thisSquare = getSquare(position);
   thisSquare->removeCreature();
+  removeFromChunk(creature, position);
   creature->setPosition(position + direction);
+  addToChunk(creature, position + direction);
   nextSquare->putCreature(creature);
   notifyLocations(creature);
 }
@@ -254,8 +534,12 @@ void Level::swapCreatures(Creature* c1, Creature* c2) {
   Square* square2 = getSquare(position2);
   square1->removeCreature();
   square2->removeCreature();
+  removeFromChunk(c1, position1);
+  removeFromChunk(c2, position2);
   c1->setPosition(position2);
   c2->setPosition(position1);
+  addToChunk(c1, position2);
+  addToChunk(c2, position1);
   square1->putCreature(c2);
   square2->putCreature(c1);
   notifyLocations(c1);
@@ -292,9 +576,10 @@ Square* Level::getSquare(Vec2 pos) {
 }
 
 void Level::addTickingSquare(Vec2 pos) {
-  Square* s = squares[pos].get();
-  if (!contains(tickingSquares, s))
-    tickingSquares.push_back(s);
+  if (!(tileFlags[pos] & TICKING)) {
+    tickingSquares.push_back(squares[pos].get());
+    tileFlags[pos] |= TICKING;
+  }
 }
   
 vector<Square*> Level::getTickingSquares() const {
@@ -395,15 +680,15 @@ void Level::Builder::setMessage(const string& message) {
 PLevel Level::Builder::build(Model* m, LevelMaker* maker, bool surface) {
   CHECK(mapStack.empty());
   maker->make(this, squares.getBounds());
-  for (Vec2 v : heightMap.getBounds()) {
+  for (Vec2 v : heightMap.getBounds())
     squares[v]->setHeight(heightMap[v]);
+  PLevel l(new Level(std::move(squares), m, locations, entryMessage, name));
+  for (Vec2 v : heightMap.getBounds())
     if (covered.count(v) || !surface) {
       Debug() << "Covered " << v;
-      squares[v]->setCovered(true);
-    } else
-      squares[v]->setFog(fog[v]);
-  }
-  PLevel l(new Level(std::move(squares), m, locations, entryMessage, name));
+      l->covered[v] = true;
+    } else if (fog[v] > 0)
+      l->fog[v] = fog[v];
   for (PCreature& c : creatures) {
     Vec2 pos = c->getPosition();
     l->addCreature(pos, std::move(c));
@@ -459,6 +744,37 @@ bool Level::inBounds(Vec2 pos) const {
   return pos.inRectangle(getBounds());
 }
 
+Optional<Vec2> Level::getWaypoint(Vec2 from, Vec2 to) const {
+  if (!clusterGraph)
+    clusterGraph.reset(new ClusterGraph(this, Creature::getDefault()));
+  return clusterGraph->getWaypoint(from, to);
+}
+
+FlowField& Level::getFlowField(const vector<Vec2>& targets, const Creature* c) const {
+  FlowField::MovementClass movement = FlowField::getMovementClass(c);
+  for (int i : All(flowFields))
+    if (flowFields[i].movement == movement && flowFields[i].targets == targets) {
+      std::rotate(flowFields.begin() + i, flowFields.begin() + i + 1, flowFields.end());
+      return *flowFields.back().field;
+    }
+  if (flowFields.size() >= maxFlowFields)
+    flowFields.erase(flowFields.begin());
+  flowFields.push_back({targets, movement, unique_ptr<FlowField>(new FlowField(this, targets))});
+  return *flowFields.back().field;
+}
+
+FlowField& Level::getClusterFlowField(Vec2 target, const Creature* c) const {
+  const int size = ClusterGraph::clusterSize;
+  Vec2 corner(target.x - target.x % size, target.y - target.y % size);
+  Rectangle cluster = Rectangle(corner, corner + Vec2(size, size)).intersection(getBounds());
+  Passability passability = getPassability(c);
+  vector<Vec2> targets;
+  for (Vec2 v : cluster)
+    if (passability.canEnterEmpty(v) || v == target)
+      targets.push_back(v);
+  return getFlowField(targets, c);
+}
+
 Rectangle Level::getBounds() const {
   return Rectangle(0, 0, getWidth(), getHeight());
 }
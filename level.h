@@ -6,6 +6,9 @@
 #include "debug.h"
 #include "view.h"
 #include "field_of_view.h"
+#include "cluster_graph.h"
+#include "flow_field.h"
+#include "field_simulation.h"
 #include "square_factory.h"
 
 class Model;
@@ -52,9 +55,64 @@ class Level {
   /** Removes the creature from \paramname{position} from the level and model. The creature object is retained.*/
   void killCreature(Creature*);
 
-  /** Recalculates visibility data assuming that \paramname{changedSquare} has changed
-      its obstructing/non-obstructing attribute. */
-  void updateVisibility(Vec2 changedSquare);
+  /** Recalculates the cached attributes of the square at \paramname{pos}. Must be called whenever its
+    * transparency, or which creatures can enter or destroy it, changes.*/
+  void updateSquare(Vec2 pos);
+
+  /** Updates the occupancy, flammability and item flags of the square at \paramname{pos}. The square calls it
+    * whenever one of them might have changed.*/
+  void updateSquareFlags(Vec2 pos);
+
+  /** Answers Square::canEnter, Square::canEnterEmpty and Square::canDestroy for one creature. The answers
+    * are kept in per-tile tables shared by all creatures that move the same way, and are only valid
+    * as long as the creature's attributes don't change.*/
+  class Passability {
+    public:
+    bool canEnter(Vec2 pos) const;
+    bool canEnterEmpty(Vec2 pos) const;
+    bool canDestroy(Vec2 pos) const;
+
+    private:
+    friend class Level;
+    Passability(const Level*, const Creature*, Table<unsigned char>&);
+    unsigned char get(Vec2 pos) const;
+
+    const Level* level;
+    const Creature* creature;
+    Table<unsigned char>& table;
+  };
+
+  /** Returns the passability of the level for \paramname{c}.*/
+  Passability getPassability(const Creature* c) const;
+
+  /** Checks if there is a creature on the square.*/
+  bool isOccupied(Vec2 pos) const;
+
+  /** Checks if the square is on fire.*/
+  bool isBurning(Vec2 pos) const;
+
+  /** Checks if there is any poison gas on the square.*/
+  bool hasPoisonGas(Vec2 pos) const;
+
+  /** Checks if the square doesn't obstruct view.*/
+  bool canSeeThru(Vec2 pos) const;
+
+  /** Checks if the square itself can catch fire.*/
+  bool isFlammable(Vec2 pos) const;
+
+  /** Checks if there are any items on the square.*/
+  bool hasItems(Vec2 pos) const;
+
+  /** Returns the fire and poison gas on the level.*/
+  FieldSimulation& getFields();
+  const FieldSimulation& getFields() const;
+
+  /** Advances the fire and gas, and ticks the squares that were added with addTickingSquare().*/
+  void tick(double time);
+
+  /** Checks that the cached attributes of all squares agree with the squares. Fails if they don't.
+    * Does nothing in RELEASE builds.*/
+  void checkConsistency() const;
 
   /** Returns width of the level.*/
   int getWidth() const;
@@ -68,6 +126,17 @@ class Level {
   /** Returns the level's boundaries.*/
   Rectangle getBounds() const;
 
+  /** Returns an intermediate target for long distance paths. See ClusterGraph::getWaypoint().*/
+  Optional<Vec2> getWaypoint(Vec2 from, Vec2 to) const;
+
+  /** Returns a flow field towards the closest of \paramname{targets} for creatures that move like \paramname{c}.
+    * A few recently used fields are kept until a square they depend on is replaced.*/
+  FlowField& getFlowField(const vector<Vec2>& targets, const Creature* c) const;
+
+  /** Returns a flow field towards the ClusterGraph cluster that contains \paramname{target}. Use for targets
+    * that move often, the field stays the same until the target leaves its cluster.*/
+  FlowField& getClusterFlowField(Vec2 target, const Creature* c) const;
+
   /** Returns the name of the level. */
   const string& getName() const;
 
@@ -107,6 +176,47 @@ class Level {
   vector<Creature*>& getAllCreatures();
   //@}
 
+  /** Returns the creatures within \paramname{radius} of \paramname{pos}, measured with Vec2::dist8.*/
+  vector<Creature*> getCreaturesInRadius(Vec2 pos, int radius) const;
+
+  /** Returns the creatures standing on squares that are visible from \paramname{pos}.*/
+  vector<Creature*> getVisibleCreatures(Vec2 pos) const;
+
+  /** Calculates the visibility from the given squares in parallel, and prepares the caches for
+    * getVisibleCreaturesReadOnly.*/
+  void precomputeSight(const vector<Vec2>& positions) const;
+
+  /** Same as getVisibleCreatures, but doesn't change any caches, so it can be called from many threads at
+    * a time. Only valid right after precomputeSight, before anything on the level changes.*/
+  vector<Creature*> getVisibleCreaturesReadOnly(Vec2 pos) const;
+
+  /** Returns the number of changes so far that may affect getVisibleCreatures: creatures being added, removed
+    * or moved, and squares changing their opacity.*/
+  int getNumSightChanges() const;
+
+  /** Checks if getVisibleCreatures(\paramname{pos}) may have changed since getNumSightChanges() returned
+    * \paramname{since}.*/
+  bool sightChangedSince(Vec2 pos, int since) const;
+
+  /** Returns the number of square changes so far. A square changes whenever updateSquare is called for it.*/
+  int getNumSquareChanges() const;
+
+  /** Returns the squares that changed since getNumSquareChanges() returned \paramname{since}, or nothing
+    * if there were too many changes to remember.*/
+  Optional<vector<Vec2>> getSquareChangesSince(int since) const;
+
+  /** Records that the square at \paramname{pos} may look different now: creatures or items came or went,
+    * the square was replaced or changed its appearance, or its fire or gas changed.*/
+  void addViewChange(Vec2 pos);
+
+  /** Returns the number of changes so far that may affect the look of the squares.*/
+  int getNumViewChanges() const;
+
+  /** Checks if the square at \paramname{pos} may look different since getNumViewChanges() returned
+    * \paramname{since}. Creatures can change their look without moving, so the squares with creatures
+    * on them must be checked separately.*/
+  bool viewChangedSince(Vec2 pos, int since) const;
+
   /** Checks whether one square is visible from the other. This function is not guaranteed to be simmetrical.*/
   bool canSee(Vec2 from, Vec2 to) const;
 
@@ -125,6 +235,12 @@ class Level {
   /** Returns the player creature.*/
   const Creature* getPlayer() const;
 
+  /** Checks if the square has a roof.*/
+  bool isCovered(Vec2 pos) const;
+
+  /** Returns the amount of fog on the square, between 0 and 1.*/
+  double getFog(Vec2 pos) const;
+
   /** Returns name of the given location. Returns nullptr if none. **/
   const Location* getLocation(Vec2) const;
 
@@ -226,17 +342,63 @@ class Level {
   vector<Square*> SERIAL(tickingSquares);
   vector<Creature*> SERIAL(creatures);
   Model* SERIAL2(model, nullptr);
+  OpacityMap SERIAL(opacity);
   mutable FieldOfView SERIAL(fieldOfView);
   string SERIAL(entryMessage);
   string SERIAL(name);
   Creature* SERIAL2(player, nullptr);
   const Level* SERIAL2(backgroundLevel, nullptr);
   Vec2 SERIAL(backgroundOffset);
+  Table<bool> SERIAL(covered);
+  /** Only squares with some fog are stored.*/
+  unordered_map<Vec2, double> SERIAL(fog);
+  FieldSimulation SERIAL(fields);
+  enum TileFlag { OCCUPIED = 1, FLAMMABLE = 2, ITEMS = 4, TICKING = 8 };
+  /** Combination of TileFlag values for every square. Not saved, rebuilt from the squares instead.*/
+  Table<unsigned char> tileFlags;
+  enum PassabilityFlag { KNOWN = 1, CAN_ENTER = 2, CAN_DESTROY = 4 };
+  /** Combinations of PassabilityFlag values for each movement class seen so far. A square is filled in
+    * when first queried, and reset to 0 when it changes.*/
+  mutable vector<pair<FlowField::MovementClass, unique_ptr<Table<unsigned char>>>> passability;
+  mutable unique_ptr<ClusterGraph> clusterGraph;
+  /** Creatures by the chunk of the level they are standing in. Built when first queried.*/
+  mutable unique_ptr<Table<vector<Creature*>>> creatureChunks;
+  static const int chunkSize = 8;
+  /** getNumSightChanges() right after the last change within sightChunkRadius of every chunk. Not saved.*/
+  Table<int> sightChanges;
+  int numSightChanges = 0;
+  /** Covers the chunks that getVisibleCreatures searches from any square of a chunk.*/
+  static const int sightChunkRadius = (FieldOfView::sightRange + chunkSize - 1) / chunkSize;
+  /** Squares of the recent changes counted by getNumSquareChanges. Not saved.*/
+  vector<Vec2> squareChanges;
+  /** Number of changes dropped from the front of squareChanges.*/
+  int numOldSquareChanges = 0;
+  static const int maxSquareChanges = 1000;
+  /** getNumViewChanges() right after the last change of every square. Not saved.*/
+  Table<int> viewChanges;
+  int numViewChanges = 0;
+  struct FlowFieldInfo {
+    vector<Vec2> targets;
+    FlowField::MovementClass movement;
+    unique_ptr<FlowField> field;
+  };
+  /** Most recently used last.*/
+  mutable vector<FlowFieldInfo> flowFields;
+  static const int maxFlowFields = 8;
   
   Level(Table<PSquare> s, Model*, vector<Location*>, const string& message, const string& name);
 
+  void initTileFlags();
+
   /** Notify relevant locations about creature position. */
   void notifyLocations(Creature*);
+
+  Table<vector<Creature*>>& getCreatureChunks() const;
+  void addToChunk(Creature*, Vec2 pos);
+  void removeFromChunk(Creature*, Vec2 pos);
+  /** Returns the chunks that may contain creatures within \paramname{radius} of \paramname{pos}.*/
+  Rectangle getChunkArea(Vec2 pos, int radius) const;
+  void addSightChange(Vec2 pos);
 };
 
 #endif
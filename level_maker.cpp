@@ -209,7 +209,7 @@ class Connector : public LevelMaker {
         SquareType newType = SquareType(0);
         SquareType oldType = builder->getType(v);
         if (isWall(oldType) && oldType != SquareType::BLACK_WALL)
-          newType = chooseRandom({
+          newType = chooseRandom<SquareType>({
               SquareType::PATH,
               SquareType::DOOR,
               SquareType::SECRET_PASS}, doorProb);
@@ -269,7 +269,7 @@ class Connector : public LevelMaker {
   }
   
   private:
-  initializer_list<double> doorProb;
+  vector<double> doorProb;
   double diggingCost;
 };
 
@@ -915,7 +915,7 @@ void addAvg(int x, int y, const Table<double>& wys, double& avg, int& num) {
   } 
 }
 
-Table<double> genNoiseMap(Rectangle area, vector<int> cornerLevels, double varianceMult) {
+Table<double> genNoiseMap(Rectangle area, vector<int> cornerLevels, double varianceMult, RandomGen& random) {
   int width = 1;
   while (width < area.getW() - 1 || width < area.getH() - 1)
     width *= 2;
@@ -936,7 +936,7 @@ Table<double> genNoiseMap(Rectangle area, vector<int> cornerLevels, double varia
         Vec2 pos = pos1 * a;
         double avg = (wys[pos] + wys[pos.x + a][pos.y] + wys[pos.x][pos.y + a] + wys[pos.x + a][pos.y + a]) / 4;
         wys[pos.x + a / 2][pos.y + a / 2] =
-            avg + variance * (Random.getDouble() * 2 - 1);
+            avg + variance * (random.getDouble() * 2 - 1);
       }
     for (Vec2 pos1 : Rectangle((width - 1) / a, (width - 1) / a + 1)) {
       Vec2 pos = pos1 * a;
@@ -947,7 +947,7 @@ Table<double> genNoiseMap(Rectangle area, vector<int> cornerLevels, double varia
       addAvg(pos.x + a, pos.y, wys, avg, num);
       addAvg(pos.x + a / 2, pos.y + a / 2, wys, avg, num);
       wys[pos.x + a / 2][pos.y] =
-          avg / num + variance * (Random.getDouble() * 2 - 1);
+          avg / num + variance * (random.getDouble() * 2 - 1);
     }
     for (Vec2 pos1 : Rectangle((width - 1) / a + 1, (width - 1) / a)) {
       Vec2 pos = pos1 * a;
@@ -958,7 +958,7 @@ Table<double> genNoiseMap(Rectangle area, vector<int> cornerLevels, double varia
       addAvg(pos.x, pos.y + a , wys, avg, num);
       addAvg(pos.x + a / 2, pos.y + a / 2, wys, avg, num);
       wys[pos.x][pos.y + a / 2] =
-          avg / num + variance * (Random.getDouble() * 2 - 1);
+          avg / num + variance * (random.getDouble() * 2 - 1);
     }
     variance *= varianceMult;
   }
@@ -971,19 +971,19 @@ Table<double> genNoiseMap(Rectangle area, vector<int> cornerLevels, double varia
   return ret;
 }
 
-vector<double> sortedValues(const Table<double>& t) {
+// Returns the values that would be at index ratio * size if all values were sorted.
+vector<double> getQuantiles(const Table<double>& t, const vector<double>& ratios) {
   vector<double> values;
   for (Vec2 v : t.getBounds()) {
     values.push_back(t[v]);
   }
-  sort(values.begin(), values.end());
-/*  vector<double> tmp(values);
-  unique(tmp.begin(), tmp.end());
-    string out;
-    for (double d : values)
-      out.append(convertToString(d) + " ");
-    Debug() << (int)tmp.size() << " unique values out of " << (int)values.size() << " " << out;*/
-  return values;
+  vector<double> ret;
+  for (double ratio : ratios) {
+    auto elem = values.begin() + int(ratio * double(values.size()));
+    nth_element(values.begin(), elem, values.end());
+    ret.push_back(*elem);
+  }
+  return ret;
 }
 
 class Mountains : public LevelMaker {
@@ -994,17 +994,26 @@ class Mountains : public LevelMaker {
 
 
   virtual void make(Level::Builder* builder, Rectangle area) override {
-    Table<double> wys = genNoiseMap(area, cornerLevels, varianceMult);
-    Table<double> fog = genNoiseMap(area, {0, 0, 0, 0, 0}, 0.5);
+    // The maps are generated in parallel, each from its own stream of random numbers.
+    RandomGen heightRandom = Random.makeChild();
+    RandomGen fogRandom = Random.makeChild();
+    Table<double> wys(area);
+    Table<double> fog(area);
+    runInParallel({
+        [&] { wys = genNoiseMap(area, cornerLevels, varianceMult, heightRandom); },
+        [&] { fog = genNoiseMap(area, {0, 0, 0, 0, 0}, 0.5, fogRandom); }});
     for (Vec2 v : area)
       fog[v] += wys[v] / 2;
-    vector<double> values = sortedValues(wys);
-    vector<double> fogValues = sortedValues(fog);
-    double cutOffValHill = values[(int)(ratio * double(values.size()))];
-    double cutOffVal = values[(int)((0.5 + ratio) / 1.5 * double(values.size()))];
-    double cutOffValSnow = values[(int)((3. + ratio) / 4. * double(values.size()))];
-    double cutOffValFogLow = fogValues[(int)(( ratio) / 1.0 * double(fogValues.size()))];
-    double cutOffValFogHigh = fogValues[(int)((1.0 + ratio) / 2.0 * double(fogValues.size()))];
+    vector<double> values;
+    vector<double> fogValues;
+    runInParallel({
+        [&] { values = getQuantiles(wys, {ratio, (0.5 + ratio) / 1.5, (3. + ratio) / 4.}); },
+        [&] { fogValues = getQuantiles(fog, {ratio, (1.0 + ratio) / 2.0}); }});
+    double cutOffValHill = values[0];
+    double cutOffVal = values[1];
+    double cutOffValSnow = values[2];
+    double cutOffValFogLow = fogValues[0];
+    double cutOffValFogHigh = fogValues[1];
     int gCnt = 0, mCnt = 0, hCnt = 0, lCnt = 0, fCnt = 0;
     for (Vec2 v : area) {
       builder->setHeightMap(v, wys[v]);
@@ -1112,9 +1121,8 @@ class Vegetation : public LevelMaker {
       : ratio(_ratio), density(_density), types(_types), probs(_probs), onType(_onType) {}
 
   virtual void make(Level::Builder* builder, Rectangle area) override {
-    Table<double> wys = genNoiseMap(area, {0, 0, 0, 0, 0}, 0.9);
-    vector<double> values = sortedValues(wys);
-    double cutoff = values[values.size() * ratio];
+    Table<double> wys = genNoiseMap(area, {0, 0, 0, 0, 0}, 0.9, Random);
+    double cutoff = getQuantiles(wys, {ratio})[0];
     for (Vec2 v : area)
       if (builder->getType(v) == onType && wys[v] < cutoff && Random.getDouble() <= density)
         builder->putSquare(v, chooseRandom(types, probs));
@@ -64,7 +64,7 @@ class TowerTopLocation : public Location {
       return;
     if (!entered.count(c) && !c->isBlind()) {
  /*     for (Vec2 v : c->getLevel()->getBounds())
-        if ((v - c->getPosition()).lengthD() < 300 && !c->getLevel()->getSquare(v)->isCovered())
+        if ((v - c->getPosition()).lengthD() < 300 && !c->getLevel()->isCovered(v))
           c->remember(v, c->getLevel()->getSquare(v)->getViewObject());*/
       c->privateMessage("You stand at the top of a very tall stone tower.");
       c->privateMessage("You see distant land in all directions.");
@@ -1,14 +1,11 @@
 #include "stdafx.h"
 
 #include <ctime>
+#include <atomic>
 #include <locale>
 #include <sys/types.h>
 #include <sys/stat.h>
 
-#include <boost/iostreams/filtering_streambuf.hpp>
-#include <boost/iostreams/copy.hpp>
-#include "gzstream.h"
-
 #include "dirent.h"
 
 #include "view.h"
@@ -19,13 +16,14 @@
 #include "statistics.h"
 #include "options.h"
 #include "technology.h"
-
-
-using namespace boost::iostreams;
+#include "save_file.h"
+#include "auto_save.h"
 
 struct SaveFileInfo {
   string path;
   time_t date;
+  long size;
+  SaveFileHeader header;
 };
 
 static vector<SaveFileInfo> getSaveFiles(const string& suffix) {
@@ -36,9 +34,12 @@ static vector<SaveFileInfo> getSaveFiles(const string& suffix) {
   while (dirent* ent = readdir(dir)) {
     string name(ent->d_name);
     if (name.size() > suffix.size() && name.substr(name.size() - suffix.size()) == suffix) {
-      struct stat buf;
-      stat(name.c_str(), &buf);
-      ret.push_back({name, buf.st_mtime});
+      if (Optional<SaveFileHeader> header = SaveFile::readHeader(name)) {
+        struct stat buf;
+        stat(name.c_str(), &buf);
+        ret.push_back({name, buf.st_mtime, long(buf.st_size), *header});
+      } else
+        Debug() << "Skipping " << name << ", not a save file of this version";
     }
   }
   closedir(dir);
@@ -73,10 +74,11 @@ static Optional<string> chooseSaveFile(vector<pair<GameType, string>> games, str
     append(allFiles, files);
     if (!files.empty()) {
       noGames = false;
-      auto removeSuf = [&] (const SaveFileInfo& s) { return s.path.substr(0, s.path.size() - 
-          getSaveSuffix(elem.first).size()) + "  (" + getDateString(s.date) + ")"; };
+      auto describe = [&] (const SaveFileInfo& s) { return s.header.name + ", turn "
+          + convertToString(s.header.turn) + "  (" + getDateString(s.date) + ", "
+          + convertToString(int(s.size / 1024)) + " KB)"; };
       options.emplace_back(elem.second, View::TITLE);
-      append(options, View::getListElem(transform2<string>(files, removeSuf)));
+      append(options, View::getListElem(transform2<string>(files, describe)));
     }
   }
   if (noGames) {
@@ -90,17 +92,8 @@ static Optional<string> chooseSaveFile(vector<pair<GameType, string>> games, str
     return Nothing();
 }
 
-static unique_ptr<Model> loadGame(const string& filename, bool eraseFile) {
-  unique_ptr<Model> model;
-  {
-    igzstream ifs(filename.c_str());
-    CHECK(ifs.good()) << "File not found: " << filename;
-    filtering_streambuf<input> in;
-    in.push(ifs);
-    boost::archive::binary_iarchive ia(in);
-    Serialization::registerTypes(ia);
-    ia >> BOOST_SERIALIZATION_NVP(model);
-  }
+static unique_ptr<Model> loadGame(const string& filename, bool eraseFile, std::atomic<double>& progress) {
+  unique_ptr<Model> model = SaveFile::load(filename, [&] (double p) { progress = p; });
 #ifdef RELEASE
   if (eraseFile)
     CHECK(!remove(filename.c_str()));
@@ -108,13 +101,9 @@ static unique_ptr<Model> loadGame(const string& filename, bool eraseFile) {
   return model;
 }
 
-static void saveGame(unique_ptr<Model> model, const string& filename) {
-  ogzstream ofs(filename.c_str());
-  boost::iostreams::filtering_streambuf<boost::iostreams::output> out;
-  out.push(ofs);
-  boost::archive::binary_oarchive oa(ofs);
-  Serialization::registerTypes(oa);
-  oa << BOOST_SERIALIZATION_NVP(model);
+static void saveGame(unique_ptr<Model> model, GameType type, const string& filename,
+    std::atomic<double>& progress) {
+  SaveFile::save(model.get(), type, filename, [&] (double p) { progress = p; });
 }
 
 /*static Table<bool> readSplashTable(const string& path) {
@@ -191,7 +180,7 @@ int main(int argc, char* argv[]) {
         "artifacts.txt", "world.txt", "town_names.txt", "dwarfs.txt", "gods.txt", "demons.txt", "dogs.txt",
         "insults.txt");
     ItemFactory::init();
-    bool modelReady = false;
+    std::atomic<bool> modelReady(false);
     messageBuffer.initialize(view);
     view->reset();
     auto choice = forceMode > -1 ? Optional<int>(forceMode) : view->chooseFromList("", {
@@ -237,11 +226,12 @@ int main(int argc, char* argv[]) {
       exit(0);
     unique_ptr<Model> model;
     string ex;
+    std::atomic<double> progress(0);
     thread t([&] {
       for (int i : Range(5)) {
         try {
           if (savedGame) {
-            model = loadGame(*savedGame, choice == 3);
+            model = loadGame(*savedGame, choice == 3, progress);
           }
           else if (choice == 1)
             model.reset(Model::heroModel(view));
@@ -256,7 +246,10 @@ int main(int argc, char* argv[]) {
       }
       modelReady = true;
     });
-    view->displaySplash(savedGame ? View::LOADING : View::CREATING, modelReady);
+    if (savedGame)
+      view->displaySplash(View::LOADING, modelReady, &progress);
+    else
+      view->displaySplash(View::CREATING, modelReady);
     t.join();
     model->setView(view);
     if (genExit)
@@ -267,6 +260,10 @@ int main(int argc, char* argv[]) {
           " to rusolis@poczta.fm Thanks!");
       saveExceptionLine("crash.log", ex);
     }
+    // The autosaves are only kept if the game crashes.
+    unique_ptr<AutoSave> autosave;
+    if (Options::getValue(OptionId::AUTOSAVE))
+      autosave.reset(new AutoSave(model->getGameIdentifier() + "_autosave", getSaveSuffix(model->getGameType())));
     int var = 0;
     try {
       while (1) {
@@ -274,15 +271,28 @@ int main(int argc, char* argv[]) {
           model->update(var++);
         else
           model->update(double(view->getTimeMilli()) / 300);
+        if (autosave)
+          autosave->update(model.get());
       }
     } catch (GameOverException ex) {
+      if (autosave)
+        autosave->removeSlots();
     } catch (SaveGameException ex) {
-      bool ready = false;
+      std::atomic<bool> ready(false);
+      progress = 0;
+      string path = model->getGameIdentifier() + getSaveSuffix(ex.type);
       thread t([&] {
-        saveGame(std::move(model), model->getGameIdentifier() + getSaveSuffix(ex.type));
+        try {
+          saveGame(std::move(model), ex.type, path, progress);
+        } catch (string s) {
+          Debug() << "Saving failed: " << s;
+        }
         ready = true; });
-      view->displaySplash(View::SAVING, ready);
+      view->displaySplash(View::SAVING, ready, &progress);
       t.join();
+      // Keep the autosaves unless the game is really saved.
+      if (autosave && SaveFile::readHeader(path))
+        autosave->removeSlots();
     }
 #ifdef RELEASE
     catch (string ex) {
@@ -98,23 +98,27 @@ void MapGui::onMouseMove(Vec2) {
 }
 
 
-Optional<ViewObject> MapGui::drawObjectAbs(Renderer& renderer, int x, int y, const ViewIndex& index,
+static void addOutline(DrawList& list, int x, int y, int sizeX, int sizeY, Color color) {
+  list.addOverlay(Rectangle(x, y, x + sizeX, y + sizeY), 1, [=] (Renderer& renderer) {
+      renderer.drawFilledRectangle(x, y, x + sizeX, y + sizeY, Color::Transparent, color); });
+}
+
+Optional<ViewObject> MapGui::addObjects(DrawList& list, int x, int y, const ViewIndex& index,
     int sizeX, int sizeY, Vec2 tilePos, bool highlighted) {
+  vector<ViewLayer> layers = layout->getLayers();
   vector<ViewObject> objects;
   if (spriteMode) {
-    for (ViewLayer layer : layout->getLayers())
+    for (ViewLayer layer : layers)
       if (index.hasObject(layer))
         objects.push_back(index.getObject(layer));
   } else
-    if (auto object = index.getTopObject(layout->getLayers()))
+    if (auto object = index.getTopObject(layers))
       objects.push_back(*object);
-  for (ViewObject& object : objects) {
-    if (object.hasModifier(ViewObject::PLAYER)) {
-      renderer.drawFilledRectangle(x, y, x + sizeX, y + sizeY, Color::Transparent, lightGray);
-    }
-    if (object.hasModifier(ViewObject::TEAM_HIGHLIGHT)) {
-      renderer.drawFilledRectangle(x, y, x + sizeX, y + sizeY, Color::Transparent, darkGreen);
-    }
+  for (const ViewObject& object : objects) {
+    if (object.hasModifier(ViewObject::PLAYER))
+      addOutline(list, x, y, sizeX, sizeY, lightGray);
+    if (object.hasModifier(ViewObject::TEAM_HIGHLIGHT))
+      addOutline(list, x, y, sizeX, sizeY, darkGreen);
     Tile tile = Tile::getTile(object, spriteMode);
     Color color = getBleedingColor(object);
     if (object.hasModifier(ViewObject::INVISIBLE))
@@ -146,37 +150,48 @@ Optional<ViewObject> MapGui::drawObjectAbs(Renderer& renderer, int x, int y, con
       if (object.hasModifier(ViewObject::MOVE_UP))
         moveY = -6;
       if (object.layer() == ViewLayer::CREATURE || object.hasModifier(ViewObject::ROUND_SHADOW)) {
-        renderer.drawSprite(x, y - 2, 2 * Renderer::nominalSize, 22 * Renderer::nominalSize, Renderer::nominalSize, Renderer::nominalSize, Renderer::tiles[0], width, height);
+        list.addSprite(x, y - 2, 2 * Renderer::nominalSize,
+            22 * Renderer::nominalSize, Renderer::nominalSize, Renderer::nominalSize, 0, width, height);
         moveY = -6;
       }
-      renderer.drawSprite(x + off, y + moveY + off, coord.x * sz,
-          coord.y * sz, sz, sz, Renderer::tiles[tile.getTexNum()], width, height, color);
+      list.addSprite(x + off, y + moveY + off, coord.x * sz,
+          coord.y * sz, sz, sz, tile.getTexNum(), width, height, color);
       if (contains({ViewLayer::FLOOR, ViewLayer::FLOOR_BACKGROUND}, object.layer()) && 
           shadowed.count(tilePos) && !tile.stickingOut)
-        renderer.drawSprite(x, y, 1 * Renderer::nominalSize, 21 * Renderer::nominalSize, Renderer::nominalSize, Renderer::nominalSize, Renderer::tiles[5], width, height);
+        list.addSprite(x, y, 1 * Renderer::nominalSize,
+            21 * Renderer::nominalSize, Renderer::nominalSize, Renderer::nominalSize, 5, width, height);
       if (object.getBurning() > 0) {
-        renderer.drawSprite(x, y, Random.getRandom(10, 12) * Renderer::nominalSize, 0 * Renderer::nominalSize,
-            Renderer::nominalSize, Renderer::nominalSize, Renderer::tiles[2], width, height);
+        list.addSprite(x, y, Random.getRandom(10, 12) * Renderer::nominalSize,
+            0 * Renderer::nominalSize, Renderer::nominalSize, Renderer::nominalSize, 2, width, height);
       }
       if (object.hasModifier(ViewObject::LOCKED))
-        renderer.drawSprite(x + (Renderer::nominalSize - Renderer::tileSize[3]) / 2, y, 5 * Renderer::tileSize[3], 6 * Renderer::tileSize[3], Renderer::tileSize[3], Renderer::tileSize[3], Renderer::tiles[3]);
+        list.addSprite(x + (Renderer::nominalSize - Renderer::tileSize[3]) / 2,
+            y, 5 * Renderer::tileSize[3], 6 * Renderer::tileSize[3], Renderer::tileSize[3], Renderer::tileSize[3],
+            3, -1, -1);
     } else {
-      renderer.drawText(tile.symFont ? Renderer::SYMBOL_FONT : Renderer::TILE_FONT, sizeY, Tile::getColor(object),
-          x + sizeX / 2, y - 3, tile.text, true);
-      if (object.getBurning() > 0) {
-        renderer.drawText(Renderer::SYMBOL_FONT, sizeY, WindowView::getFireColor(),
-            x + sizeX / 2, y - 3, L'ѡ', true);
-        if (object.getBurning() > 0.5)
-          renderer.drawText(Renderer::SYMBOL_FONT, sizeY, WindowView::getFireColor(),
-              x + sizeX / 2, y - 3, L'Ѡ', true);
-      }
+      // Text is drawn glyph by glyph anyway. Glyphs can stick out of the tile, so the overlay covers
+      // the neighbouring tiles too.
+      Renderer::FontId font = tile.symFont ? Renderer::SYMBOL_FONT : Renderer::TILE_FONT;
+      Color textColor = Tile::getColor(object);
+      String text = tile.text;
+      double burning = object.getBurning();
+      Color fireColor = WindowView::getFireColor();
+      int numDrawCalls = 1 + (burning > 0) + (burning > 0.5);
+      list.addOverlay(Rectangle(x - sizeX, y - sizeY, x + 2 * sizeX, y + 2 * sizeY), numDrawCalls,
+          [=] (Renderer& renderer) {
+        renderer.drawText(font, sizeY, textColor, x + sizeX / 2, y - 3, text, true);
+        if (burning > 0) {
+          renderer.drawText(Renderer::SYMBOL_FONT, sizeY, fireColor, x + sizeX / 2, y - 3, L'ѡ', true);
+          if (burning > 0.5)
+            renderer.drawText(Renderer::SYMBOL_FONT, sizeY, fireColor, x + sizeX / 2, y - 3, L'Ѡ', true);
+        }
+      });
     }
   }
-  if (highlighted) {
-    renderer.drawFilledRectangle(x, y, x + sizeX, y + sizeY, Color::Transparent, lightGray);
-  }
+  if (highlighted)
+    addOutline(list, x, y, sizeX, sizeY, lightGray);
   if (auto highlight = index.getHighlight())
-    renderer.drawFilledRectangle(x, y, x + sizeX, y + sizeY, getHighlightColor(*highlight));
+    list.addFilledRectangle(x, y, x + sizeX, y + sizeY, getHighlightColor(*highlight));
   if (!objects.empty())
     return objects.back();
   else
@@ -205,31 +220,39 @@ void MapGui::updateObjects(const MapMemory* mem) {
 }
 
 
-void MapGui::render(Renderer& renderer) {
+Optional<ViewObject> MapGui::buildDrawList(DrawList& list, Optional<Vec2> highlightedPos) {
   int sizeX = layout->squareWidth();
   int sizeY = layout->squareHeight();
-  renderer.drawFilledRectangle(getBounds(), almostBlack);
+  list.clear();
+  list.setGrid(getBounds(), layout->projectOnScreen(getBounds(), Vec2(0, 0)), sizeX, sizeY);
+  list.addFilledRectangle(getBounds().getPX(), getBounds().getPY(), getBounds().getKX(),
+      getBounds().getKY(), almostBlack);
   Optional<ViewObject> highlighted;
-  Optional<Vec2> highlightedPos = getHighlightedTile(renderer);
   for (Vec2 wpos : layout->getAllTiles(getBounds(), levelBounds)) {
     Vec2 pos = layout->projectOnScreen(getBounds(), wpos);
     if (!spriteMode && wpos.inRectangle(levelBounds))
-      renderer.drawFilledRectangle(pos.x, pos.y, pos.x + sizeX, pos.y + sizeY, black);
+      list.addFilledRectangle(pos.x, pos.y, pos.x + sizeX, pos.y + sizeY, black);
     if (!objects[wpos] || objects[wpos]->isEmpty()) {
       if (wpos.inRectangle(levelBounds))
-        renderer.drawFilledRectangle(pos.x, pos.y, pos.x + sizeX, pos.y + sizeY, black);
-      if (highlightedPos == wpos) {
-        renderer.drawFilledRectangle(pos.x, pos.y, pos.x + sizeX, pos.y + sizeY, Color::Transparent, lightGray);
-      }
+        list.addFilledRectangle(pos.x, pos.y, pos.x + sizeX, pos.y + sizeY, black);
+      if (highlightedPos == wpos)
+        addOutline(list, pos.x, pos.y, sizeX, sizeY, lightGray);
       continue;
     }
     const ViewIndex& index = *objects[wpos];
     bool isHighlighted = highlightedPos == wpos;
-    if (auto topObject = drawObjectAbs(renderer, pos.x, pos.y, index, sizeX, sizeY, wpos, isHighlighted)) {
+    if (auto topObject = addObjects(list, pos.x, pos.y, index, sizeX, sizeY, wpos, isHighlighted)) {
       if (isHighlighted)
         highlighted = *topObject;
     }
   }
+  return highlighted;
+}
+
+void MapGui::render(Renderer& renderer) {
+  Optional<Vec2> highlightedPos = getHighlightedTile(renderer);
+  Optional<ViewObject> highlighted = buildDrawList(drawList, highlightedPos);
+  renderer.drawList(drawList);
   if (highlightedPos && highlighted) {
     Color col = white;
     if (highlighted->isHostile())
@@ -239,5 +262,3 @@ void MapGui::render(Renderer& renderer) {
     drawHint(renderer, col, highlighted->getDescription(true));
   }
 }
-
-
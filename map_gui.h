@@ -26,10 +26,16 @@ class MapGui : public GuiElem {
   Optional<Vec2> getHighlightedTile(Renderer& renderer);
   void drawHint(Renderer& renderer, Color color, const string& text);
 
+  /** Collects everything that render() draws on the map into \paramname{list}, and returns the top object
+    * on the highlighted tile. Doesn't need a window, so the map drawing can be tested and benchmarked
+    * without one.*/
+  Optional<ViewObject> buildDrawList(DrawList& list, Optional<Vec2> highlightedPos);
+
   private:
-  Optional<ViewObject> drawObjectAbs(Renderer& renderer, int x, int y, const ViewIndex& index, int sizeX, int sizeY,
+  Optional<ViewObject> addObjects(DrawList& list, int x, int y, const ViewIndex& index, int sizeX, int sizeY,
       Vec2 tilePos, bool highlighted);
   MapLayout* layout;
+  DrawList drawList;
   const Table<Optional<ViewIndex>>& objects;
   const MapMemory* lastMemory = nullptr;
   bool spriteMode;
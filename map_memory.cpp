@@ -2,41 +2,125 @@
 
 #include "map_memory.h"
 
-MapMemory::MapMemory() : table(600, 600) {
+MapMemory::MapMemory() : chunks(1, 1) {
 }
 
-MapMemory::MapMemory(const MapMemory& other) : table(other.table.getWidth(), other.table.getHeight()) {
-  for (Vec2 v : table.getBounds())
-    table[v] = other.table[v];
+MapMemory::MapMemory(const MapMemory& other) : chunks(other.chunks.getBounds()) {
+  for (Vec2 v : chunks.getBounds())
+    chunks[v] = other.chunks[v];
 }
 
-template <class Archive> 
+MapMemory& MapMemory::operator = (const MapMemory& other) {
+  Table<shared_ptr<Chunk>> copy(other.chunks.getBounds());
+  for (Vec2 v : copy.getBounds())
+    copy[v] = other.chunks[v];
+  chunks = std::move(copy);
+  return *this;
+}
+
+template <class Archive>
+void MapMemory::Chunk::serialize(Archive& ar, const unsigned int version) {
+  vector<short> indexes;
+  if (Archive::is_saving::value)
+    for (int i : Range(chunkArea))
+      if (remembered[i])
+        indexes.push_back(i);
+  ar & BOOST_SERIALIZATION_NVP(indexes);
+  for (short i : indexes) {
+    remembered[i] = true;
+    ar & boost::serialization::make_nvp("square", squares[i]);
+  }
+}
+
+// Only the chunks with something in them are saved, together with their indexes in the table.
+template <class Archive>
 void MapMemory::serialize(Archive& ar, const unsigned int version) {
-  ar & SVAR(table);
+  vector<int> indexes;
+  int width = chunks.getWidth();
+  int height = chunks.getHeight();
+  if (Archive::is_saving::value)
+    for (Vec2 v : chunks.getBounds())
+      if (chunks[v] && chunks[v]->remembered.any())
+        indexes.push_back(v.y * width + v.x);
+  ar & BOOST_SERIALIZATION_NVP(width)
+    & BOOST_SERIALIZATION_NVP(height)
+    & BOOST_SERIALIZATION_NVP(indexes);
+  if (Archive::is_loading::value)
+    chunks = Table<shared_ptr<Chunk>>(width, height);
+  for (int i : indexes) {
+    Vec2 v(i % width, i / width);
+    if (Archive::is_loading::value)
+      chunks[v].reset(new Chunk());
+    ar & boost::serialization::make_nvp("chunk", *chunks[v]);
+  }
   CHECK_SERIAL;
 }
 
 SERIALIZABLE(MapMemory);
 
+int MapMemory::getIndex(Vec2 pos) {
+  return (pos.y % chunkSize) * chunkSize + pos.x % chunkSize;
+}
+
+const MapMemory::Chunk* MapMemory::findChunk(Vec2 pos) const {
+  Vec2 chunkPos = pos / chunkSize;
+  if (pos.x < 0 || pos.y < 0 || !chunkPos.inRectangle(chunks.getBounds()))
+    return nullptr;
+  return chunks[chunkPos].get();
+}
+
+MapMemory::Chunk& MapMemory::getChunkForWrite(Vec2 pos) {
+  CHECK(pos.x >= 0 && pos.y >= 0) << "Can't remember " << pos;
+  Vec2 chunkPos = pos / chunkSize;
+  if (!chunkPos.inRectangle(chunks.getBounds())) {
+    Table<shared_ptr<Chunk>> grown(max(chunks.getWidth(), chunkPos.x + 1),
+        max(chunks.getHeight(), chunkPos.y + 1));
+    for (Vec2 v : chunks.getBounds())
+      grown[v] = std::move(chunks[v]);
+    chunks = std::move(grown);
+  }
+  shared_ptr<Chunk>& chunk = chunks[chunkPos];
+  if (!chunk)
+    chunk.reset(new Chunk());
+  else if (chunk.use_count() > 1)
+    chunk.reset(new Chunk(*chunk));
+  return *chunk;
+}
+
 void MapMemory::addObject(Vec2 pos, const ViewObject& obj) {
-  if (!table[pos])
-    table[pos] = ViewIndex();
-  table[pos]->insert(obj);
-  table[pos]->setHighlight(HighlightType::MEMORY);
+  Chunk& chunk = getChunkForWrite(pos);
+  int index = getIndex(pos);
+  if (!chunk.remembered[index]) {
+    chunk.squares[index] = ViewIndex();
+    chunk.remembered[index] = true;
+  }
+  chunk.squares[index].insert(obj);
+  chunk.squares[index].setHighlight(HighlightType::MEMORY);
 }
 
 void MapMemory::clearSquare(Vec2 pos) {
-  table[pos] = Nothing();
+  if (hasViewIndex(pos))
+    getChunkForWrite(pos).remembered[getIndex(pos)] = false;
 }
 
 bool MapMemory::hasViewIndex(Vec2 pos) const {
-  return table[pos];
+  const Chunk* chunk = findChunk(pos);
+  return chunk && chunk->remembered[getIndex(pos)];
 }
 
 ViewIndex MapMemory::getViewIndex(Vec2 pos) const {
-  return *table[pos];
+  const Chunk* chunk = findChunk(pos);
+  CHECK(chunk && chunk->remembered[getIndex(pos)]) << "Nothing remembered on " << pos;
+  return chunk->squares[getIndex(pos)];
 }
-  
+
+int MapMemory::getNumChunks() const {
+  int ret = 0;
+  for (Vec2 v : chunks.getBounds())
+    ret += !!chunks[v];
+  return ret;
+}
+
 const MapMemory& MapMemory::empty() {
   static MapMemory mem;
   return mem;
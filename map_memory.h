@@ -5,23 +5,49 @@
 #include "view_index.h"
 #include "util.h"
 
+/** The objects remembered on the squares of a level. The squares are kept in chunks, which are only allocated
+  * when something is first remembered in them, so the memory grows with the part of the level that was seen.
+  * Copies share their chunks until one of them changes.*/
 class MapMemory {
   public:
   MapMemory();
   MapMemory(const MapMemory&);
+  MapMemory& operator = (const MapMemory&);
   void addObject(Vec2 pos, const ViewObject& obj);
   void clearSquare(Vec2 pos);
   bool hasViewIndex(Vec2 pos) const;
   ViewIndex getViewIndex(Vec2 pos) const;
   static const MapMemory& empty();
 
-  template <class Archive> 
+  /** Returns the number of chunks that have been allocated.*/
+  int getNumChunks() const;
+
+  template <class Archive>
   void serialize(Archive& ar, const unsigned int version);
 
   SERIAL_CHECKER;
 
+  static const int chunkSize = 16;
+
   private:
-  Table<Optional<ViewIndex>> SERIAL(table);
+  static const int chunkArea = chunkSize * chunkSize;
+
+  struct Chunk {
+    ViewIndex squares[chunkArea];
+    std::bitset<chunkArea> remembered;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version);
+  };
+
+  static int getIndex(Vec2 pos);
+  const Chunk* findChunk(Vec2 pos) const;
+  /** Returns the chunk of the square, allocating it if needed, or making a copy if it's shared.*/
+  Chunk& getChunkForWrite(Vec2 pos);
+
+  /** Chunks by their position. Only the ones with something remembered in them are allocated. Grows when
+    * something is remembered outside of it.*/
+  Table<shared_ptr<Chunk>> chunks;
 };
 
 #endif
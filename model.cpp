@@ -10,31 +10,53 @@
 #include "options.h"
 #include "task.h"
 #include "technology.h"
+#include "profiler.h"
 
 template <class Archive> 
 void Model::serialize(Archive& ar, const unsigned int version) { 
-  ar& SVAR(levels)
-    & SVAR(villageControls)
-    & SVAR(timeQueue)
-    & SVAR(deadCreatures)
+  int numLevels = levels.size();
+  ar& BOOST_SERIALIZATION_NVP(numLevels)
     & SVAR(lastTick)
-    & SVAR(levelLinks)
-    & SVAR(collective)
     & SVAR(won)
     & SVAR(addHero)
     & SVAR(adventurer);
-  CHECK_SERIAL;
-  Skill::serializeAll(ar);
-  Deity::serializeAll(ar);
-  Quests::serializeAll(ar);
-  Tribes::serializeAll(ar);
-  Creature::serializeAll(ar);
-  Technology::serializeAll(ar);
-  Statistics::serialize(ar, version);
+  if (Archive::is_loading::value)
+    levels.resize(numLevels);
 }
 
 SERIALIZABLE(Model);
 
+int Model::getNumSaveSections() const {
+  return levels.size() + 2;
+}
+
+template <class Archive>
+void Model::serializeSection(Archive& ar, int section) {
+  CHECK(section >= 0 && section < getNumSaveSections());
+  int numLevels = levels.size();
+  if (section < numLevels)
+    ar & boost::serialization::make_nvp("level", levels[section]);
+  else if (section == numLevels) {
+    ar& SVAR(villageControls)
+      & SVAR(timeQueue)
+      & SVAR(deadCreatures)
+      & SVAR(levelLinks)
+      & SVAR(collective);
+    CHECK_SERIAL;
+  } else {
+    Skill::serializeAll(ar);
+    Deity::serializeAll(ar);
+    Quests::serializeAll(ar);
+    Tribes::serializeAll(ar);
+    Creature::serializeAll(ar);
+    Technology::serializeAll(ar);
+    Statistics::serialize(ar, 0);
+  }
+}
+
+template void Model::serializeSection(boost::archive::binary_iarchive&, int);
+template void Model::serializeSection(boost::archive::binary_oarchive&, int);
+
 bool Model::isTurnBased() {
   return !collective || collective->isTurnBased();
 }
@@ -50,13 +72,20 @@ const Creature* Model::getPlayer() const {
   return nullptr;
 }
 
+void Model::setConsistencyChecks(bool on) {
+  consistencyChecks = on;
+  Creature::setCacheChecks(on);
+}
+
 void Model::update(double totalTime) {
+  PROFILE_ZONE("update");
   if (addHero) {
     CHECK(collective && collective->isRetired());
     landHeroPlayer();
     addHero = false;
   }
   if (collective) {
+    PROFILE_ZONE("render");
     collective->render(view);
   }
   do {
@@ -65,6 +94,7 @@ void Model::update(double totalTime) {
     Debug() << creature->getTheName() << " moving now " << creature->getTime();
     double time = creature->getTime();
     if (collective && !collective->isTurnBased()) {
+      PROFILE_ZONE("collective input");
       while (1) {
         CollectiveAction action = view->getClick(time);
         if (action.getType() == CollectiveAction::IDLE)
@@ -75,17 +105,25 @@ void Model::update(double totalTime) {
     if (time > totalTime)
       return;
     if (time >= lastTick + 1) {
-      MEASURE({ tick(time); }, "ticking time");
+      PROFILE_ZONE("tick");
+      tick(time);
+    }
+    if (time != preparedTime) {
+      prepareMoves();
+      preparedTime = time;
     }
     bool unpossessed = false;
     if (!creature->isDead()) {
+      PROFILE_ZONE("creature move");
       bool wasPlayer = creature->isPlayer();
       creature->makeMove();
       if (wasPlayer && !creature->isPlayer())
         unpossessed = true;
     }
-    if (collective)
+    if (collective) {
+      PROFILE_ZONE("collective update");
       collective->update(creature);
+    }
     if (!creature->isDead()) {
       Level* level = creature->getLevel();
       CHECK(level->getSquare(creature->getPosition())->getCreature() == creature);
@@ -95,17 +133,50 @@ void Model::update(double totalTime) {
   } while (1);
 }
 
+void Model::prepareMoves() {
+  vector<Creature*> batch;
+  for (Creature* c : timeQueue.getNextBatch())
+    if (c->needsSightUpdate())
+      batch.push_back(c);
+  if (batch.size() < minParallelMoves)
+    return;
+  PROFILE_ZONE("prepare moves");
+  for (PLevel& level : levels) {
+    vector<Vec2> positions;
+    for (Creature* c : batch)
+      if (c->getLevel() == level.get())
+        positions.push_back(c->getPosition());
+    if (!positions.empty())
+      level->precomputeSight(positions);
+  }
+  vector<function<void()>> tasks;
+  for (Creature* c : batch)
+    tasks.push_back([c] { c->updateSight(); });
+  runInParallel(tasks);
+}
+
 void Model::tick(double time) {
   Debug() << "Turn " << time;
-  for (Creature* c : timeQueue.getAllCreatures()) {
-    c->tick(time);
+  {
+    PROFILE_ZONE("creature tick");
+    for (Creature* c : timeQueue.getAllCreatures()) {
+      c->tick(time);
+    }
+  }
+  {
+    PROFILE_ZONE("square tick");
+    for (PLevel& l : levels)
+      l->tick(time);
   }
-  for (PLevel& l : levels)
-    for (Square* square : l->getTickingSquares())
-      square->tick(time);
   lastTick = time;
+  if (consistencyChecks)
+    for (PLevel& l : levels)
+      l->checkConsistency();
   if (collective) {
+    PROFILE_ZONE("collective tick");
     collective->tick();
+    if (consistencyChecks)
+      collective->checkConsistency();
     if (!collective->isRetired()) {
       bool conquered = true;
       for (PVillageControl& control : villageControls) {
@@ -322,10 +393,7 @@ void Model::exitAction() {
       }
       }
     case SAVE:
-      if (!collective || collective->isRetired())
-        throw SaveGameException(GameType::ADVENTURER);
-      else
-        throw SaveGameException(GameType::KEEPER);
+      throw SaveGameException(getGameType());
     case ABANDON: throw GameOverException();
     default: break;
   }
@@ -350,6 +418,13 @@ void Model::landHeroPlayer() {
   adventurer = true;
 }
 
+GameType Model::getGameType() const {
+  if (!collective || collective->isRetired())
+    return GameType::ADVENTURER;
+  else
+    return GameType::KEEPER;
+}
+
 string Model::getGameIdentifier() const {
   if (!adventurer)
     return *NOTNULL(collective.get())->getKeeper()->getFirstName();
@@ -486,6 +561,14 @@ Model* Model::splashModel(View* view, const Table<bool>& bitmap) {
   return m;
 }
 
+vector<Level*> Model::getLevels() const {
+  return extractRefs(levels);
+}
+
+int Model::getTurn() const {
+  return max(0, int(lastTick));
+}
+
 View* Model::getView() {
   return view;
 }
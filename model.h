@@ -48,15 +48,29 @@ class Model : public EventListener {
 
   const vector<VillageControl*> getVillageControls() const;
 
+  /** Returns all levels, starting with the top level.*/
+  vector<Level*> getLevels() const;
+
+  /** Returns the last turn in which the levels were ticked.*/
+  int getTurn() const;
+
   bool isTurnBased();
 
   string getGameIdentifier() const;
+
+  /** Returns the type that the game is saved as, either ADVENTURER or KEEPER.*/
+  GameType getGameType() const;
   void exitAction();
 
   View* getView();
   void setView(View*);
 
   void tick(double time);
+
+  /** If on, every tick checks that the cached square attributes of all levels agree with the squares,
+    * and cached creature attributes and sight are checked whenever used. See Level::checkConsistency(),
+    * Collective::checkConsistency() and Creature::setCacheChecks().*/
+  void setConsistencyChecks(bool);
   void onKillEvent(const Creature* victim, const Creature* killer) override;
   void gameOver(const Creature* player, int numKills, const string& enemiesString, int points);
   void conquered(const string& title, const string& land, vector<const Creature*> kills, int points);
@@ -65,8 +79,19 @@ class Model : public EventListener {
   void showHighscore(bool highlightLast = false);
   void retireCollective();
 
+  /** Only saves the number of levels and a few flags. The rest of the model is saved after it in sections,
+    * see serializeSection().*/
   SERIALIZATION_DECL(Model);
 
+  /** Returns the number of save sections: one for every level, one for the rest of the model and one for the
+    * global registries.*/
+  int getNumSaveSections() const;
+
+  /** Saves or loads one section of the model. All sections have to be serialized in order, in the same archive
+    * and after the model itself, so that the pointers to the model and between the sections are kept.*/
+  template <class Archive>
+  void serializeSection(Archive& ar, int section);
+
   Encyclopedia keeperopedia;
 
   private:
@@ -77,8 +102,12 @@ class Model : public EventListener {
   void addLink(StairDirection, StairKey, Level*, Level*);
   Level* prepareTopLevel(vector<SettlementInfo> settlements);
   Level* prepareTopLevel2(vector<SettlementInfo> settlements);
+  /** Updates in parallel what the creatures that move next at the same time can see. The moves are still
+    * made one by one, and a creature that is affected by an earlier move looks again when its turn comes.*/
+  void prepareMoves();
 
-  vector<PLevel> SERIAL(levels);
+  /** Saved one by one in serializeSection().*/
+  vector<PLevel> levels;
   vector<PVillageControl> SERIAL(villageControls);
   View* view;
   TimeQueue SERIAL(timeQueue);
@@ -89,6 +118,11 @@ class Model : public EventListener {
   bool SERIAL2(won, false);
   bool SERIAL2(addHero, false);
   bool SERIAL2(adventurer, false);
+  bool consistencyChecks = false;
+  /** Time of the creatures prepared by prepareMoves().*/
+  double preparedTime = -1;
+  /** Smaller groups of creatures aren't worth starting threads for.*/
+  static const int minParallelMoves = 16;
 };
 
 #endif
@@ -6,6 +6,7 @@
 #include "collective.h"
 #include "village_control.h"
 #include "task.h"
+#include "profiler.h"
 
 template <class Archive> 
 void MonsterAI::serialize(Archive& ar, const unsigned int version) {
@@ -73,6 +74,8 @@ MoveInfo Behaviour::tryToApplyItem(EffectType type, double maxTurns) {
 
 class Heal : public Behaviour {
   public:
+  virtual const char* getName() const override { return "Heal"; }
+
   Heal(Creature* c) : Behaviour(c) {}
 
   virtual double itemValue(const Item* item) {
@@ -145,6 +148,8 @@ class Heal : public Behaviour {
 
 class Rest : public Behaviour {
   public:
+  virtual const char* getName() const override { return "Rest"; }
+
   Rest(Creature* c) : Behaviour(c) {}
 
   virtual MoveInfo getMove() {
@@ -161,6 +166,8 @@ class Rest : public Behaviour {
 
 class MoveRandomly : public Behaviour {
   public:
+  virtual const char* getName() const override { return "MoveRandomly"; }
+
   MoveRandomly(Creature* c, int _memSize) 
       : Behaviour(c), memSize(_memSize) {}
 
@@ -212,6 +219,8 @@ class MoveRandomly : public Behaviour {
 
 class AttackPest : public Behaviour {
   public:
+  virtual const char* getName() const override { return "AttackPest"; }
+
   AttackPest(Creature* c) : Behaviour(c) {}
 
   virtual MoveInfo getMove() override {
@@ -244,6 +253,8 @@ class AttackPest : public Behaviour {
 
 class BirdFlyAway : public Behaviour {
   public:
+  virtual const char* getName() const override { return "BirdFlyAway"; }
+
   BirdFlyAway(Creature* c, double _maxDist) : Behaviour(c), maxDist(_maxDist) {}
 
   virtual MoveInfo getMove() override {
@@ -271,6 +282,8 @@ class BirdFlyAway : public Behaviour {
 
 class GoldLust : public Behaviour {
   public:
+  virtual const char* getName() const override { return "GoldLust"; }
+
   GoldLust(Creature* c) : Behaviour(c) {}
 
   virtual double itemValue(const Item* item) {
@@ -290,6 +303,8 @@ class GoldLust : public Behaviour {
 
 class Fighter : public Behaviour, public EventListener {
   public:
+  virtual const char* getName() const override { return "Fighter"; }
+
   Fighter(Creature* c, double powerR, bool _chase) : Behaviour(c), maxPowerRatio(powerR), chase(_chase) {
     courage = c->getCourage();
   }
@@ -322,6 +337,15 @@ class Fighter : public Behaviour, public EventListener {
   virtual const Level* getListenerLevel() const override {
     return creature->getLevel();
   }
+
+  // Without enemies in view there is nothing to fight, apart from following the last seen one.
+  virtual double getIdleTime() const override {
+    return 5;
+  }
+
+  virtual int getWakeEvents() const override {
+    return ENEMY_IN_VIEW | ATTACKED;
+  }
  
   virtual MoveInfo getMove() override {
     const Creature* other = getClosestEnemy();
@@ -564,6 +588,8 @@ class Fighter : public Behaviour, public EventListener {
 
 class GuardTarget : public Behaviour {
   public:
+  virtual const char* getName() const override { return "GuardTarget"; }
+
   GuardTarget(Creature* c, double minD, double maxD) : Behaviour(c), minDist(minD), maxDist(maxD) {}
 
   SERIALIZATION_CONSTRUCTOR(GuardTarget);
@@ -597,6 +623,8 @@ class GuardTarget : public Behaviour {
 
 class GuardArea : public Behaviour {
   public:
+  virtual const char* getName() const override { return "GuardArea"; }
+
   GuardArea(Creature* c, const Location* l) : Behaviour(c), location(l), area(l->getBounds()) {}
 
   virtual MoveInfo getMove() override {
@@ -633,6 +661,8 @@ class GuardArea : public Behaviour {
 
 class GuardSquare : public GuardTarget {
   public:
+  virtual const char* getName() const override { return "GuardSquare"; }
+
   GuardSquare(Creature* c, Vec2 _pos, double minDist, double maxDist) : GuardTarget(c, minDist, maxDist), pos(_pos) {}
 
   virtual MoveInfo getMove() override {
@@ -653,6 +683,8 @@ class GuardSquare : public GuardTarget {
 
 class Wait : public Behaviour {
   public:
+  virtual const char* getName() const override { return "Wait"; }
+
   Wait(Creature* c) : Behaviour(c) {}
 
   virtual MoveInfo getMove() override {
@@ -671,8 +703,18 @@ class Wait : public Behaviour {
 
 class DoorEater : public Behaviour {
   public:
+  virtual const char* getName() const override { return "DoorEater"; }
+
   DoorEater(Creature* c) : Behaviour(c) {}
 
+  virtual double getIdleTime() const override {
+    return 5;
+  }
+
+  virtual int getWakeEvents() const override {
+    return ATTACKED;
+  }
+
   virtual MoveInfo getMove() override {
     Optional<Vec2> closestDoor;
     for (Vec2 v : Rectangle(-10, -10, 10, 10))
@@ -704,6 +746,8 @@ class DoorEater : public Behaviour {
 
 class Summoned : public GuardTarget, public EventListener {
   public:
+  virtual const char* getName() const override { return "Summoned"; }
+
   Summoned(Creature* c, Creature* _target, double minDist, double maxDist, double ttl) 
       : GuardTarget(c, minDist, maxDist), target(_target), dieTime(target->getTime() + ttl) {
   }
@@ -760,6 +804,8 @@ class Summoned : public GuardTarget, public EventListener {
 
 class Thief : public Behaviour {
   public:
+  virtual const char* getName() const override { return "Thief"; }
+
   Thief(Creature* c) : Behaviour(c) {}
  
   virtual MoveInfo getMove() override {
@@ -810,6 +856,8 @@ class Thief : public Behaviour {
 
 class ByCollective : public Behaviour {
   public:
+  virtual const char* getName() const override { return "ByCollective"; }
+
   ByCollective(Creature* c, Collective* col) : Behaviour(c), collective(col) {}
 
   virtual MoveInfo getMove() override {
@@ -830,6 +878,8 @@ class ByCollective : public Behaviour {
 
 class ChooseRandom : public Behaviour {
   public:
+  virtual const char* getName() const override { return "ChooseRandom"; }
+
   ChooseRandom(Creature* c, vector<Behaviour*> beh, vector<double> w) : Behaviour(c), behaviours(beh), weights(w) {}
 
   virtual MoveInfo getMove() override {
@@ -851,10 +901,12 @@ class ChooseRandom : public Behaviour {
 
 class GoToHeart : public Behaviour {
   public:
+  virtual const char* getName() const override { return "GoToHeart"; }
+
   GoToHeart(Creature* c, Vec2 _heartPos) : Behaviour(c), heartPos(_heartPos) {}
 
   virtual MoveInfo getMove() override {
-    if (Optional<Vec2> move = creature->getMoveTowards(heartPos)) 
+    if (Optional<Vec2> move = creature->getSharedMoveTowards({heartPos}))
       return {1.0, [this, move] () {
         creature->move(*move);
       }};
@@ -876,6 +928,8 @@ class GoToHeart : public Behaviour {
 
 class ByVillageControl : public Behaviour {
   public:
+  virtual const char* getName() const override { return "ByVillageControl"; }
+
   ByVillageControl(Creature* c, VillageControl* control, Location* l) : 
       Behaviour(c), villageControl(control) {
     if (l)
@@ -935,24 +989,65 @@ MonsterAI::MonsterAI(Creature* c, const vector<Behaviour*>& beh, const vector<in
     behaviours.push_back(PBehaviour(b));
 }
 
+int MonsterAI::getWakeEvents() {
+  int events = 0;
+  if (!creature->getVisibleEnemies().empty())
+    events |= Behaviour::ENEMY_IN_VIEW;
+  if (!creature->getPickUpOptions().empty())
+    events |= Behaviour::ITEM_APPEARED;
+  if (creature->getHealth() < lastHealth)
+    events |= Behaviour::ATTACKED;
+  lastHealth = creature->getHealth();
+  return events;
+}
+
+vector<pair<string, vector<Item*>>> MonsterAI::getPickUpOptions() {
+  vector<pair<string, vector<Item*>>> ret;
+  for (auto elem : Item::stackItems(creature->getPickUpOptions()))
+    if (!elem.second[0]->getShopkeeper() && creature->canPickUp(elem.second))
+      ret.push_back(elem);
+  return ret;
+}
+
 void MonsterAI::makeMove() {
-  vector<pair<MoveInfo, int>> moves;
+  int events = getWakeEvents();
+  double time = creature->getTime();
+  idleUntil.resize(behaviours.size(), 0);
+  vector<pair<string, vector<Item*>>> pickUpOptions;
+  if (pickItems && (events & Behaviour::ITEM_APPEARED))
+    pickUpOptions = getPickUpOptions();
+  // Behaviours are asked in order, and the rest are skipped once they can't change the result. A move's value
+  // is at most the weight of its behaviour, so a move worth more than the weight of the next one wins.
+  MoveInfo winner {0, nullptr};
   for (int i : All(behaviours)) {
-    MoveInfo move = behaviours[i]->getMove();
-    move.value *= weights[i];
-    moves.emplace_back(move, weights[i]);
-    if (pickItems) {
-      for (auto elem : Item::stackItems(creature->getPickUpOptions())) {
-        Item* item = elem.second[0];
-        if (!item->getShopkeeper() && creature->canPickUp(elem.second)) {
-          MoveInfo pickupMove { behaviours[i]->itemValue(item) * weights[i], [=]() {
-            creature->globalMessage(creature->getTheName() + " picks up " + elem.first, "");
-            creature->pickUp(elem.second);
-          }};
-          moves.emplace_back(pickupMove, weights[i]);
-        }
-      }
+    Behaviour* behaviour = behaviours[i].get();
+    vector<MoveInfo> moves;
+    if (time >= idleUntil[i] || (events & behaviour->getWakeEvents())) {
+      PROFILE_ZONE(behaviour->getName());
+      MoveInfo move = behaviour->getMove();
+      idleUntil[i] = move ? 0 : time + behaviour->getIdleTime();
+      move.value *= weights[i];
+      moves.push_back(move);
+    } else
+      moves.push_back(NoMove);
+    for (auto& elem : pickUpOptions)
+      moves.push_back({ behaviour->itemValue(elem.second[0]) * weights[i], [=]() {
+        creature->globalMessage(creature->getTheName() + " picks up " + elem.first, "");
+        creature->pickUp(elem.second);
+      }});
+    bool done = false;
+    for (int j : All(moves)) {
+      if (moves[j].value > winner.value)
+        winner = moves[j];
+      if (j < moves.size() - 1 && moves[j].value > weights[i])
+        done = true;
+      if (j == moves.size() - 1 && i < behaviours.size() - 1 && moves[j].value > weights[i + 1])
+        done = true;
+      if (done)
+        break;
     }
+    if (done)
+      break;
   }
   /*vector<Item*> inventory = creature->getEquipment().getItems([this](Item* item) { return !creature->getEquipment().isEquiped(item);});
   for (Item* item : inventory) {
@@ -966,14 +1061,6 @@ void MonsterAI::makeMove() {
         creature->drop({item});
       }});
   }*/
-  MoveInfo winner {0, nullptr};
-  for (int i : All(moves)) {
-    MoveInfo& move = moves[i].first;
-    if (move.value > winner.value)
-      winner = move;
-    if (i < moves.size() - 1 && move.value > moves[i + 1].second)
-      break;
-  }
   CHECK(winner.value > 0);
   winner.move();
 }
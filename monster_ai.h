@@ -38,6 +38,19 @@ class Behaviour {
   const Creature* getClosestEnemy();
   MoveInfo tryToApplyItem(EffectType, double maxTurns);
 
+  /** Events that end the idle time of a behaviour early. See getIdleTime().*/
+  enum WakeEvent { ENEMY_IN_VIEW = 1, ITEM_APPEARED = 2, ATTACKED = 4 };
+
+  /** When getMove() finds nothing to do, the behaviour isn't asked again for this many turns, unless one
+    * of the events returned by getWakeEvents() happens. Zero means it's asked on every move.*/
+  virtual double getIdleTime() const { return 0; }
+
+  /** Returns a combination of WakeEvent values.*/
+  virtual int getWakeEvents() const { return 0; }
+
+  /** Returns the name of the behaviour, used as its profiler zone.*/
+  virtual const char* getName() const = 0;
+
   virtual ~Behaviour() {}
 
   SERIALIZATION_DECL(Behaviour);
@@ -58,10 +71,16 @@ class MonsterAI {
   private:
   friend class MonsterAIFactory;
   MonsterAI(Creature*, const vector<Behaviour*>& behaviours, const vector<int>& weights, bool pickItems = true);
+  /** Returns the Behaviour::WakeEvent values that happened since the last move.*/
+  int getWakeEvents();
+  vector<pair<string, vector<Item*>>> getPickUpOptions();
   vector<PBehaviour> SERIAL(behaviours);
   vector<int> SERIAL(weights);
   Creature* SERIAL(creature);
   bool SERIAL(pickItems);
+  /** Time until which each behaviour is idle. Not saved, all behaviours think again after loading.*/
+  vector<double> idleUntil;
+  double lastHealth = 1;
 };
 
 class Collective;
@@ -0,0 +1,100 @@
+#include "stdafx.h"
+
+#include "null_view.h"
+
+void NullView::initialize() {
+}
+
+void NullView::reset() {
+}
+
+void NullView::displaySplash(View::SplashType, const std::atomic<bool>& ready, const std::atomic<double>*) {
+  while (!ready)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+void NullView::close() {
+}
+
+void NullView::addMessage(const string& message) {
+}
+
+void NullView::addImportantMessage(const string& message) {
+}
+
+void NullView::clearMessages() {
+}
+
+void NullView::refreshView(const CreatureView*) {
+}
+
+void NullView::updateView(const CreatureView*) {
+}
+
+void NullView::drawLevelMap(const CreatureView*) {
+}
+
+void NullView::resetCenter() {
+}
+
+Optional<int> NullView::chooseFromList(const string& title, const vector<ListElem>& options, int index,
+    Optional<ActionId> exitAction) {
+  return Nothing();
+}
+
+Optional<Vec2> NullView::chooseDirection(const string& message) {
+  return Nothing();
+}
+
+bool NullView::yesOrNoPrompt(const string& message) {
+  return false;
+}
+
+void NullView::animateObject(vector<Vec2> trajectory, ViewObject object) {
+}
+
+void NullView::animation(Vec2 pos, AnimationId) {
+}
+
+void NullView::presentText(const string& title, const string& text) {
+}
+
+void NullView::presentList(const string& title, const vector<ListElem>& options, bool scrollDown,
+    Optional<ActionId> exitAction) {
+}
+
+Optional<int> NullView::getNumber(const string& title, int min, int max, int increments) {
+  return Nothing();
+}
+
+Action NullView::getAction() {
+  return Action(ActionId::WAIT);
+}
+
+CollectiveAction NullView::getClick(double time) {
+  return CollectiveAction(CollectiveAction::IDLE);
+}
+
+bool NullView::travelInterrupt() {
+  return false;
+}
+
+int NullView::getTimeMilli() {
+  return timeMilli;
+}
+
+void NullView::setTimeMilli(int t) {
+  timeMilli = t;
+}
+
+void NullView::stopClock() {
+  clockStopped = true;
+}
+
+bool NullView::isClockStopped() {
+  return clockStopped;
+}
+
+void NullView::continueClock() {
+  clockStopped = false;
+}
@@ -0,0 +1,50 @@
+#ifndef _NULL_VIEW
+#define _NULL_VIEW
+
+#include "util.h"
+#include "view.h"
+
+/** A View that doesn't display anything and doesn't need a window. The player always waits,
+  * every prompt is cancelled and the keeper gives no orders. Used to run the game headless,
+  * for example for benchmarking. See view.h for documentation of the methods.*/
+class NullView: public View {
+  public:
+  virtual void initialize() override;
+  virtual void reset() override;
+  virtual void displaySplash(View::SplashType, const std::atomic<bool>& ready,
+      const std::atomic<double>* progress) override;
+  virtual void close() override;
+
+  virtual void addMessage(const string& message) override;
+  virtual void addImportantMessage(const string& message) override;
+  virtual void clearMessages() override;
+  virtual void refreshView(const CreatureView*) override;
+  virtual void updateView(const CreatureView*) override;
+  virtual void drawLevelMap(const CreatureView*) override;
+  virtual void resetCenter() override;
+  virtual Optional<int> chooseFromList(const string& title, const vector<ListElem>& options, int index = 0,
+      Optional<ActionId> exitAction = Nothing()) override;
+  virtual Optional<Vec2> chooseDirection(const string& message) override;
+  virtual bool yesOrNoPrompt(const string& message) override;
+  virtual void animateObject(vector<Vec2> trajectory, ViewObject object) override;
+  virtual void animation(Vec2 pos, AnimationId) override;
+  virtual void presentText(const string& title, const string& text) override;
+  virtual void presentList(const string& title, const vector<ListElem>& options, bool scrollDown = false,
+      Optional<ActionId> exitAction = Nothing()) override;
+  virtual Optional<int> getNumber(const string& title, int min, int max, int increments = 1) override;
+
+  virtual Action getAction() override;
+  virtual CollectiveAction getClick(double time) override;
+  virtual bool travelInterrupt() override;
+  virtual int getTimeMilli() override;
+  virtual void setTimeMilli(int) override;
+  virtual void stopClock() override;
+  virtual bool isClockStopped() override;
+  virtual void continueClock() override;
+
+  private:
+  int timeMilli = 0;
+  bool clockStopped = false;
+};
+
+#endif
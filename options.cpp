@@ -6,6 +6,7 @@ string Options::filename;
 const unordered_map<OptionId, int> defaults {
   {OptionId::HINTS, 1},
   {OptionId::ASCII, 0},
+  {OptionId::AUTOSAVE, 1},
   {OptionId::EASY_KEEPER, 1},
   {OptionId::AGGRESSIVE_HEROES, 1},
   {OptionId::EASY_ADVENTURER, 1},
@@ -14,13 +15,14 @@ const unordered_map<OptionId, int> defaults {
 const map<OptionId, string> names {
   {OptionId::HINTS, "In-game hints"},
   {OptionId::ASCII, "Unicode graphics"},
+  {OptionId::AUTOSAVE, "Autosave"},
   {OptionId::EASY_KEEPER, "Game difficulty"},
   {OptionId::AGGRESSIVE_HEROES, "Aggressive enemies"},
   {OptionId::EASY_ADVENTURER, "Game difficulty"},
 };
 
 const map<OptionSet, vector<OptionId>> optionSets {
-  {OptionSet::GENERAL, {OptionId::HINTS, OptionId::ASCII}},
+  {OptionSet::GENERAL, {OptionId::HINTS, OptionId::ASCII, OptionId::AUTOSAVE}},
   {OptionSet::KEEPER, {OptionId::EASY_KEEPER, OptionId::AGGRESSIVE_HEROES}},
   {OptionSet::ADVENTURER, {OptionId::EASY_ADVENTURER}},
 };
@@ -46,6 +48,7 @@ void Options::setValue(OptionId id, int value) {
 unordered_map<OptionId, vector<string>> valueNames {
   {OptionId::HINTS, { "off", "on" }},
   {OptionId::ASCII, { "off", "on" }},
+  {OptionId::AUTOSAVE, { "off", "on" }},
   {OptionId::EASY_KEEPER, { "hard", "easy" }},
   {OptionId::AGGRESSIVE_HEROES, { "no", "yes" }},
   {OptionId::EASY_ADVENTURER, { "hard", "easy" }},
@@ -12,6 +12,9 @@ enum class OptionId {
   AGGRESSIVE_HEROES,
 
   EASY_ADVENTURER,
+
+  // The options file stores the numbers, so new options go at the end.
+  AUTOSAVE,
 };
 
 enum class OptionSet {
@@ -0,0 +1,53 @@
+#include "stdafx.h"
+
+#include "path_engine.h"
+
+const double PathEngine::infinity = 1000000000;
+
+PathEngine& PathEngine::get() {
+  static thread_local unique_ptr<PathEngine> engine;
+  if (!engine)
+    engine.reset(new PathEngine());
+  return *engine;
+}
+
+PathEngine::PathEngine() : distance(maxSize * maxSize), dirty(maxSize * maxSize, 0) {
+}
+
+void PathEngine::clear() {
+  queue.clear();
+  numPopped = 0;
+  ++counter;
+}
+
+int PathEngine::getNumPopped() const {
+  return numPopped;
+}
+
+vector<Vec2> PathEngine::constructPath(const Rectangle& bounds, const vector<Vec2>& directions, Vec2 pos,
+    Vec2 target, bool reversed) const {
+  vector<Vec2> ret;
+  while (pos != target) {
+    Vec2 next;
+    double lowest = getDistance(pos);
+    CHECK(lowest < infinity);
+    for (Vec2 dir : directions) {
+      double dist;
+      if ((pos + dir).inRectangle(bounds) && (dist = getDistance(pos + dir)) < lowest) {
+        lowest = dist;
+        next = pos + dir;
+      }
+    }
+    if (lowest >= getDistance(pos)) {
+      if (reversed)
+        break;
+      else
+        FAIL << "can't track path";
+    }
+    ret.push_back(pos);
+    pos = next;
+  }
+  if (!reversed)
+    ret.push_back(target);
+  return vector<Vec2>(ret.rbegin(), ret.rend());
+}
@@ -0,0 +1,164 @@
+#ifndef _PATH_ENGINE_H
+#define _PATH_ENGINE_H
+
+#include "util.h"
+
+/** Scratch memory and search loops used by ShortestPath. Every thread has its own engine, so paths
+  * can be computed concurrently. The cost functions are template parameters, so that they are
+  * inlined in the search loop.*/
+class PathEngine {
+  public:
+  /** Returns the engine of the calling thread.*/
+  static PathEngine& get();
+
+  static const int maxSize = 600;
+  static const double infinity;
+
+  /** Searches from \paramname{target} outwards until \paramname{from} is popped, or a square
+    * with distance at least \paramname{limit}. Returns the square where the search stopped.*/
+  template <class EntryFun, class LengthFun>
+  Optional<Vec2> search(const Rectangle& bounds, const vector<Vec2>& directions, EntryFun entryFun,
+      LengthFun lengthFun, Vec2 target, Optional<Vec2> from, Optional<int> limit = Nothing());
+
+  /** Multiplies all distances up to \paramname{limit} from the last search by \paramname{mult}
+    * and searches again towards \paramname{from}. Used for moving away from the target.*/
+  template <class EntryFun, class LengthFun>
+  Optional<Vec2> reverse(const Rectangle& bounds, const vector<Vec2>& directions, EntryFun entryFun,
+      LengthFun lengthFun, double mult, Vec2 from, int limit);
+
+  /** Follows the decreasing distances from the last search from \paramname{start} to \paramname{target}.*/
+  vector<Vec2> constructPath(const Rectangle& bounds, const vector<Vec2>& directions, Vec2 start, Vec2 target,
+      bool reversed) const;
+
+  double getDistance(Vec2 pos) const;
+  void setDistance(Vec2 pos, double);
+
+  /** Returns the number of squares popped by the last search.*/
+  int getNumPopped() const;
+
+  private:
+  PathEngine();
+
+  struct QElem {
+    double priority;
+    double distance;
+    Vec2 pos;
+    bool operator < (const QElem& other) const {
+      return priority > other.priority;
+    }
+  };
+
+  void clear();
+  void push(Vec2 pos, double distance, double priority);
+  QElem pop();
+  int getIndex(Vec2 pos) const;
+
+  vector<QElem> queue;
+  vector<double> distance;
+  vector<int> dirty;
+  int counter = 0;
+  int numPopped = 0;
+};
+
+inline int PathEngine::getIndex(Vec2 pos) const {
+  return pos.x * maxSize + pos.y;
+}
+
+inline double PathEngine::getDistance(Vec2 pos) const {
+  int index = getIndex(pos);
+  return dirty[index] < counter ? infinity : distance[index];
+}
+
+inline void PathEngine::setDistance(Vec2 pos, double d) {
+  int index = getIndex(pos);
+  distance[index] = d;
+  dirty[index] = counter;
+}
+
+inline void PathEngine::push(Vec2 pos, double distance, double priority) {
+  queue.push_back({priority, distance, pos});
+  push_heap(queue.begin(), queue.end());
+}
+
+inline PathEngine::QElem PathEngine::pop() {
+  pop_heap(queue.begin(), queue.end());
+  QElem ret = queue.back();
+  queue.pop_back();
+  return ret;
+}
+
+template <class EntryFun, class LengthFun>
+Optional<Vec2> PathEngine::search(const Rectangle& bounds, const vector<Vec2>& directions, EntryFun entryFun,
+    LengthFun lengthFun, Vec2 target, Optional<Vec2> from, Optional<int> limit) {
+  CHECK(bounds.getPX() >= 0 && bounds.getPY() >= 0 && bounds.getKX() <= maxSize && bounds.getKY() <= maxSize);
+  clear();
+  auto priority = [&](Vec2 pos, double dist) { return from ? dist + lengthFun(*from - pos) : dist; };
+  setDistance(target, 0);
+  push(target, 0, priority(target, 0));
+  while (!queue.empty()) {
+    QElem elem = pop();
+    Vec2 pos = elem.pos;
+    double cdist = getDistance(pos);
+    if (elem.distance > cdist)
+      // This square was pushed again with a smaller distance.
+      continue;
+    ++numPopped;
+    if (from == pos || (limit && cdist >= *limit))
+      return pos;
+    for (Vec2 dir : directions) {
+      Vec2 next = pos + dir;
+      if (next.inRectangle(bounds)) {
+        double ndist = getDistance(next);
+        if (cdist < ndist) {
+          double dist = cdist + entryFun(next);
+          CHECK(dist > cdist) << "Entry fun non positive " << dist - cdist;
+          if (dist < ndist) {
+            setDistance(next, dist);
+            push(next, dist, priority(next, dist));
+          }
+        }
+      }
+    }
+  }
+  return Nothing();
+}
+
+template <class EntryFun, class LengthFun>
+Optional<Vec2> PathEngine::reverse(const Rectangle& bounds, const vector<Vec2>& directions, EntryFun entryFun,
+    LengthFun lengthFun, double mult, Vec2 from, int limit) {
+  queue.clear();
+  numPopped = 0;
+  for (Vec2 v : bounds) {
+    double dist = getDistance(v);
+    if (dist <= limit) {
+      setDistance(v, mult * dist);
+      push(v, mult * dist, mult * dist + lengthFun(from - v));
+    }
+  }
+  while (!queue.empty()) {
+    QElem elem = pop();
+    Vec2 pos = elem.pos;
+    double cdist = getDistance(pos);
+    if (elem.distance > cdist)
+      continue;
+    ++numPopped;
+    if (from == pos)
+      return pos;
+    for (Vec2 dir : directions) {
+      Vec2 next = pos + dir;
+      if (next.inRectangle(bounds)) {
+        double ndist = getDistance(next);
+        if (ndist < 0) {
+          double dist = cdist + entryFun(next);
+          if (ndist > dist) {
+            setDistance(next, dist);
+            push(next, dist, dist + lengthFun(from - next));
+          }
+        }
+      }
+    }
+  }
+  return Nothing();
+}
+
+#endif
@@ -8,6 +8,7 @@
 #include "name_generator.h"
 #include "model.h"
 #include "options.h"
+#include "profiler.h"
 
 template <class Archive> 
 void Player::serialize(Archive& ar, const unsigned int version) {
@@ -568,9 +569,10 @@ void Player::sleeping() {
     ViewObject::setHallu(true);
   else
     ViewObject::setHallu(false);
-  MEASURE(
-      model->getView()->refreshView(creature),
-      "level render time");
+  {
+    PROFILE_ZONE("refresh view");
+    model->getView()->refreshView(creature);
+  }
 }
 
 void Player::makeMove() {
@@ -580,9 +582,10 @@ void Player::makeMove() {
     ViewObject::setHallu(true);
   else
     ViewObject::setHallu(false);
-  MEASURE(
-      model->getView()->refreshView(creature),
-      "level render time");
+  {
+    PROFILE_ZONE("refresh view");
+    model->getView()->refreshView(creature);
+  }
   if (Options::getValue(OptionId::HINTS) && displayTravelInfo && creature->getConstSquare()->getName() == "road") {
     model->getView()->presentText("", "Use ctrl + arrows to travel quickly on roads and corridors.");
     displayTravelInfo = false;
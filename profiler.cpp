@@ -0,0 +1,277 @@
+#include "stdafx.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#ifndef WINDOWS
+#include <pthread.h>
+#endif
+
+#include "profiler.h"
+
+// Zone times are kept in a histogram with 8 buckets for every power of two nanoseconds.
+static const int numBuckets = 62 * 8;
+
+static int getBucket(long long nanos) {
+  if (nanos < 8)
+    return max(0LL, nanos);
+  int bit = 63 - __builtin_clzll(nanos);
+  return (bit - 2) * 8 + ((nanos >> (bit - 3)) & 7);
+}
+
+static long long getBucketStart(int bucket) {
+  if (bucket < 8)
+    return bucket;
+  return (8LL + bucket % 8) << (bucket / 8 - 1);
+}
+
+static long long getNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct ProfilerNode {
+  const char* name;
+  int parent;
+  vector<int> children;
+  long long count = 0;
+  long long total = 0;
+  long long min = std::numeric_limits<long long>::max();
+  long long max = 0;
+  vector<int> histogram = vector<int>(numBuckets, 0);
+};
+
+struct ProfilerEvent {
+  int node;
+  long long start;
+  long long duration;
+};
+
+struct ProfilerThread {
+  int id;
+  vector<ProfilerNode> nodes;
+  // The open zones, with the time they were entered.
+  vector<pair<int, long long>> stack;
+  vector<ProfilerEvent> events;
+};
+
+static std::mutex threadsMutex;
+#ifndef WINDOWS
+// Held across fork(), so that the child process can still profile.
+static int threadsMutexAtFork = pthread_atfork([] { threadsMutex.lock(); },
+    [] { threadsMutex.unlock(); }, [] { threadsMutex.unlock(); });
+#endif
+static vector<unique_ptr<ProfilerThread>> threads;
+static std::atomic<bool> tracing(false);
+static std::atomic<int> numTraceEvents(0);
+static const long long startTime = getNanos();
+static thread_local ProfilerThread* currentThread = nullptr;
+
+static ProfilerThread* getThread() {
+  if (!currentThread) {
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    threads.emplace_back(new ProfilerThread());
+    currentThread = threads.back().get();
+    currentThread->id = threads.size();
+    currentThread->nodes.emplace_back();
+    currentThread->nodes[0].name = "";
+    currentThread->nodes[0].parent = -1;
+  }
+  return currentThread;
+}
+
+Profiler::Zone::Zone(const char* name) {
+  ProfilerThread* thread = getThread();
+  int parent = thread->stack.empty() ? 0 : thread->stack.back().first;
+  int node = -1;
+  for (int child : thread->nodes[parent].children)
+    if (thread->nodes[child].name == name) {
+      node = child;
+      break;
+    }
+  if (node == -1) {
+    node = thread->nodes.size();
+    thread->nodes.emplace_back();
+    thread->nodes[node].name = name;
+    thread->nodes[node].parent = parent;
+    thread->nodes[parent].children.push_back(node);
+  }
+  thread->stack.push_back({node, getNanos()});
+}
+
+Profiler::Zone::~Zone() {
+  ProfilerThread* thread = currentThread;
+  long long end = getNanos();
+  int node = thread->stack.back().first;
+  long long start = thread->stack.back().second;
+  thread->stack.pop_back();
+  long long duration = end - start;
+  ProfilerNode& n = thread->nodes[node];
+  ++n.count;
+  n.total += duration;
+  n.min = min(n.min, duration);
+  n.max = max(n.max, duration);
+  ++n.histogram[getBucket(duration)];
+  if (tracing && numTraceEvents++ < maxTraceEvents)
+    thread->events.push_back({node, start, duration});
+}
+
+static string getPath(const ProfilerThread& thread, int node) {
+  string ret = thread.nodes[node].name;
+  for (int n = thread.nodes[node].parent; n > 0; n = thread.nodes[n].parent)
+    ret = string(thread.nodes[n].name) + "/" + ret;
+  return ret;
+}
+
+static double getPercentile(const vector<int>& histogram, long long count, double percentile,
+    long long minTime, long long maxTime) {
+  long long sum = 0;
+  for (int i : All(histogram)) {
+    sum += histogram[i];
+    if (sum >= percentile * count)
+      return min(maxTime, max(minTime, getBucketStart(i))) / 1000000.0;
+  }
+  return maxTime / 1000000.0;
+}
+
+vector<Profiler::ZoneStats> Profiler::getStats() {
+  std::lock_guard<std::mutex> lock(threadsMutex);
+  vector<ProfilerNode> merged;
+  vector<pair<string, int>> order;
+  unordered_map<string, int> index;
+  for (auto& thread : threads) {
+    // Visits the zones depth first, so that a new zone lands after the ones enclosing it.
+    vector<int> toVisit(thread->nodes[0].children.rbegin(), thread->nodes[0].children.rend());
+    while (!toVisit.empty()) {
+      int node = toVisit.back();
+      toVisit.pop_back();
+      const ProfilerNode& n = thread->nodes[node];
+      for (int i = n.children.size() - 1; i >= 0; --i)
+        toVisit.push_back(n.children[i]);
+      string path = getPath(*thread, node);
+      if (!index.count(path)) {
+        int parentPos = -1;
+        if (n.parent > 0)
+          parentPos = index.at(getPath(*thread, n.parent));
+        // Place it after the last zone nested inside its parent.
+        int pos = order.size();
+        if (parentPos > -1) {
+          string prefix = order[parentPos].first + "/";
+          for (pos = parentPos + 1; pos < order.size() && order[pos].first.compare(0, prefix.size(), prefix) == 0;)
+            ++pos;
+        }
+        order.insert(order.begin() + pos, {path, merged.size()});
+        for (int i : All(order))
+          index[order[i].first] = i;
+        merged.emplace_back();
+        merged.back().name = n.name;
+      }
+      ProfilerNode& m = merged[order[index.at(path)].second];
+      m.count += n.count;
+      m.total += n.total;
+      m.min = min(m.min, n.min);
+      m.max = max(m.max, n.max);
+      for (int i : All(n.histogram))
+        m.histogram[i] += n.histogram[i];
+    }
+  }
+  vector<ZoneStats> ret;
+  for (auto& elem : order) {
+    const ProfilerNode& m = merged[elem.second];
+    if (m.count == 0)
+      continue;
+    ret.push_back({elem.first, m.name, int(std::count(elem.first.begin(), elem.first.end(), '/')), m.count,
+        m.total / 1000000.0, m.min / 1000000.0, m.max / 1000000.0,
+        getPercentile(m.histogram, m.count, 0.5, m.min, m.max),
+        getPercentile(m.histogram, m.count, 0.9, m.min, m.max),
+        getPercentile(m.histogram, m.count, 0.99, m.min, m.max)});
+  }
+  return ret;
+}
+
+vector<string> Profiler::getSummary(int maxLines) {
+  vector<ZoneStats> stats = getStats();
+  sort(stats.begin(), stats.end(), [](const ZoneStats& a, const ZoneStats& b) { return a.total > b.total; });
+  vector<string> ret;
+  for (int i : Range(min<int>(maxLines, stats.size()))) {
+    char buf[200];
+    snprintf(buf, sizeof(buf), "%s %.0f ms, %lld x %.3f ms", stats[i].name.c_str(), stats[i].total,
+        stats[i].count, stats[i].total / stats[i].count);
+    ret.push_back(buf);
+  }
+  return ret;
+}
+
+void Profiler::dumpText(std::ostream& out) {
+  char buf[300];
+  snprintf(buf, sizeof(buf), "%-40s %10s %12s %10s %10s %10s %10s %10s %10s", "zone", "count", "total ms",
+      "mean ms", "min ms", "median ms", "p90 ms", "p99 ms", "max ms");
+  out << buf << endl;
+  for (const ZoneStats& s : getStats()) {
+    string name = string(2 * s.depth, ' ') + s.name;
+    snprintf(buf, sizeof(buf), "%-40s %10lld %12.3f %10.4f %10.4f %10.4f %10.4f %10.4f %10.4f", name.c_str(),
+        s.count, s.total, s.total / s.count, s.min, s.median, s.p90, s.p99, s.max);
+    out << buf << endl;
+  }
+}
+
+static string escapeJson(const string& s) {
+  string ret;
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      ret += '\\';
+    ret += c;
+  }
+  return ret;
+}
+
+void Profiler::dumpJson(std::ostream& out) {
+  out << "{\"zones\": [";
+  bool first = true;
+  for (const ZoneStats& s : getStats()) {
+    out << (first ? "" : ",") << "\n  {\"path\": \"" << escapeJson(s.path) << "\", \"count\": " << s.count
+        << ", \"total\": " << s.total << ", \"min\": " << s.min << ", \"max\": " << s.max
+        << ", \"median\": " << s.median << ", \"p90\": " << s.p90 << ", \"p99\": " << s.p99 << "}";
+    first = false;
+  }
+  out << "\n]}" << endl;
+}
+
+void Profiler::dumpChromeTrace(std::ostream& out) {
+  std::lock_guard<std::mutex> lock(threadsMutex);
+  out << "{\"traceEvents\": [";
+  bool first = true;
+  for (auto& thread : threads)
+    for (const ProfilerEvent& e : thread->events) {
+      // Timestamps are in microseconds.
+      out << (first ? "" : ",") << "\n  {\"name\": \"" << escapeJson(thread->nodes[e.node].name)
+          << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread->id << ", \"ts\": " << (e.start - startTime) / 1000
+          << ", \"dur\": " << e.duration / 1000.0 << "}";
+      first = false;
+    }
+  out << "\n]}" << endl;
+}
+
+void Profiler::setTracing(bool on) {
+  if (on && !tracing) {
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    for (auto& thread : threads)
+      thread->events.clear();
+    numTraceEvents = 0;
+  }
+  tracing = on;
+}
+
+bool Profiler::isTracing() {
+  return tracing;
+}
+
+void Profiler::reset() {
+  std::lock_guard<std::mutex> lock(threadsMutex);
+  for (auto& thread : threads) {
+    thread->nodes.resize(1);
+    thread->nodes[0].children.clear();
+    thread->events.clear();
+  }
+  numTraceEvents = 0;
+}
@@ -0,0 +1,65 @@
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include "util.h"
+
+/** Measures the real time spent in named zones of code. Zones nest, and a zone is reported separately
+  * for every path of enclosing zones that it was entered from. Each thread records into its own buffer,
+  * and the buffers are merged when the results are read, which should happen when no other thread is
+  * inside a zone. In RELEASE builds the zones compile to nothing.*/
+class Profiler {
+  public:
+  /** Times the enclosing scope. Use through the PROFILE_ZONE macro.*/
+  class Zone {
+    public:
+    /** \paramname{name} must stay valid until the end of the program, usually it's a string literal.*/
+    Zone(const char* name);
+    ~Zone();
+  };
+
+  /** Results of one zone, merged from all threads. Times are in milliseconds, and the percentiles
+    * are approximate, within about 12%.*/
+  struct ZoneStats {
+    string path;
+    string name;
+    int depth;
+    long long count;
+    double total;
+    double min;
+    double max;
+    double median;
+    double p90;
+    double p99;
+  };
+
+  /** Returns the results of all zones, each one followed by the zones nested inside it.*/
+  static vector<ZoneStats> getStats();
+
+  /** Returns lines describing the \paramname{maxLines} zones with the highest total time.*/
+  static vector<string> getSummary(int maxLines);
+
+  static void dumpText(std::ostream&);
+  static void dumpJson(std::ostream&);
+
+  /** Writes the zones entered while tracing was on in the Chrome trace event format (chrome://tracing).*/
+  static void dumpChromeTrace(std::ostream&);
+
+  /** Starts or stops recording every zone entry for dumpChromeTrace. Starting clears the previous trace.*/
+  static void setTracing(bool);
+  static bool isTracing();
+
+  /** Clears all results. No zone can be open in any thread.*/
+  static void reset();
+
+  static const int maxTraceEvents = 1000000;
+};
+
+#ifdef RELEASE
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_ZONE_VAR2(line) profilerZone##line
+#define PROFILE_ZONE_VAR(line) PROFILE_ZONE_VAR2(line)
+#define PROFILE_ZONE(name) Profiler::Zone PROFILE_ZONE_VAR(__LINE__)(name)
+#endif
+
+#endif
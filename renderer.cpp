@@ -73,6 +73,7 @@ void Renderer::drawText(FontId id, int size, Color color, int x, int y, String s
   t.setPosition(x + ox, y + oy);
   t.setColor(color);
   display->draw(t);
+  ++numDrawCalls;
 }
 
 void Renderer::drawText(Color color, int x, int y, string s, bool center, int size) {
@@ -108,6 +109,7 @@ void Renderer::drawImage(int px, int py, int kx, int ky, const Image& image, dou
   if (scale != 1)
     s.setScale(scale, scale);
   display->draw(s);
+  ++numDrawCalls;
 }
 
 void Renderer::drawSprite(int x, int y, int px, int py, int w, int h, const Texture& t, int dw, int dh,
@@ -119,6 +121,7 @@ void Renderer::drawSprite(int x, int y, int px, int py, int w, int h, const Text
   if (dw != -1)
     s.setScale(double(dw) / w, double(dh) / h);
   display->draw(s);
+  ++numDrawCalls;
 }
 
 void Renderer::drawFilledRectangle(const Rectangle& t, Color color, Optional<Color> outline) {
@@ -130,15 +133,157 @@ void Renderer::drawFilledRectangle(const Rectangle& t, Color color, Optional<Col
     r.setOutlineColor(*outline);
   }
   display->draw(r);
+  ++numDrawCalls;
 }
 
 void Renderer::drawFilledRectangle(int px, int py, int kx, int ky, Color color, Optional<Color> outline) {
   drawFilledRectangle(Rectangle(px, py, kx, ky), color, outline);
 }
 
+void Renderer::drawList(const DrawList& list) {
+  for (int i : Range(list.numSteps)) {
+    const DrawList::Step& step = list.steps[i];
+    if (step.overlay)
+      step.overlay(*this);
+    else if (step.quads.getVertexCount() > 0) {
+      sf::RenderStates states;
+      if (step.texNum >= 0)
+        states.texture = &tiles[step.texNum];
+      display->draw(step.quads, states);
+      ++numDrawCalls;
+    }
+  }
+}
+
 void Renderer::drawAndClearBuffer() {
   display->display();
   display->clear(Color(0, 0, 0));
+  lastNumDrawCalls = numDrawCalls;
+  numDrawCalls = 0;
+}
+
+int Renderer::getNumDrawCalls() {
+  return lastNumDrawCalls;
+}
+
+static int divDown(int a, int b) {
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+void DrawList::setGrid(Rectangle area, Vec2 origin, int width, int height) {
+  CHECK(width > 0 && height > 0);
+  gridOrigin = origin;
+  cellWidth = width;
+  cellHeight = height;
+  Vec2 p = area.getTopLeft() - origin;
+  Vec2 k = area.getBottomRight() - origin - Vec2(1, 1);
+  Rectangle cells(divDown(p.x, width), divDown(p.y, height),
+      max(divDown(p.x, width), divDown(k.x, width)) + 1, max(divDown(p.y, height), divDown(k.y, height)) + 1);
+  if (!(cells == lastStepByCell.getBounds()))
+    lastStepByCell = Table<int>(cells, -1);
+}
+
+static int clampTo(int a, int low, int high) {
+  return max(low, min(high, a));
+}
+
+// Cells outside of the table are checked as the nearest cell inside, which can only find more overlaps.
+Rectangle DrawList::getCells(Rectangle bounds) const {
+  Vec2 p = bounds.getTopLeft() - gridOrigin;
+  Vec2 k = bounds.getBottomRight() - gridOrigin - Vec2(1, 1);
+  const Rectangle& table = lastStepByCell.getBounds();
+  return Rectangle(
+      clampTo(divDown(p.x, cellWidth), table.getPX(), table.getKX() - 1),
+      clampTo(divDown(p.y, cellHeight), table.getPY(), table.getKY() - 1),
+      clampTo(divDown(k.x, cellWidth), table.getPX(), table.getKX() - 1) + 1,
+      clampTo(divDown(k.y, cellHeight), table.getPY(), table.getKY() - 1) + 1);
+}
+
+int DrawList::addStep(Rectangle bounds, int texNum) {
+  Rectangle cells = getCells(bounds);
+  int index = numSteps;
+  int texIndex = texNum - untextured;
+  if (texNum != overlayStep && texIndex >= lastStepByTexture.size())
+    lastStepByTexture.resize(texIndex + 1, -1);
+  if (texNum != overlayStep && lastStepByTexture[texIndex] > -1) {
+    // Joining an earlier step draws the quad before everything that was added since, which can't be seen
+    // unless some of it overlaps the quad.
+    int last = lastStepByTexture[texIndex];
+    bool overlaps = false;
+    for (int x = cells.getPX(); x < cells.getKX() && !overlaps; ++x)
+      for (int y = cells.getPY(); y < cells.getKY(); ++y)
+        if (lastStepByCell[x][y] > last) {
+          overlaps = true;
+          break;
+        }
+    if (!overlaps)
+      index = last;
+  }
+  if (index == numSteps) {
+    if (steps.size() == numSteps)
+      steps.emplace_back();
+    steps[index].texNum = texNum;
+    steps[index].quads.clear();
+    steps[index].quads.setPrimitiveType(sf::Quads);
+    steps[index].overlay = nullptr;
+    steps[index].numDrawCalls = 0;
+    ++numSteps;
+    if (texNum != overlayStep)
+      lastStepByTexture[texIndex] = index;
+  }
+  for (int x = cells.getPX(); x < cells.getKX(); ++x)
+    for (int y = cells.getPY(); y < cells.getKY(); ++y)
+      lastStepByCell[x][y] = index;
+  return index;
+}
+
+void DrawList::addQuad(int texNum, int x, int y, int w, int h, int px, int py, int pw, int ph, Color color) {
+  if (w <= 0 || h <= 0)
+    return;
+  sf::VertexArray& array = steps[addStep(Rectangle(x, y, x + w, y + h), texNum)].quads;
+  array.append(sf::Vertex(Vector2f(x, y), color, Vector2f(px, py)));
+  array.append(sf::Vertex(Vector2f(x + w, y), color, Vector2f(px + pw, py)));
+  array.append(sf::Vertex(Vector2f(x + w, y + h), color, Vector2f(px + pw, py + ph)));
+  array.append(sf::Vertex(Vector2f(x, y + h), color, Vector2f(px, py + ph)));
+  ++numQuads;
+}
+
+void DrawList::addSprite(int x, int y, int px, int py, int w, int h, int texNum, int dw, int dh, Color color) {
+  // Same as Renderer::drawSprite: the texture rectangle is scaled to dw x dh, if given.
+  addQuad(texNum, x, y, dw == -1 ? w : dw, dh == -1 ? h : dh, px, py, w, h, color);
+}
+
+void DrawList::addFilledRectangle(int px, int py, int kx, int ky, Color color) {
+  addQuad(untextured, px, py, kx - px, ky - py, 0, 0, 0, 0, color);
+}
+
+void DrawList::addOverlay(Rectangle bounds, int numDrawCalls, function<void(Renderer&)> overlay) {
+  // Overlays are never joined.
+  Step& step = steps[addStep(bounds, overlayStep)];
+  step.overlay = overlay;
+  step.numDrawCalls = numDrawCalls;
+}
+
+void DrawList::clear() {
+  numSteps = 0;
+  lastStepByTexture.assign(lastStepByTexture.size(), -1);
+  for (Vec2 v : lastStepByCell.getBounds())
+    lastStepByCell[v] = -1;
+  numQuads = 0;
+}
+
+int DrawList::getNumQuads() const {
+  return numQuads;
+}
+
+int DrawList::getNumDrawCalls() const {
+  int ret = 0;
+  for (int i : Range(numSteps))
+    if (steps[i].overlay)
+      ret += steps[i].numDrawCalls;
+    else if (steps[i].quads.getVertexCount() > 0)
+      ++ret;
+  return ret;
 }
 
 void Renderer::resize(int width, int height) {
@@ -47,6 +47,64 @@ namespace colors {
   Color transparency(const Color& color, int trans);
 }
 
+class Renderer;
+
+/** Sprites, filled rectangles and other drawing of one frame, collected before they are drawn. Quads with
+  * the same texture are kept in one vertex array, so they take a few draw calls instead of one each. A quad
+  * only joins an earlier array if nothing added after that array overlaps it, so the frame looks the same
+  * as when everything is drawn in the order it was added. Overlaps are checked on a grid of cells, which
+  * should match the tiles. Building the list doesn't need a window.*/
+class DrawList {
+  public:
+  /** Sets the grid used to check overlaps, with a cell corner at \paramname{origin}. Drawing outside of
+    * \paramname{area} is checked less precisely.*/
+  void setGrid(Rectangle area, Vec2 origin, int cellWidth, int cellHeight);
+  void addSprite(int x, int y, int px, int py, int w, int h, int texNum, int dw, int dh,
+      Color color = Color::White);
+  void addFilledRectangle(int px, int py, int kx, int ky, Color color);
+
+  /** Adds drawing that isn't batched. It must stay within \paramname{bounds} and make
+    * \paramname{numDrawCalls} calls.*/
+  void addOverlay(Rectangle bounds, int numDrawCalls, function<void(Renderer&)>);
+  void clear();
+
+  /** Returns the number of quads, which is how many calls drawing them one by one would take.*/
+  int getNumQuads() const;
+
+  /** Returns the number of calls that Renderer::drawList makes for this list.*/
+  int getNumDrawCalls() const;
+
+  private:
+  friend class Renderer;
+  void addQuad(int texNum, int x, int y, int w, int h, int px, int py, int pw, int ph, Color);
+  int addStep(Rectangle bounds, int texNum);
+  Rectangle getCells(Rectangle bounds) const;
+
+  /** Texture numbers of steps with untextured quads and of overlays.*/
+  static const int untextured = -1;
+  static const int overlayStep = -2;
+
+  /** A vertex array of quads with one texture, or an overlay.*/
+  struct Step {
+    int texNum;
+    sf::VertexArray quads;
+    function<void(Renderer&)> overlay;
+    int numDrawCalls;
+  };
+
+  /** Steps in drawing order. The first numSteps are used, the rest are kept so that their memory is reused.*/
+  vector<Step> steps;
+  int numSteps = 0;
+  /** Last step with quads of each texture, indexed by texture number minus untextured, or -1.*/
+  vector<int> lastStepByTexture;
+  /** Last step that draws anything on each cell of the grid, or -1.*/
+  Table<int> lastStepByCell = Table<int>(1, 1, -1);
+  Vec2 gridOrigin;
+  int cellWidth = 36;
+  int cellHeight = 36;
+  int numQuads = 0;
+};
+
 class Renderer {
   public: 
   const static int textSize = 19;
@@ -63,7 +121,11 @@ class Renderer {
       Optional<Color> color = Nothing());
   void drawFilledRectangle(const Rectangle& t, Color color, Optional<Color> outline = Nothing());
   void drawFilledRectangle(int px, int py, int kx, int ky, Color color, Optional<Color> outline = Nothing());
+  void drawList(const DrawList&);
   void drawAndClearBuffer();
+
+  /** Returns the number of draw calls made in the last complete frame.*/
+  int getNumDrawCalls();
   void resize(int width, int height);
   int getWidth();
   int getHeight();
@@ -86,6 +148,8 @@ class Renderer {
   stack<Vec2> translations;
   Vec2 translation;
   bool monkey = false;
+  int numDrawCalls = 0;
+  int lastNumDrawCalls = 0;
 };
 
 #endif
@@ -0,0 +1,111 @@
+#include "stdafx.h"
+
+#include "save_file.h"
+#include "model.h"
+#include "gzstream.h"
+
+template <class Archive>
+void SaveFileHeader::serialize(Archive& ar, const unsigned int) {
+  ar & BOOST_SERIALIZATION_NVP(version)
+    & BOOST_SERIALIZATION_NVP(type)
+    & BOOST_SERIALIZATION_NVP(name)
+    & BOOST_SERIALIZATION_NVP(turn)
+    & BOOST_SERIALIZATION_NVP(numSections);
+}
+
+SERIALIZABLE(SaveFileHeader);
+
+// Written before the header, so that other files, and saves from before there was a header, are skipped.
+static const string magic = "KeeperRL save";
+
+// Saving with the fastest level makes the files about a quarter bigger than with the default one.
+static const int compressionLevel = Z_BEST_SPEED;
+
+static SaveFileHeader makeHeader(Model* model, GameType type) {
+  return {SaveFile::version, type, model->getGameIdentifier(), model->getTurn(), model->getNumSaveSections()};
+}
+
+static void writeHeader(const SaveFileHeader& header, const string& path) {
+  ofstream out(path, std::ios::binary);
+  CHECK(out.good()) << "Couldn't write " << path;
+  out.write(magic.c_str(), magic.size());
+  boost::archive::binary_oarchive ar(out);
+  ar << BOOST_SERIALIZATION_NVP(header);
+}
+
+static void writeModel(Model* model, int numSections, std::ostream& out, function<void(double)> progress) {
+  boost::archive::binary_oarchive ar(out);
+  Serialization::registerTypes(ar);
+  const Model* const ptr = model;
+  ar << BOOST_SERIALIZATION_NVP(ptr);
+  for (int i : Range(numSections)) {
+    model->serializeSection(ar, i);
+    if (progress)
+      progress(double(i + 1) / numSections);
+  }
+}
+
+void SaveFile::save(Model* model, GameType type, const string& path, function<void(double)> progress) {
+  SaveFileHeader header = makeHeader(model, type);
+  writeHeader(header, path);
+  ogzstream out(path.c_str(), std::ios::out | std::ios::app, compressionLevel);
+  CHECK(out.good()) << "Couldn't write " << path;
+  writeModel(model, header.numSections, out, progress);
+}
+
+SaveFile::Snapshot SaveFile::snapshot(Model* model, GameType type) {
+  SaveFileHeader header = makeHeader(model, type);
+  std::ostringstream out;
+  writeModel(model, header.numSections, out, nullptr);
+  return {header, out.str()};
+}
+
+void SaveFile::write(const Snapshot& snapshot, const string& path) {
+  writeHeader(snapshot.header, path);
+  ogzstream out(path.c_str(), std::ios::out | std::ios::app, compressionLevel);
+  CHECK(out.good()) << "Couldn't write " << path;
+  out.write(snapshot.body.data(), snapshot.body.size());
+}
+
+unique_ptr<Model> SaveFile::load(const string& path, function<void(double)> progress) {
+  long bodyOffset;
+  Optional<SaveFileHeader> header = readHeader(path, bodyOffset);
+  CHECK(header) << "Not a save file of this version of the game: " << path;
+  igzstream in(path.c_str(), std::ios::in, bodyOffset);
+  CHECK(in.good()) << "Couldn't read " << path;
+  boost::archive::binary_iarchive ar(in);
+  Serialization::registerTypes(ar);
+  Model* ptr;
+  ar >> BOOST_SERIALIZATION_NVP(ptr);
+  unique_ptr<Model> model(ptr);
+  CHECK(model->getNumSaveSections() == header->numSections) << "Corrupted save file " << path;
+  for (int i : Range(header->numSections)) {
+    model->serializeSection(ar, i);
+    if (progress)
+      progress(double(i + 1) / header->numSections);
+  }
+  return model;
+}
+
+Optional<SaveFileHeader> SaveFile::readHeader(const string& path) {
+  long bodyOffset;
+  return readHeader(path, bodyOffset);
+}
+
+Optional<SaveFileHeader> SaveFile::readHeader(const string& path, long& bodyOffset) {
+  ifstream in(path, std::ios::binary);
+  string fileMagic(magic.size(), ' ');
+  if (!in.read(&fileMagic[0], magic.size()) || fileMagic != magic)
+    return Nothing();
+  SaveFileHeader header;
+  try {
+    boost::archive::binary_iarchive ar(in);
+    ar >> BOOST_SERIALIZATION_NVP(header);
+  } catch (boost::archive::archive_exception&) {
+    return Nothing();
+  }
+  if (header.version != version)
+    return Nothing();
+  bodyOffset = in.tellg();
+  return header;
+}
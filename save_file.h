@@ -0,0 +1,53 @@
+#ifndef _SAVE_FILE_H
+#define _SAVE_FILE_H
+
+#include "util.h"
+
+class Model;
+
+/** Describes a saved game. It's stored uncompressed at the start of the file, so that the saved games can be
+  * listed without loading them.*/
+struct SaveFileHeader {
+  int version;
+  GameType type;
+  string name;
+  int turn;
+  int numSections;
+
+  template <class Archive>
+  void serialize(Archive& ar, const unsigned int version);
+};
+
+/** Reads and writes save files. The header is followed by the model, compressed and saved in sections, see
+  * Model::serializeSection().*/
+class SaveFile {
+  public:
+  /** Has to be increased whenever the save format changes. Files of other versions aren't loaded.*/
+  static const int version = 2;
+
+  /** Saves the model. \paramname{progress} is called with the fraction of the sections saved after each one.*/
+  static void save(Model* model, GameType type, const string& path, function<void(double)> progress = nullptr);
+
+  /** A model serialized into memory. It doesn't refer to the model, so it can be written while the game goes on.*/
+  struct Snapshot {
+    SaveFileHeader header;
+    string body;
+  };
+
+  /** Serializes the model into memory, without compressing it.*/
+  static Snapshot snapshot(Model* model, GameType type);
+
+  /** Compresses and writes the snapshot into a save file. Can be called on any thread.*/
+  static void write(const Snapshot&, const string& path);
+
+  /** Loads a model. \paramname{progress} is called with the fraction of the sections loaded after each one.*/
+  static unique_ptr<Model> load(const string& path, function<void(double)> progress = nullptr);
+
+  /** Reads only the header. Returns Nothing if the file isn't a save file of the current version.*/
+  static Optional<SaveFileHeader> readHeader(const string& path);
+
+  private:
+  static Optional<SaveFileHeader> readHeader(const string& path, long& bodyOffset);
+};
+
+#endif
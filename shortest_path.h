@@ -4,6 +4,7 @@
 #include <functional>
 
 #include "util.h"
+#include "path_engine.h"
 
 class Creature;
 class Level;
@@ -12,10 +13,11 @@ class ShortestPath {
   public:
   ShortestPath(const Level* level, const Creature* creature, Vec2 target, Vec2 from, double mult = 0,
       bool avoidEnemies = false);
+  template <class EntryFun, class LengthFun>
   ShortestPath(
       Rectangle area,
-      function<double(Vec2)> entryFun,
-      function<int(Vec2)> lengthFun,
+      EntryFun entryFun,
+      LengthFun lengthFun,
       vector<Vec2> directions,
       Vec2 target,
       Vec2 from,
@@ -23,6 +25,7 @@ class ShortestPath {
   bool isReachable(Vec2 pos) const;
   Vec2 getNextMove(Vec2 pos);
   Vec2 getTarget() const;
+  int getLength() const;
   bool isReversed() const;
 
   static const double infinity;
@@ -30,12 +33,8 @@ class ShortestPath {
   SERIALIZATION_DECL(ShortestPath);
 
   private:
-  void init(function<double(Vec2)> entryFun, function<double(Vec2)> lengthFun, Vec2 target, Optional<Vec2> from,
-      Optional<int> limit = Nothing());
-  void reverse(function<double(Vec2)> entryFun, function<double(Vec2)> lengthFun, double mult, Vec2 from, int limit);
-  void setDistance(Vec2, double);
-  double getDistance(Vec2 pos) const;
-  void constructPath(Vec2 start, bool reversed = false);
+  template <class EntryFun, class LengthFun>
+  void init(EntryFun entryFun, LengthFun lengthFun, Vec2 to, Vec2 from, double mult);
   vector<Vec2> SERIAL(path);
   Vec2 SERIAL(target);
   vector<Vec2> SERIAL(directions);
@@ -43,4 +42,32 @@ class ShortestPath {
   bool SERIAL(reversed);
 };
 
+template <class EntryFun, class LengthFun>
+ShortestPath::ShortestPath(Rectangle a, EntryFun entryFun, LengthFun lengthFun, vector<Vec2> dir, Vec2 to,
+    Vec2 from, double mult) : target(to), directions(dir), bounds(a) {
+  init(entryFun, lengthFun, target, from, mult);
+}
+
+template <class EntryFun, class LengthFun>
+void ShortestPath::init(EntryFun entryFun, LengthFun lengthFun, Vec2 to, Vec2 from, double mult) {
+  const int revShortestLimit = 15;
+  PathEngine& engine = PathEngine::get();
+  if (mult == 0) {
+    reversed = false;
+    if (Optional<Vec2> reached = engine.search(bounds, directions, entryFun, lengthFun, to, from)) {
+      Debug() << "Shortest path from " << from << " to " << to << " " << engine.getNumPopped() << " visited";
+      path = engine.constructPath(bounds, directions, *reached, to, false);
+    } else
+      Debug() << "Shortest path exhausted, " << engine.getNumPopped() << " visited";
+  } else {
+    reversed = true;
+    engine.search(bounds, directions, entryFun, lengthFun, to, Nothing(), revShortestLimit);
+    engine.setDistance(to, infinity);
+    if (Optional<Vec2> reached = engine.reverse(bounds, directions, entryFun, lengthFun, mult, from,
+          revShortestLimit))
+      path = engine.constructPath(bounds, directions, *reached, to, true);
+    Debug() << "Rev shortest path from " << to << " " << engine.getNumPopped() << " visited";
+  }
+}
+
 #endif
@@ -5,27 +5,43 @@
 #include "level.h"
 
 template <class Archive> 
-void Square::serialize(Archive& ar, const unsigned int version) { 
+void Square::Properties::serialize(Archive& ar, const unsigned int version) { 
+  ar& BOOST_SERIALIZATION_NVP(name)
+    & BOOST_SERIALIZATION_NVP(hide)
+    & BOOST_SERIALIZATION_NVP(strength)
+    & BOOST_SERIALIZATION_NVP(flamability)
+    & BOOST_SERIALIZATION_NVP(constructions)
+    & BOOST_SERIALIZATION_NVP(ticking);
+}
+
+template <class Archive> 
+void Square::State::serialize(Archive& ar, const unsigned int version) { 
   ar& SVAR(inventory)
-    & SVAR(name)
+    & SVAR(triggers)
+    & SVAR(travelDir)
+    & SVAR(landingLink)
+    & SVAR(constructions);
+  CHECK_SERIAL;
+}
+
+SERIALIZABLE(Square::State);
+
+template <class Archive> 
+void Square::serialize(Archive& ar, const unsigned int version) { 
+  // The properties are saved with every square, and shared again when loading.
+  Properties props;
+  if (properties)
+    props = *properties;
+  ar& BOOST_SERIALIZATION_NVP(props);
+  if (Archive::is_loading::value)
+    properties = getProperties(props);
+  ar& SVAR(state)
     & SVAR(level)
     & SVAR(position)
     & SVAR(creature)
-    & SVAR(triggers)
     & SVAR(viewObject)
     & SVAR(backgroundObject)
-    & SVAR(seeThru)
-    & SVAR(hide)
-    & SVAR(strength)
-    & SVAR(height)
-    & SVAR(travelDir)
-    & SVAR(covered)
-    & SVAR(landingLink)
-    & SVAR(fire)
-    & SVAR(poisonGas)
-    & SVAR(constructions)
-    & SVAR(ticking)
-    & SVAR(fog);
+    & SVAR(seeThru);
   CHECK_SERIAL;
 }
 
@@ -40,13 +56,29 @@ SERIALIZABLE(SolidSquare);
 
 Square::Square(const ViewObject& vo, const string& n, bool see, bool canHide, int s, double f,
     map<SquareType, int> construct, bool tick) 
-    : name(n), viewObject(vo), seeThru(see), hide(canHide), strength(s), fire(strength, f),
-    constructions(construct), ticking(tick) {
+    : viewObject(vo), properties(getProperties({n, canHide, s, f, construct, tick})), seeThru(see) {
+}
+
+bool Square::Properties::operator < (const Properties& p) const {
+  return std::tie(name, hide, strength, flamability, constructions, ticking)
+      < std::tie(p.name, p.hide, p.strength, p.flamability, p.constructions, p.ticking);
+}
+
+const Square::Properties* Square::getProperties(const Properties& properties) {
+  static set<Properties> allProperties;
+  return &*allProperties.insert(properties).first;
+}
+
+Square::State& Square::getState() {
+  if (!state)
+    state.reset(new State());
+  return *state;
 }
 
 void Square::putCreature(Creature* c) {
   CHECK(canEnter(c));
   creature = c;
+  level->updateSquareFlags(position);
   onEnter(c);
 }
 
@@ -59,49 +91,48 @@ Vec2 Square::getPosition() const {
 }
 
 string Square::getName() const {
-  return name;
+  return properties->name;
 }
 
 void Square::setName(const string& s) {
-  name = s;
+  Properties p = *properties;
+  p.name = s;
+  properties = getProperties(p);
 }
 
 void Square::setLandingLink(StairDirection direction, StairKey key) {
-  landingLink = make_pair(direction, key);
+  getState().landingLink = make_pair(direction, key);
 }
 
 bool Square::isLandingSquare(StairDirection direction, StairKey key) {
-  return landingLink == make_pair(direction, key);
+  return getLandingLink() == make_pair(direction, key);
 }
 
 Optional<pair<StairDirection, StairKey>> Square::getLandingLink() const {
-  return landingLink;
-}
-
-void Square::setCovered(bool c) {
-  covered = c;
-}
-
-bool Square::isCovered() const {
-  return covered;
+  if (state)
+    return state->landingLink;
+  return Nothing();
 }
 
 void Square::setHeight(double h) {
   viewObject.setHeight(h);
-  height = h;
 }
 
 void Square::addTravelDir(Vec2 dir) {
+  vector<Vec2>& travelDir = getState().travelDir;
   if (!findElement(travelDir, dir))
     travelDir.push_back(dir);
 }
 
 bool Square::canConstruct(SquareType type) const {
-  return constructions.count(type);
+  return properties->constructions.count(type);
 }
 
 bool Square::construct(SquareType type) {
   CHECK(canConstruct(type));
+  map<SquareType, int>& constructions = getState().constructions;
+  if (!constructions.count(type))
+    constructions[type] = properties->constructions.at(type);
   if (--constructions[type] == 0) {
     PSquare newSquare = PSquare(SquareFactory::get(type));
     level->replaceSquare(position, std::move(newSquare));
@@ -123,17 +154,21 @@ void Square::burnOut() {
 }
 
 const vector<Vec2>& Square::getTravelDir() const {
-  return travelDir;
+  static vector<Vec2> empty;
+  if (state)
+    return state->travelDir;
+  return empty;
 }
 
 void Square::putCreatureSilently(Creature* c) {
   CHECK(canEnter(c));
   creature = c;
+  level->updateSquareFlags(position);
 }
 
 void Square::setLevel(Level* l) {
   level = l;
-  if (ticking || !inventory.isEmpty())
+  if (properties->ticking || (state && !state->inventory.isEmpty()))
     level->addTickingSquare(position);
 }
 
@@ -145,41 +180,28 @@ Level* Square::getLevel() {
   return level;
 }
 
-void Square::setFog(double val) {
-  fog = val;
+void Square::tick(double time) {
+  if (state)
+    tickState(time);
+  tickSpecial(time);
 }
 
-void Square::tick(double time) {
-  if (!inventory.isEmpty())
+void Square::tickState(double time) {
+  Inventory& inventory = state->inventory;
+  if (!inventory.isEmpty()) {
     for (Item* item : inventory.getItems()) {
       item->tick(time, level, position);
       if (item->isDiscarded())
         inventory.removeItem(item);
     }
-  poisonGas.tick(level, position);
-  if (creature && poisonGas.getAmount() > 0.2) {
-    creature->poisonWithGas(min(1.0, poisonGas.getAmount()));
-  }
-  if (fire.isBurning()) {
-    viewObject.setBurning(fire.getSize());
-    Debug() << getName() << " burning " << fire.getSize();
-    for (Vec2 v : position.neighbors8(true))
-      if (fire.getSize() > Random.getDouble() * 40)
-        level->getSquare(v)->setOnFire(fire.getSize() / 20);
-    fire.tick(level, position);
-    if (fire.isBurntOut()) {
-      level->globalMessage(position, "The " + getName() + " burns out");
-      burnOut();
-      return;
-    }
-    if (creature)
-      creature->setOnFire(fire.getSize());
-    for (Item* it : getItems())
-      it->setOnFire(fire.getSize(), level, position);
+    // The fire itself is simulated by the level.
+    if (double fire = level->getFields().getFire(position))
+      for (Item* it : getItems())
+        it->setOnFire(fire, level, position);
   }
-  for (Trigger* t : extractRefs(triggers))
+  for (Trigger* t : extractRefs(state->triggers))
     t->tick(time);
-  tickSpecial(time);
+  level->updateSquareFlags(position);
 }
 
 bool Square::itemLands(vector<Item*> item, const Attack& attack) {
@@ -194,7 +216,7 @@ bool Square::itemLands(vector<Item*> item, const Attack& attack) {
       return false;
     }
   }
-  for (PTrigger& t : triggers)
+  for (Trigger* t : getTriggers())
     if (t->interceptsFlyingItem(item[0]))
       return true;
   return false;
@@ -211,7 +233,7 @@ void Square::onItemLands(vector<PItem> item, const Attack& attack, int remaining
       dropItems(std::move(item));
     return;
   }
-  for (PTrigger& t : triggers)
+  for (Trigger* t : getTriggers())
     if (t->interceptsFlyingItem(item[0].get())) {
       t->onInterceptFlyingItem(std::move(item), attack, remainingDist, dir);
       return;
@@ -235,13 +257,9 @@ bool Square::canEnterSpecial(const Creature* c) const {
 }
 
 void Square::setOnFire(double amount) {
-  bool burning = fire.isBurning();
-  fire.set(amount);
-  if (!burning && fire.isBurning()) {
-    level->addTickingSquare(position);
+  if (properties->flamability > 0 && level->getFields().setOnFire(position, amount, properties->strength,
+        properties->flamability))
     level->globalMessage(position, "The " + getName() + " catches fire.");
-    viewObject.setBurning(fire.getSize());
-  }
   if (creature)
     creature->setOnFire(amount);
   for (Item* it : getItems())
@@ -249,18 +267,16 @@ void Square::setOnFire(double amount) {
 }
 
 void Square::addPoisonGas(double amount) {
-  if (canSeeThru()) {
-    poisonGas.addAmount(amount);
-    level->addTickingSquare(position);
-  }
+  if (canSeeThru())
+    level->getFields().addGas(position, amount);
 }
 
 double Square::getPoisonGasAmount() const {
-  return poisonGas.getAmount();
+  return level ? level->getFields().getGas(position) : 0;
 }
 
 bool Square::isBurning() const {
-  return fire.isBurning();
+  return level && level->getFields().getFire(position) > 0;
 }
 
 const ViewObject& Square::getViewObject() const {
@@ -286,10 +302,11 @@ static ViewObject addFire(const ViewObject& obj, double fire) {
 }
 
 ViewIndex Square::getViewIndex(const CreatureView* c) const {
-  double fireSize = 0;
-  for (Item* it : inventory.getItems())
-    fireSize = max(fireSize, it->getFireSize());
-  fireSize = max(fireSize, fire.getSize());
+  double squareFire = level->getFields().getFire(position);
+  double fireSize = squareFire;
+  if (state)
+    for (Item* it : state->inventory.getItems())
+      fireSize = max(fireSize, it->getFireSize());
   ViewIndex ret;
   if (creature && (c->canSee(creature) || creature->isPlayer())) {
     ret.insert(addFire(creature->getViewObject(), fireSize));
@@ -300,32 +317,34 @@ ViewIndex Square::getViewIndex(const CreatureView* c) const {
   if (c->canSee(position)) {
     if (backgroundObject)
       ret.insert(*backgroundObject);
-    ret.insert(getViewObject());
-    for (const PTrigger& t : triggers)
+    ret.insert(addFire(getViewObject(), squareFire));
+    for (Trigger* t : getTriggers())
       if (auto obj = t->getViewObject(c))
         ret.insert(addFire(*obj, fireSize));
     if (Item* it = getTopItem())
       ret.insert(addFire(it->getViewObject(), fireSize));
   }
   if (c->canSee(position)) {
-    if (poisonGas.getAmount() > 0)
-      ret.setHighlight(HighlightType::POISON_GAS, min(1.0, poisonGas.getAmount()));
-    if (fog)
+    if (getPoisonGasAmount() > 0)
+      ret.setHighlight(HighlightType::POISON_GAS, min(1.0, getPoisonGasAmount()));
+    if (double fog = level->getFog(position))
       ret.setHighlight(HighlightType::FOG, fog);
   }
   return ret;
 }
 
 void Square::onEnter(Creature* c) {
-  for (Trigger* t : extractRefs(triggers))
+  for (Trigger* t : getTriggers())
     t->onCreatureEnter(c);
   onEnterSpecial(c);
 }
 
 void Square::dropItem(PItem item) {
-  if (level)  // if level == null, then it's being constructed, square will be added later
+  getState().inventory.addItem(std::move(item));
+  if (level) { // if level == null, then it's being constructed, square will be added later
     level->addTickingSquare(getPosition());
-  inventory.addItem(std::move(item));
+    level->updateSquareFlags(getPosition());
+  }
 }
 
 void Square::dropItems(vector<PItem> items) {
@@ -334,7 +353,7 @@ void Square::dropItems(vector<PItem> items) {
 }
 
 bool Square::hasItem(Item* it) const {
-  return inventory.hasItem(it);
+  return state && state->inventory.hasItem(it);
 }
 
 Creature* Square::getCreature() {
@@ -343,25 +362,35 @@ Creature* Square::getCreature() {
 
 void Square::addTrigger(PTrigger t) {
   level->addTickingSquare(position);
-  triggers.push_back(std::move(t));
+  getState().triggers.push_back(std::move(t));
+  level->addViewChange(position);
 }
 
 const vector<Trigger*> Square::getTriggers() const {
-  return extractRefs(triggers);
+  if (state)
+    return extractRefs(state->triggers);
+  return {};
 }
 
 PTrigger Square::removeTrigger(Trigger* trigger) {
+  if (!state)
+    return nullptr;
+  vector<PTrigger>& triggers = state->triggers;
   for (PTrigger& t : triggers)
     if (t.get() == trigger) {
       PTrigger ret = std::move(t);
       removeElement(triggers, t);
+      level->addViewChange(position);
       return ret;
     }
   return nullptr;
 }
 
 void Square::removeTriggers() {
-  triggers.clear();
+  if (state) {
+    state->triggers.clear();
+    level->addViewChange(position);
+  }
 }
 
 const Creature* Square::getCreature() const {
@@ -371,6 +400,7 @@ const Creature* Square::getCreature() const {
 void Square::removeCreature() {
   CHECK(creature);
   creature = 0;
+  level->updateSquareFlags(position);
 }
 
 bool SolidSquare::canEnterSpecial(const Creature*) const {
@@ -386,17 +416,21 @@ void Square::setCanSeeThru(bool f) {
 }
 
 bool Square::canHide() const {
-  return hide;
+  return properties->hide;
 }
 
 int Square::getStrength() const {
-  return strength;
+  return properties->strength;
+}
+
+double Square::getFlamability() const {
+  return properties->flamability;
 }
 
 Item* Square::getTopItem() const {
   Item* last = nullptr;
-  if (!inventory.isEmpty())
-  for (Item* it : inventory.getItems()) {
+  if (state && !state->inventory.isEmpty())
+  for (Item* it : state->inventory.getItems()) {
     last = it;
     if (it->getViewObject().layer() == ViewLayer::LARGE_ITEM)
       return it;
@@ -405,14 +439,30 @@ Item* Square::getTopItem() const {
 }
 
 vector<Item*> Square::getItems(function<bool (Item*)> predicate) {
-  return inventory.getItems(predicate);
+  if (state)
+    return state->inventory.getItems(predicate);
+  return {};
+}
+
+bool Square::hasItems() const {
+  return state && !state->inventory.isEmpty();
 }
 
 PItem Square::removeItem(Item* it) {
-  return inventory.removeItem(it);
+  CHECK(state);
+  PItem ret = state->inventory.removeItem(it);
+  if (level)
+    level->updateSquareFlags(position);
+  return ret;
 }
 
 vector<PItem> Square::removeItems(vector<Item*> it) {
-  return inventory.removeItems(it);
+  if (it.empty())
+    return {};
+  CHECK(state);
+  vector<PItem> ret = state->inventory.removeItems(it);
+  if (level)
+    level->updateSquareFlags(position);
+  return ret;
 }
 
@@ -8,7 +8,6 @@
 #include "inventory.h"
 #include "trigger.h"
 #include "view_index.h"
-#include "poison_gas.h"
 
 class Level;
 
@@ -39,12 +38,6 @@ class Square {
   /** Returns the entry point details. Returns nothing if square is not entry point. See setLandingLink().*/
   Optional<pair<StairDirection, StairKey>> getLandingLink() const;
 
-  /** Marks this square as covered, i.e. having a roof.*/
-  void setCovered(bool);
-
-  /** Checks if this square is covered, i.e. having a roof.*/
-  bool isCovered() const;
-
   /** Sets the height of the square.*/
   void setHeight(double height);
 
@@ -67,6 +60,10 @@ class Square {
     * creatures on the square.*/
   bool canEnterEmpty(const Creature*) const;
 
+  /** Returns false if canEnterEmpty depends on more than what FlowField::getMovementClass tells about
+    * the creature, so the result can't be shared with other creatures.*/
+  virtual bool isEntryCacheable() const { return true; }
+
   /** Checks if this square obstructs view.*/
   bool canSeeThru() const;
 
@@ -79,6 +76,9 @@ class Square {
   /** Returns the strength, i.e. resistance to demolition.*/
   int getStrength() const;
 
+  /** Returns how easily the square catches fire. Zero if it doesn't burn.*/
+  double getFlamability() const;
+
   /** Checks if this square can be destroyed.*/
   virtual bool canDestroy(const Creature* c) const { return canDestroy(); }
   virtual bool canDestroy() const { return false; }
@@ -168,6 +168,10 @@ class Square {
   virtual bool itemBounces(Item* item) const;
   void onItemLands(vector<PItem> item, const Attack& attack, int remainingDist, Vec2 dir);
   vector<Item*> getItems(function<bool (Item*)> predicate = alwaysTrue<Item*>());
+
+  /** Checks if there are any items on the square.*/
+  bool hasItems() const;
+
   PItem removeItem(Item*);
   vector<PItem> removeItems(vector<Item*>);
 
@@ -178,8 +182,6 @@ class Square {
 
   virtual ~Square() {};
 
-  void setFog(double val);
-
   SERIALIZATION_DECL(Square);
 
   protected:
@@ -188,30 +190,54 @@ class Square {
   virtual void onEnterSpecial(Creature*) {}
   virtual void tickSpecial(double time) {}
   Level* getLevel();
-  Inventory SERIAL(inventory);
-  string SERIAL(name);
   ViewObject SERIAL(viewObject);
 
   private:
   Item* getTopItem() const;
 
+  /** Ticks the items and triggers.*/
+  void tickState(double time);
+
+  /** Attributes that don't change after construction. All squares created with the same values share
+    * one instance.*/
+  struct Properties {
+    string name;
+    bool hide;
+    int strength;
+    double flamability;
+    map<SquareType, int> constructions;
+    bool ticking;
+
+    bool operator < (const Properties&) const;
+
+    template <class Archive>
+    void serialize(Archive& ar, const unsigned int version);
+  };
+
+  /** Returns the shared instance equal to \paramname{properties}.*/
+  static const Properties* getProperties(const Properties&);
+
+  /** State that few squares ever have. It's allocated when first needed.*/
+  struct State {
+    Inventory SERIAL(inventory);
+    vector<PTrigger> SERIAL(triggers);
+    vector<Vec2> SERIAL(travelDir);
+    Optional<pair<StairDirection, StairKey>> SERIAL(landingLink);
+    /** Work left on the constructions that were started.*/
+    map<SquareType, int> SERIAL(constructions);
+
+    SERIALIZATION_DECL(State);
+  };
+
+  State& getState();
+
+  const Properties* properties = nullptr;
+  unique_ptr<State> SERIAL(state);
   Level* SERIAL2(level, nullptr);
   Vec2 SERIAL(position);
   Creature* SERIAL2(creature, nullptr);
-  vector<PTrigger> SERIAL(triggers);
   Optional<ViewObject> SERIAL(backgroundObject);
   bool SERIAL(seeThru);
-  bool SERIAL(hide);
-  int SERIAL(strength);
-  double SERIAL(height);
-  vector<Vec2> SERIAL(travelDir);
-  bool SERIAL2(covered, false);
-  Optional<pair<StairDirection, StairKey>> SERIAL(landingLink);
-  Fire SERIAL(fire);
-  PoisonGas SERIAL(poisonGas);
-  map<SquareType, int> SERIAL(constructions);
-  bool SERIAL(ticking);
-  double SERIAL2(fog, 0);
 };
 
 class SolidSquare : public Square {
@@ -50,7 +50,7 @@ class SecretPassage : public Square {
     setName("floor");
     viewObject = secondary;
     setCanSeeThru(true);
-    getLevel()->updateVisibility(pos);
+    getLevel()->updateSquare(pos);
   }
 
   virtual bool canDestroy() const override {
@@ -228,6 +228,7 @@ class Chest : public Square {
     c->privateMessage("You open the " + getName());
     opened = true;
     viewObject = openedObject;
+    getLevel()->addViewChange(getPosition());
     if (!Random.roll(5)) {
       c->privateMessage(msgItem);
       vector<PItem> items = itemFactory.random();
@@ -326,7 +327,7 @@ class Tree : public Square {
     getLevel()->globalMessage(getPosition(), "The tree falls.");
     destroyed = true;
     setCanSeeThru(true);
-    getLevel()->updateVisibility(getPosition());
+    getLevel()->updateSquare(getPosition());
     viewObject = ViewObject(ViewId::FALLEN_TREE, ViewLayer::FLOOR, "Fallen tree");
   }
 
@@ -336,7 +337,7 @@ class Tree : public Square {
 
   virtual void burnOut() override {
     setCanSeeThru(true);
-    getLevel()->updateVisibility(getPosition());
+    getLevel()->updateSquare(getPosition());
     viewObject = ViewObject(ViewId::BURNT_TREE, ViewLayer::FLOOR, "Burnt tree");
   }
 
@@ -449,6 +450,7 @@ class TribeDoor : public Door {
       viewObject.setModifier(ViewObject::LOCKED);
     else
       viewObject.removeModifier(ViewObject::LOCKED);
+    getLevel()->updateSquare(getPosition());
   }
 
   template <class Archive> 
@@ -702,6 +704,10 @@ class Hatchery : public Square {
     return c->canWalk() || c->getName() == "chicken" || c->getName() == "pig";
   }
 
+  virtual bool isEntryCacheable() const override {
+    return false;
+  }
+
   template <class Archive> 
   void serialize(Archive& ar, const unsigned int version) {
     ar & SUBCLASS(Square);
@@ -17,6 +17,7 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <queue>
+#include <bitset>
 #include <random>
 #include <stdexcept>
 #include <tuple>
@@ -69,6 +70,7 @@ using std::string;
 
 using std::queue;
 using std::unique_ptr;
+using std::shared_ptr;
 using std::default_random_engine;
 using std::function;
 using std::initializer_list;
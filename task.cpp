@@ -38,7 +38,10 @@ void Task::setDone() {
 }
 
 void Task::setPosition(Vec2 pos) {
+  Vec2 from = position;
   position = pos;
+  if (collective && from != pos)
+    collective->onTaskMoved(this, from);
 }
 
 class Construction : public Task {
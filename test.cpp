@@ -4,6 +4,17 @@
 #include "util.h"
 #include "shortest_path.h"
 #include "level_maker.h"
+#include "time_queue.h"
+#include "creature_factory.h"
+#include "tribe.h"
+#include "field_of_view.h"
+#include "profiler.h"
+#include "square_factory.h"
+#include "level.h"
+#include "flow_field.h"
+#include "renderer.h"
+#include "view_index.h"
+#include "map_memory.h"
 
 
 
@@ -13,10 +24,9 @@ void testStringConvertion() {
 }
 
 void testTimeQueue() {
- /* CreatureAttributes attr = CATTR(c.name = ""; c.speed = 5; c.size = CreatureSize::SMALL; c.strength = 1; c.dexterity = 3; c.humanoid = false; c.weight = 0.1;);
-  PCreature b(new Creature(ViewObject(ViewId::JACKAL, ViewLayer::CREATURE, ""), nullptr, attr));
-  PCreature a(new Creature(ViewObject(ViewId::PLAYER, ViewLayer::CREATURE, ""), nullptr, attr));
-  PCreature c(new Creature(ViewObject(ViewId::JACKAL, ViewLayer::CREATURE, ""), nullptr, attr));
+  PCreature a = CreatureFactory::fromId(CreatureId::JACKAL, Tribes::get(TribeId::MONSTER));
+  PCreature b = CreatureFactory::fromId(CreatureId::JACKAL, Tribes::get(TribeId::MONSTER));
+  PCreature c = CreatureFactory::fromId(CreatureId::JACKAL, Tribes::get(TribeId::MONSTER));
   Creature* rb = b.get(), *ra = a.get(), *rc = c.get();
   a->setTime(1);
   b->setTime(1.33);
@@ -30,10 +40,40 @@ void testTimeQueue() {
   CHECK(q.getNextCreature() == rb);
   rb->setTime(2);
   CHECK(q.getNextCreature() == rc);
-  rc->setTime(3);
-  CHECK(q.getNextCreature() == rb);
+  rc->setTime(2);
+  CHECK(q.getNextBatch() == vector<Creature*>({ra, rb, rc}));
+  ra->setTime(3);
   rb->setTime(3);
-  CHECK(q.getNextCreature() == ra);*/
+  CHECK(q.getNextBatch() == vector<Creature*>({rc}));
+  PCreature removed = q.removeCreature(rc);
+  CHECK(q.getNextCreature() == ra);
+  CHECK(q.getAllCreatures().size() == 2);
+  CHECK(q.getCurrentTime() == 3);
+}
+
+void testTimeQueueRemoval() {
+  TimeQueue q;
+  vector<Creature*> refs;
+  for (int i : Range(6)) {
+    PCreature c = CreatureFactory::fromId(CreatureId::JACKAL, Tribes::get(TribeId::MONSTER));
+    c->setTime(6 - i);
+    refs.push_back(c.get());
+    q.addCreature(move(c));
+  }
+  PCreature removed1 = q.removeCreature(refs[1]);
+  PCreature removed2 = q.removeCreature(refs[5]);
+  CHECK(q.getAllCreatures() == vector<Creature*>({refs[0], refs[2], refs[3], refs[4]}));
+  CHECK(q.getNextCreature() == refs[4]);
+  PCreature removed3 = q.removeCreature(refs[2]);
+  CHECK(q.getAllCreatures() == vector<Creature*>({refs[0], refs[3], refs[4]}));
+  CHECK(q.getNextCreature() == refs[4]);
+  refs[4]->setTime(10);
+  CHECK(q.getNextCreature() == refs[3]);
+  PCreature removed4 = q.removeCreature(refs[3]);
+  CHECK(q.getNextCreature() == refs[0]);
+  q.addCreature(move(removed1));
+  CHECK(q.getAllCreatures() == vector<Creature*>({refs[0], refs[4], refs[1]}));
+  CHECK(q.getNextCreature() == refs[1]);
 }
 
 void testRectangleIterator() {
@@ -324,6 +364,404 @@ void testCombine() {
   CHECKEQ(combine(words), "pok and pik");
 }
 
+void testFieldOfView() {
+  OpacityMap opacity(100, 100);
+  Vec2 from(50, 50);
+  for (int i : Range(-10, 11)) {
+    opacity.setOpaque(from + Vec2(i, 5), true);
+    opacity.setOpaque(from + Vec2(i, -5), true);
+    opacity.setOpaque(from + Vec2(5, i), true);
+  }
+  CHECK(opacity.isOpaque(Vec2(55, 45)));
+  CHECK(!opacity.isOpaque(Vec2(45, 52)));
+  CHECK(opacity.isOpaque(Vec2(-1, 50)));
+  FieldOfView fov(opacity);
+  CHECK(fov.canSee(from, from + Vec2(0, 4)));
+  CHECK(fov.canSee(from, from + Vec2(0, 5)));
+  CHECK(!fov.canSee(from, from + Vec2(0, 6)));
+  CHECK(!fov.canSee(from, from + Vec2(0, -6)));
+  CHECK(!fov.canSee(from, from + Vec2(6, 0)));
+  CHECK(fov.canSee(from, from + Vec2(-30, 0)));
+  CHECK(!fov.canSee(from, from + Vec2(-31, 0)));
+  CHECK(fov.canSee(from, from + Vec2(-21, 2)));
+  for (Vec2 v : fov.getVisibleTiles(from))
+    CHECK(fov.canSee(from, v)) << v;
+  Vec2 corner(2, 3);
+  int numVisible = 0;
+  for (Vec2 v : Rectangle(100, 100))
+    if ((v - corner).lengthD() <= 30)
+      ++numVisible;
+  CHECK(fov.getVisibleTiles(corner).size() == numVisible) << int(fov.getVisibleTiles(corner).size());
+  CHECK(fov.canSee(corner, Vec2(0, 0)));
+  opacity.setOpaque(Vec2(3, 3), true);
+  fov.squareChanged(Vec2(3, 3));
+  CHECK(!fov.canSee(corner, Vec2(5, 3)));
+  CHECK(fov.canSee(corner, Vec2(2, 8)));
+  FieldOfView small(opacity, 3);
+  vector<Vec2> origins {Vec2(10, 10), Vec2(20, 20), Vec2(30, 30), Vec2(40, 40), Vec2(60, 60)};
+  for (int i : Range(4))
+    small.canSee(origins[i], origins[i]);
+  // The second origin was used again, so the third one is replaced instead.
+  small.canSee(origins[1], origins[1]);
+  small.canSee(origins[4], origins[4]);
+  CHECK(small.getNumCached() == 3);
+  CHECK(small.getNumHits() == 1);
+  CHECK(small.getNumMisses() == 5);
+  small.canSee(origins[1], origins[1]);
+  CHECK(small.getNumHits() == 2);
+  small.canSee(origins[2], origins[2]);
+  CHECK(small.getNumMisses() == 6);
+  // Only the result of the origin that sees the changed square is dropped.
+  opacity.setOpaque(Vec2(60, 62), true);
+  small.squareChanged(Vec2(60, 62));
+  small.squareChanged(Vec2(60, 62));
+  CHECK(small.getNumCached() == 3);
+  CHECK(!small.canSee(origins[4], Vec2(60, 63)));
+  CHECK(small.getNumCached() == 3);
+  CHECK(small.getNumMisses() == 7);
+  small.canSee(origins[1], origins[1]);
+  small.canSee(origins[2], origins[2]);
+  CHECK(small.getNumMisses() == 7);
+}
+
+void testSquareProperties() {
+  unique_ptr<Square> s1(SquareFactory::get(SquareType::FLOOR));
+  unique_ptr<Square> s2(SquareFactory::get(SquareType::FLOOR));
+  s1->setName("path");
+  CHECK(s1->getName() == "path");
+  CHECK(s2->getName() == "floor");
+  for (int i : Range(9))
+    CHECK(!s1->construct(SquareType::TREASURE_CHEST));
+  CHECK(!s2->construct(SquareType::TREASURE_CHEST));
+  s1->addTravelDir(Vec2(1, 0));
+  CHECK(s1->getTravelDir().size() == 1);
+  CHECK(s2->getTravelDir().empty());
+  CHECK(s2->getItems().empty());
+  CHECK(!s2->isBurning());
+  CHECK(s2->getPoisonGasAmount() == 0);
+}
+
+class TestLevelMaker : public LevelMaker {
+  public:
+  virtual void make(Level::Builder* builder, Rectangle area) override {
+    for (Vec2 v : area)
+      builder->putSquare(v, SquareType::FLOOR);
+    builder->putSquare(Vec2(1, 1), SquareType::WOOD_WALL);
+  }
+};
+
+void testLevelTileCache() {
+  PCreature jackal = CreatureFactory::fromId(CreatureId::JACKAL, Tribes::get(TribeId::MONSTER));
+  Level::Builder builder(4, 4, "test");
+  TestLevelMaker maker;
+  PLevel level = builder.build(nullptr, &maker, false);
+  CHECK(level->canSeeThru(Vec2(0, 0)));
+  CHECK(!level->canSeeThru(Vec2(1, 1)));
+  CHECK(!level->isOccupied(Vec2(0, 0)));
+  level->getSquare(Vec2(1, 1))->setOnFire(1);
+  CHECK(level->isBurning(Vec2(1, 1)));
+  CHECK(!level->isBurning(Vec2(0, 0)));
+  level->getSquare(Vec2(2, 2))->addPoisonGas(1);
+  CHECK(level->hasPoisonGas(Vec2(2, 2)));
+  int numChanges = level->getNumSquareChanges();
+  int numViewChanges = level->getNumViewChanges();
+  level->replaceSquare(Vec2(3, 3), PSquare(SquareFactory::get(SquareType::ROCK_WALL)));
+  CHECK(!level->canSeeThru(Vec2(3, 3)));
+  CHECK(level->getNumSquareChanges() > numChanges);
+  CHECK(contains(*level->getSquareChangesSince(numChanges), Vec2(3, 3)));
+  CHECK(!contains(*level->getSquareChangesSince(numChanges), Vec2(0, 0)));
+  CHECK(level->viewChangedSince(Vec2(3, 3), numViewChanges));
+  CHECK(!level->viewChangedSince(Vec2(0, 0), numViewChanges));
+  level->putCreature(Vec2(0, 0), jackal.get());
+  numViewChanges = level->getNumViewChanges();
+  level->moveCreature(jackal.get(), Vec2(1, 0));
+  CHECK(level->viewChangedSince(Vec2(0, 0), numViewChanges));
+  CHECK(level->viewChangedSince(Vec2(1, 0), numViewChanges));
+  CHECK(!level->viewChangedSince(Vec2(0, 1), numViewChanges));
+  level->checkConsistency();
+}
+
+void testAttributeCache() {
+  Creature::setCacheChecks(true);
+  PCreature c = CreatureFactory::fromId(CreatureId::JACKAL, Tribes::get(TribeId::MONSTER));
+  c->setTime(1);
+  int strength = c->getAttr(AttrType::STRENGTH);
+  int damage = c->getAttr(AttrType::DAMAGE);
+  c->addEffect(Creature::STR_BONUS, 10, false);
+  CHECK(c->getAttr(AttrType::STRENGTH) == strength + 3);
+  CHECK(c->getAttr(AttrType::DAMAGE) == damage + 3);
+  c->setTime(20);
+  CHECK(c->getAttr(AttrType::STRENGTH) == strength);
+  Tribes::get(TribeId::MONSTER)->setHandicap(2);
+  CHECK(c->getAttr(AttrType::STRENGTH) == strength + 2);
+  Tribes::get(TribeId::MONSTER)->setHandicap(0);
+  CHECK(c->getAttr(AttrType::STRENGTH) == strength);
+  Creature::setCacheChecks(false);
+}
+
+void testSightCache() {
+  Creature::setCacheChecks(true);
+  vector<PCreature> creatures;
+  for (int i : Range(3))
+    creatures.push_back(CreatureFactory::fromId(CreatureId::JACKAL, Tribes::get(TribeId::MONSTER)));
+  Creature* c = creatures[0].get();
+  Level::Builder builder(60, 20, "test");
+  TestLevelMaker maker;
+  PLevel level = builder.build(nullptr, &maker, false);
+  level->putCreature(Vec2(5, 5), c);
+  level->putCreature(Vec2(10, 5), creatures[1].get());
+  CHECK(c->needsSightUpdate());
+  level->precomputeSight({Vec2(5, 5)});
+  CHECK(level->getVisibleCreaturesReadOnly(Vec2(5, 5)) == level->getVisibleCreatures(Vec2(5, 5)));
+  c->updateSight();
+  CHECK(!c->needsSightUpdate());
+  CHECK(c->getCreaturesInSight().size() == 2);
+  // Too far away to matter.
+  level->putCreature(Vec2(55, 5), creatures[2].get());
+  CHECK(!c->needsSightUpdate());
+  level->moveCreature(creatures[1].get(), Vec2(1, 0));
+  CHECK(c->needsSightUpdate());
+  CHECK(c->getCreaturesInSight().size() == 2);
+  CHECK(!c->needsSightUpdate());
+  level->replaceSquare(Vec2(8, 5), PSquare(SquareFactory::get(SquareType::ROCK_WALL)));
+  CHECK(c->needsSightUpdate());
+  CHECK(c->getCreaturesInSight().size() == 1);
+  level.reset();
+  Creature::setCacheChecks(false);
+}
+
+class CorridorLevelMaker : public LevelMaker {
+  public:
+  CorridorLevelMaker(vector<Vec2> p) : passage(p) {}
+
+  virtual void make(Level::Builder* builder, Rectangle area) override {
+    for (Vec2 v : area)
+      builder->putSquare(v, SquareType::ROCK_WALL);
+    for (int x : Range(1, 11))
+      builder->putSquare(Vec2(x, 1), SquareType::FLOOR);
+    for (Vec2 v : passage)
+      builder->putSquare(v, SquareType::FLOOR);
+  }
+
+  private:
+  vector<Vec2> passage;
+};
+
+void testFlowFieldCrowd() {
+  PCreature a = CreatureFactory::fromId(CreatureId::JACKAL, Tribes::get(TribeId::MONSTER));
+  PCreature b = CreatureFactory::fromId(CreatureId::JACKAL, Tribes::get(TribeId::MONSTER));
+  Vec2 target(10, 1);
+  Level::Builder builder(12, 5, "test");
+  CorridorLevelMaker maker({Vec2(2, 2), Vec2(3, 3), Vec2(4, 2)});
+  PLevel level = builder.build(nullptr, &maker, false);
+  level->putCreature(Vec2(2, 1), a.get());
+  level->putCreature(Vec2(3, 1), b.get());
+  FlowField field(level.get(), {target});
+  CHECK(field.getNextMove(b.get()) == Vec2(1, 0));
+  // Asleep, so a can't swap positions with it.
+  b->setTime(1);
+  b->addEffect(Creature::SLEEP, 10, false);
+  // The only closer square is taken, so a steps into the side passage, which is as far from the target.
+  CHECK(field.getNextMove(a.get()) == Vec2(0, 1));
+  level->moveCreature(a.get(), Vec2(0, 1));
+  CHECK(field.getNextMove(a.get()) == Vec2(1, 1));
+  level->moveCreature(a.get(), Vec2(1, 1));
+  CHECK(field.getNextMove(a.get()) == Vec2(1, -1));
+  level.reset();
+  // The side passage starts further from the target, so a can only get around b with its own path.
+  Level::Builder builder2(12, 5, "test");
+  CorridorLevelMaker maker2({Vec2(1, 2), Vec2(2, 3), Vec2(3, 3), Vec2(4, 2)});
+  level = builder2.build(nullptr, &maker2, false);
+  level->putCreature(Vec2(2, 1), a.get());
+  level->putCreature(Vec2(3, 1), b.get());
+  FlowField field2(level.get(), {target});
+  CHECK(!field2.getNextMove(a.get()));
+  CHECK(a->getSharedMoveTowards({target}) == Vec2(-1, 1));
+  level.reset();
+}
+
+void testFieldSimulation() {
+  Level::Builder builder(20, 20, "test");
+  TestLevelMaker maker;
+  PLevel level = builder.build(nullptr, &maker, false);
+  level->getSquare(Vec2(7, 10))->addPoisonGas(2);
+  CHECK(level->getFields().getNumActiveChunks() == 1);
+  for (int i : Range(2))
+    level->tick(i);
+  CHECK(level->hasPoisonGas(Vec2(9, 10)));
+  CHECK(level->getFields().getGas(Vec2(7, 10)) < 2);
+  // The gas has spread to the neighboring chunk.
+  CHECK(level->getFields().getNumActiveChunks() == 2);
+  level->getSquare(Vec2(1, 1))->setOnFire(1);
+  CHECK(level->isBurning(Vec2(1, 1)));
+  CHECK(!level->isBurning(Vec2(0, 0)));
+  for (int i = 2; i < 10000 && level->getFields().getNumActiveChunks() > 0; ++i)
+    level->tick(i);
+  CHECK(level->getFields().getNumActiveChunks() == 0);
+  CHECK(!level->hasPoisonGas(Vec2(10, 10)));
+  CHECK(!level->isBurning(Vec2(1, 1)));
+  CHECK(level->getSquare(Vec2(1, 1))->getName() == "floor");
+  CHECK(!level->getSquare(Vec2(1, 1))->isBurning());
+  level->checkConsistency();
+}
+
+void testProfiler() {
+  Profiler::reset();
+  for (int i : Range(10)) {
+    PROFILE_ZONE("outer");
+    for (int j : Range(3)) {
+      PROFILE_ZONE("inner");
+    }
+  }
+  {
+    PROFILE_ZONE("inner");
+  }
+  thread t([] {
+    PROFILE_ZONE("outer");
+  });
+  t.join();
+  vector<Profiler::ZoneStats> stats = Profiler::getStats();
+  CHECK(stats.size() == 3) << int(stats.size());
+  CHECK(stats[0].path == "outer" && stats[0].count == 11 && stats[0].depth == 0);
+  CHECK(stats[1].path == "outer/inner" && stats[1].count == 30 && stats[1].depth == 1);
+  CHECK(stats[2].path == "inner" && stats[2].count == 1);
+  CHECK(stats[1].min <= stats[1].median && stats[1].median <= stats[1].p99 && stats[1].p99 <= stats[1].max);
+  CHECK(stats[0].total >= stats[1].total);
+  Profiler::reset();
+  CHECK(Profiler::getStats().empty());
+}
+
+void testRunInParallel() {
+  RandomGen random;
+  random.init(1234);
+  vector<RandomGen> streams;
+  for (int i : Range(8))
+    streams.push_back(random.makeChild());
+  vector<RandomGen> copies(streams);
+  vector<int> results(8);
+  vector<function<void()>> tasks;
+  for (int i : Range(8))
+    tasks.push_back([&, i] { results[i] = streams[i].getRandom(1000000); });
+  runInParallel(tasks);
+  for (int i : Range(8))
+    CHECK(results[i] == copies[i].getRandom(1000000));
+  bool thrown = false;
+  try {
+    runInParallel({[] {}, [] { throw string("failed"); }});
+  } catch (string s) {
+    thrown = (s == "failed");
+  }
+  CHECK(thrown);
+}
+
+void testDrawList() {
+  DrawList list;
+  list.setGrid(Rectangle(0, 0, 300, 300), Vec2(0, 0), 18, 18);
+  list.addSprite(0, 0, 0, 0, 36, 36, 0, 18, 18);
+  list.addSprite(18, 0, 36, 0, 36, 36, 0, 18, 18);
+  list.addSprite(36, 0, 0, 0, 24, 24, 3, -1, -1);
+  CHECKEQ(list.getNumDrawCalls(), 2);
+  list.addFilledRectangle(0, 0, 100, 100, Color::Black);
+  // Covered by the rectangle, so it can't be drawn together with the first two sprites.
+  list.addSprite(0, 0, 0, 0, 36, 36, 0, 18, 18);
+  // Not covered by anything added after the other sprite with texture 3.
+  list.addSprite(200, 200, 0, 0, 24, 24, 3, -1, -1);
+  CHECKEQ(list.getNumQuads(), 6);
+  CHECKEQ(list.getNumDrawCalls(), 4);
+  list.addOverlay(Rectangle(0, 0, 18, 18), 3, [] (Renderer&) {});
+  CHECKEQ(list.getNumDrawCalls(), 7);
+  list.addSprite(0, 0, 0, 0, 36, 36, 0, 18, 18);
+  CHECKEQ(list.getNumDrawCalls(), 8);
+  list.clear();
+  CHECKEQ(list.getNumQuads(), 0);
+  CHECKEQ(list.getNumDrawCalls(), 0);
+  // Drawing outside of the grid area is checked on the nearest cells inside.
+  list.setGrid(Rectangle(0, 0, 36, 36), Vec2(0, 0), 18, 18);
+  list.addSprite(100, 100, 0, 0, 18, 18, 0, -1, -1);
+  list.addFilledRectangle(200, 0, 220, 10, Color::Black);
+  list.addSprite(100, 100, 0, 0, 18, 18, 0, -1, -1);
+  CHECKEQ(list.getNumDrawCalls(), 2);
+  list.addFilledRectangle(100, 100, 110, 110, Color::Black);
+  list.addSprite(300, 300, 0, 0, 18, 18, 0, -1, -1);
+  CHECKEQ(list.getNumDrawCalls(), 3);
+}
+
+void testViewIndex() {
+  ViewIndex index;
+  CHECK(index.isEmpty());
+  index.insert(ViewObject(ViewId::FLOOR, ViewLayer::FLOOR, "floor"));
+  index.insert(ViewObject(ViewId::GOBLIN, ViewLayer::CREATURE, "goblin").setModifier(ViewObject::POISONED));
+  index.insert(ViewObject(ViewId::WALL, ViewLayer::FLOOR, "wall"));
+  CHECK(index.getObject(ViewLayer::FLOOR).id() == ViewId::WALL);
+  CHECK(index.getTopObject(allLayers)->getBareDescription() == "Goblin");
+  index.removeObject(ViewLayer::CREATURE);
+  CHECK(!index.hasObject(ViewLayer::CREATURE));
+  CHECK(index.getTopObject(allLayers)->id() == ViewId::WALL);
+  index.insert(ViewObject(ViewId::GOBLIN, ViewLayer::CREATURE, "goblin").setModifier(ViewObject::POISONED));
+  index.setHighlight(HighlightType::MEMORY);
+  std::stringstream stream;
+  {
+    boost::archive::binary_oarchive output(stream);
+    output << index;
+  }
+  ViewIndex loaded;
+  {
+    boost::archive::binary_iarchive input(stream);
+    input >> loaded;
+  }
+  CHECK(loaded.getObject(ViewLayer::FLOOR).id() == ViewId::WALL);
+  CHECK(loaded.getObject(ViewLayer::CREATURE).getBareDescription() == "Goblin");
+  CHECK(loaded.getObject(ViewLayer::CREATURE).hasModifier(ViewObject::POISONED));
+  CHECK(!loaded.getObject(ViewLayer::CREATURE).hasModifier(ViewObject::BLIND));
+  CHECK(!loaded.hasObject(ViewLayer::ITEM));
+  CHECK(loaded.getHighlight()->type == HighlightType::MEMORY);
+}
+
+void testMapMemory() {
+  MapMemory memory;
+  CHECK(!memory.hasViewIndex(Vec2(100, 100)));
+  memory.addObject(Vec2(3, 4), ViewObject(ViewId::FLOOR, ViewLayer::FLOOR, "floor"));
+  memory.addObject(Vec2(3, 4), ViewObject(ViewId::GOLD, ViewLayer::ITEM, "gold"));
+  memory.addObject(Vec2(100, 100), ViewObject(ViewId::WALL, ViewLayer::FLOOR, "wall"));
+  CHECKEQ(memory.getNumChunks(), 2);
+  CHECK(memory.getViewIndex(Vec2(3, 4)).hasObject(ViewLayer::ITEM));
+  CHECK(!memory.hasViewIndex(Vec2(4, 3)));
+  MapMemory copy(memory);
+  copy.clearSquare(Vec2(3, 4));
+  CHECK(!copy.hasViewIndex(Vec2(3, 4)));
+  CHECK(memory.hasViewIndex(Vec2(3, 4)));
+  CHECK(copy.hasViewIndex(Vec2(100, 100)));
+  std::stringstream stream;
+  {
+    boost::archive::binary_oarchive output(stream);
+    output << memory;
+  }
+  MapMemory loaded;
+  {
+    boost::archive::binary_iarchive input(stream);
+    input >> loaded;
+  }
+  CHECKEQ(loaded.getNumChunks(), 2);
+  CHECK(loaded.getViewIndex(Vec2(3, 4)).getObject(ViewLayer::ITEM).id() == ViewId::GOLD);
+  CHECK(loaded.getViewIndex(Vec2(100, 100)).getObject(ViewLayer::FLOOR).id() == ViewId::WALL);
+  CHECK(!loaded.hasViewIndex(Vec2(4, 3)));
+}
+
+void testVec2Serialization() {
+  vector<Vec2> v { Vec2(0, 0), Vec2(6, -6), Vec2(123, 45) };
+  std::stringstream stream;
+  {
+    boost::archive::binary_oarchive output(stream);
+    output << v;
+  }
+  vector<Vec2> loaded;
+  {
+    boost::archive::binary_iarchive input(stream);
+    input >> loaded;
+  }
+  CHECK(loaded == v);
+}
+
 void testTransform2() {
   vector<int> v { 5, 4, 3, 2, 1};
   vector<string> s { "s5", "s4", "s3", "s2", "s1" };
@@ -334,8 +772,10 @@ void testTransform2() {
 
 int main() {
   Debug::init();
+  Tribe::init();
   testStringConvertion();
   testTimeQueue();
+  testTimeQueueRemoval();
   testRectangleIterator();
   testValueCheck();
   testSplit();
@@ -343,6 +783,19 @@ int main() {
   testAStar();
   testShortestPath2();
   testShortestPathReverse();
+  testFieldOfView();
+  testSquareProperties();
+  testLevelTileCache();
+  testFieldSimulation();
+  testAttributeCache();
+  testSightCache();
+  testFlowFieldCrowd();
+  testProfiler();
+  testRunInParallel();
+  testDrawList();
+  testViewIndex();
+  testMapMemory();
+  testVec2Serialization();
   testRandom();
   testRange();
   testContains();
@@ -3,88 +3,178 @@
 #include "time_queue.h"
 
 
-template <class Archive> 
-void TimeQueue::serialize(Archive& ar, const unsigned int version) { 
-  ar& SVAR(creatures)
-    & SVAR(queue)
-    & SVAR(dead);
-  CHECK_SERIAL;
+template <class Archive>
+void TimeQueue::save(Archive& ar, const unsigned int version) const {
+  vector<Creature*> order = getAllCreatures();
+  ar << BOOST_SERIALIZATION_NVP(creatures)
+     << BOOST_SERIALIZATION_NVP(order);
+}
+
+template <class Archive>
+void TimeQueue::load(Archive& ar, const unsigned int version) {
+  vector<Creature*> order;
+  ar >> BOOST_SERIALIZATION_NVP(creatures)
+     >> BOOST_SERIALIZATION_NVP(order);
+  rebuildHeap(order);
 }
 
 SERIALIZABLE(TimeQueue);
+// serialize() is inline, so other files call save and load directly.
+template void TimeQueue::save(boost::archive::binary_oarchive&, unsigned) const;
+template void TimeQueue::load(boost::archive::binary_iarchive&, unsigned);
 
+TimeQueue::TimeQueue() {}
+
+bool TimeQueue::isBefore(const QElem& e1, const QElem& e2) const {
+  return e1.time < e2.time || (e1.time == e2.time && e1.id < e2.id);
+}
 
-template <class Archive> 
-void TimeQueue::QElem::serialize(Archive& ar, const unsigned int version) {
-  ar& BOOST_SERIALIZATION_NVP(creature)
-    & BOOST_SERIALIZATION_NVP(time);
+void TimeQueue::swapElems(int i, int j) {
+  std::swap(heap[i], heap[j]);
+  handles[heap[i].creature].heapIndex = i;
+  handles[heap[j].creature].heapIndex = j;
 }
 
-SERIALIZABLE(TimeQueue::QElem);
+void TimeQueue::siftUp(int i) {
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!isBefore(heap[i], heap[parent]))
+      return;
+    swapElems(i, parent);
+    i = parent;
+  }
+}
 
-TimeQueue::TimeQueue() : queue([](QElem e1, QElem e2) {
-    return e1.time > e2.time || (e1.time == e2.time && e1.creature->getUniqueId() > e2.creature->getUniqueId());
-}) {}
+void TimeQueue::siftDown(int i) {
+  while (1) {
+    int best = i;
+    for (int child : {2 * i + 1, 2 * i + 2})
+      if (child < heap.size() && isBefore(heap[child], heap[best]))
+        best = child;
+    if (best == i)
+      return;
+    swapElems(i, best);
+    i = best;
+  }
+}
+
+bool TimeQueue::updateTime(int i) {
+  double time = heap[i].creature->getTime();
+  if (time == heap[i].time)
+    return false;
+  heap[i].time = time;
+  siftDown(i);
+  siftUp(i);
+  return true;
+}
+
+void TimeQueue::removeFromHeap(int i) {
+  int last = heap.size() - 1;
+  if (i != last) {
+    swapElems(i, last);
+    heap.pop_back();
+    siftDown(i);
+    siftUp(i);
+  } else
+    heap.pop_back();
+}
+
+void TimeQueue::rebuildHeap(const vector<Creature*>& loadedOrder) {
+  heap.clear();
+  handles.clear();
+  order = loadedOrder;
+  numRemoved = 0;
+  for (int i : All(order))
+    handles[order[i]].orderIndex = i;
+  for (int i : All(creatures)) {
+    Creature* c = creatures[i].get();
+    Handle& handle = handles.at(c);
+    handle.creatureIndex = i;
+    handle.heapIndex = heap.size();
+    heap.push_back({c, c->getTime(), c->getUniqueId()});
+    siftUp(heap.size() - 1);
+  }
+  CHECK(handles.size() == creatures.size() && order.size() == creatures.size());
+}
 
 void TimeQueue::addCreature(PCreature c) {
-  queue.push({c.get(), c->getTime()});
+  Creature* ref = c.get();
+  CHECK(!handles.count(ref)) << "Creature added twice";
+  handles[ref] = {int(creatures.size()), int(heap.size()), int(order.size())};
   creatures.push_back(std::move(c));
+  order.push_back(ref);
+  heap.push_back({ref, ref->getTime(), ref->getUniqueId()});
+  siftUp(heap.size() - 1);
 }
-  
+
 PCreature TimeQueue::removeCreature(Creature* cRef) {
-  int ind = -1;
-  for (int i : All(creatures))
-    if (creatures[i].get() == cRef) {
-      ind = i;
-      break;
-    }
-  CHECK(ind > -1) << "Creature not found";
+  auto handle = handles.find(cRef);
+  CHECK(handle != handles.end()) << "Creature not found";
+  int ind = handle->second.creatureIndex;
+  removeFromHeap(handle->second.heapIndex);
+  order[handle->second.orderIndex] = nullptr;
+  ++numRemoved;
+  handles.erase(handle);
   PCreature ret = std::move(creatures[ind]);
-  creatures.erase(creatures.begin() + ind);
-  dead.insert(ret.get());
+  removeIndex(creatures, ind);
+  if (ind < creatures.size())
+    handles.at(creatures[ind].get()).creatureIndex = ind;
+  if (numRemoved > order.size() / 2)
+    compactOrder();
   return ret;
 }
 
-vector<Creature*> TimeQueue::getAllCreatures() const {
-  vector<Creature*> ret;
-  for (const PCreature& c : creatures)
-    ret.push_back(c.get());
-  return ret;
+void TimeQueue::compactOrder() const {
+  int j = 0;
+  for (Creature* c : order)
+    if (c) {
+      handles.at(c).orderIndex = j;
+      order[j++] = c;
+    }
+  order.resize(j);
+  numRemoved = 0;
 }
 
-void TimeQueue::removeDead() {
-  while (!queue.empty() && dead.count(queue.top().creature))
-    queue.pop();
+vector<Creature*> TimeQueue::getAllCreatures() const {
+  if (numRemoved > 0)
+    compactOrder();
+  return order;
 }
 
-Creature* TimeQueue::getMinCreature() {
+Creature* TimeQueue::getNextCreature() {
   CHECK(creatures.size() > 0);
-  removeDead();
-  QElem elem = queue.top();
-  if (elem.time == elem.creature->getTime())
-    return elem.creature;
-  else {
-    queue.pop();
-    removeDead();
-    queue.push({elem.creature, elem.creature->getTime()});
-    CHECK(queue.top().creature->getTime() == queue.top().time);
-    return queue.top().creature;
-  }
-  /*for (PCreature& c : creatures)
-    if (c->getTime() < min || (c->getTime() == min && c->getUniqueId() < res->getUniqueId())) {
-      res = c.get();
-      min = c->getTime();
-    }*/
+  while (updateTime(0)) {}
+  return heap[0].creature;
 }
 
-Creature* TimeQueue::getNextCreature() {
-  Creature* c = getMinCreature();
-  return c;
+vector<Creature*> TimeQueue::getNextBatch() {
+  double time = getNextCreature()->getTime();
+  vector<QElem> batch;
+  vector<int> stack {0};
+  while (!stack.empty()) {
+    int i = stack.back();
+    stack.pop_back();
+    if (i >= heap.size() || heap[i].time > time)
+      continue;
+    if (heap[i].creature->getTime() != time) {
+      // The element is out of date, fix its position and start over.
+      updateTime(i);
+      return getNextBatch();
+    }
+    batch.push_back(heap[i]);
+    stack.push_back(2 * i + 1);
+    stack.push_back(2 * i + 2);
+  }
+  sort(batch.begin(), batch.end(), [this](const QElem& e1, const QElem& e2) { return isBefore(e1, e2); });
+  vector<Creature*> ret;
+  for (const QElem& elem : batch)
+    ret.push_back(elem.creature);
+  return ret;
 }
 
 double TimeQueue::getCurrentTime() {
-  if (creatures.size() > 0) 
-    return getMinCreature()->getTime();
+  if (creatures.size() > 0)
+    return getNextCreature()->getTime();
   else
     return 0;
 }
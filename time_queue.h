@@ -4,35 +4,61 @@
 #include "util.h"
 #include "creature.h"
 
+/** Schedules creatures by their time. Creatures are kept in an indexed binary heap ordered by time
+  * and unique id, so that removal doesn't require scanning all creatures. The queue assumes that
+  * a creature's time can only increase after it was added. getAllCreatures() returns the creatures
+  * in the order they were added.*/
 class TimeQueue {
   public:
   TimeQueue();
   Creature* getNextCreature();
+
+  /** Returns all creatures that will move at the same time as the next creature, in the order
+    * in which getNextCreature() would return them.*/
+  vector<Creature*> getNextBatch();
+
   vector<Creature*> getAllCreatures() const;
   void addCreature(PCreature c);
   PCreature removeCreature(Creature* c);
   double getCurrentTime();
 
-  template <class Archive> 
-  void serialize(Archive& ar, const unsigned int version);
+  template <class Archive>
+  void save(Archive& ar, const unsigned int version) const;
 
-  SERIAL_CHECKER;
-
-  private:
-  void removeDead();
-  Creature* getMinCreature();
+  template <class Archive>
+  void load(Archive& ar, const unsigned int version);
 
-  vector<PCreature> SERIAL(creatures);
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
 
+  private:
   struct QElem {
     Creature* creature;
     double time;
+    UniqueId id;
+  };
 
-    template <class Archive> 
-    void serialize(Archive& ar, const unsigned int version);
+  struct Handle {
+    int creatureIndex;
+    int heapIndex;
+    /** Index in order.*/
+    int orderIndex;
   };
-  priority_queue<QElem, vector<QElem>, function<bool(QElem, QElem)>> SERIAL(queue);
-  unordered_set<Creature*> SERIAL(dead);
+
+  bool isBefore(const QElem&, const QElem&) const;
+  void swapElems(int, int);
+  void siftUp(int);
+  void siftDown(int);
+  bool updateTime(int heapIndex);
+  void removeFromHeap(int heapIndex);
+  void rebuildHeap(const vector<Creature*>& order);
+  void compactOrder() const;
+
+  vector<PCreature> creatures;
+  vector<QElem> heap;
+  mutable unordered_map<const Creature*, Handle> handles;
+  /** Creatures in the order they were added. Removed ones are left as null until the next getAllCreatures().*/
+  mutable vector<Creature*> order;
+  mutable int numRemoved = 0;
 };
 
 #endif
@@ -1,5 +1,11 @@
 #include "stdafx.h"
 
+#include <mutex>
+#include <condition_variable>
+#ifndef WINDOWS
+#include <pthread.h>
+#endif
+
 #include "util.h"
 
 
@@ -83,8 +89,124 @@ double RandomGen::getDouble(double a, double b) {
   return uniform_real_distribution<double>(a, b)(generator);
 }
 
+RandomGen RandomGen::makeChild() {
+  RandomGen ret;
+  ret.init(getRandom(1000000000));
+  return ret;
+}
+
 RandomGen Random;
 
+namespace {
+
+/** Worker threads that live for the whole program, so that thread_local state like the PathEngine
+  * is kept between batches. The thread that submits a batch works on it too, so batches can be
+  * submitted from inside a task. A fork() waits until the workers are idle.*/
+class ThreadPool {
+  public:
+  ThreadPool() {
+#ifndef WINDOWS
+    forkPool = this;
+    pthread_atfork([] { forkPool->lockForFork(); }, [] { forkPool->lock.unlock(); },
+        [] { forkPool->lock.unlock(); });
+#endif
+    for (int i : Range(max<int>(1, thread::hardware_concurrency()) - 1))
+      workers.emplace_back([this] { workerLoop(); });
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stop = true;
+    }
+    wakeUp.notify_all();
+    for (thread& t : workers)
+      t.join();
+  }
+
+  void run(const vector<function<void()>>& tasks) {
+    Batch batch {&tasks, 0, 0, vector<std::exception_ptr>(tasks.size())};
+    std::unique_lock<std::mutex> guard(lock);
+    batches.push_back(&batch);
+    wakeUp.notify_all();
+    while (batch.next < tasks.size())
+      runTask(guard, batch);
+    finished.wait(guard, [&] { return batch.done == tasks.size(); });
+    guard.unlock();
+    for (auto& error : batch.errors)
+      if (error)
+        std::rethrow_exception(error);
+  }
+
+  private:
+  struct Batch {
+    const vector<function<void()>>* tasks;
+    int next;
+    int done;
+    vector<std::exception_ptr> errors;
+  };
+
+  // Takes the next task of the batch and runs it with the lock released.
+  void runTask(std::unique_lock<std::mutex>& guard, Batch& batch) {
+    int i = batch.next++;
+    if (batch.next == batch.tasks->size())
+      batches.erase(find(batches.begin(), batches.end(), &batch));
+    ++numRunning;
+    guard.unlock();
+    try {
+      (*batch.tasks)[i]();
+    } catch (...) {
+      batch.errors[i] = std::current_exception();
+    }
+    guard.lock();
+    --numRunning;
+    if (++batch.done == batch.tasks->size() || numRunning == 0)
+      finished.notify_all();
+  }
+
+  // The child process has only the forking thread, so no task may be running and the lock has to be
+  // free. Mustn't be called from inside a task, which would wait for itself.
+  void lockForFork() {
+    std::unique_lock<std::mutex> guard(lock);
+    finished.wait(guard, [this] { return batches.empty() && numRunning == 0; });
+    guard.release();
+  }
+
+  void workerLoop() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (1) {
+      wakeUp.wait(guard, [this] { return stop || !batches.empty(); });
+      if (stop)
+        return;
+      runTask(guard, *batches.front());
+    }
+  }
+
+  std::mutex lock;
+  std::condition_variable wakeUp;
+  std::condition_variable finished;
+  deque<Batch*> batches;
+  int numRunning = 0;
+  bool stop = false;
+  vector<thread> workers;
+  static ThreadPool* forkPool;
+};
+
+ThreadPool* ThreadPool::forkPool = nullptr;
+
+}
+
+void runInParallel(const vector<function<void()>>& tasks) {
+  if (tasks.empty())
+    return;
+  if (tasks.size() == 1) {
+    tasks[0]();
+    return;
+  }
+  static ThreadPool pool;
+  pool.run(tasks);
+}
+
 template string convertToString<int>(const int&);
 template string convertToString<size_t>(const size_t&);
 template string convertToString<char>(const char&);
@@ -488,6 +610,10 @@ bool Rectangle::intersects(const Rectangle& other) const {
   return max(px, other.px) < min(kx, other.kx) && max(py, other.py) < min(ky, other.ky);
 }
 
+bool Rectangle::operator == (const Rectangle& other) const {
+  return px == other.px && py == other.py && kx == other.kx && ky == other.ky;
+}
+
 Rectangle Rectangle::intersection(const Rectangle& other) const {
   return Rectangle(max(px, other.px), max(py, other.py), min(kx, other.kx), min(ky, other.ky));
 }
@@ -130,6 +130,14 @@ class Vec2 {
 
 string getCardinalName(Dir d);
 
+/** Hash for unordered containers keyed by pairs, std::hash has no specialization for them.*/
+struct PairHash {
+  template <class T, class U>
+  size_t operator()(const pair<T, U>& obj) const {
+    return std::hash<T>()(obj.first) * 79146198 + std::hash<U>()(obj.second);
+  }
+};
+
 namespace std {
 
 template <> struct hash<Vec2> {
@@ -183,6 +191,7 @@ class Rectangle {
   Vec2 getBottomLeft() const;
 
   bool intersects(const Rectangle& other) const;
+  bool operator == (const Rectangle& other) const;
   Rectangle intersection(const Rectangle& other) const;
 
   Rectangle minusMargin(int margin) const;
@@ -264,6 +273,10 @@ class RandomGen {
   double getDouble(double a, double b);
   bool roll(int chance);
 
+  /** Returns a new generator seeded from this one. Each task that runs in parallel draws from its own,
+    * so the results don't depend on the order in which the tasks run.*/
+  RandomGen makeChild();
+
   private:
   void makeShuffle(string id, int min, int max);
   default_random_engine generator;
@@ -278,6 +291,12 @@ class RandomGen {
 
 extern RandomGen Random;
 
+/** Runs the tasks on a pool of as many threads as there are cores, and returns when all of them are finished.
+  * The pool's threads are started on the first call and kept until the program exits.
+  * If a task throws, the exception is thrown again here. The tasks can't touch global game state,
+  * including Random.*/
+void runInParallel(const vector<function<void()>>& tasks);
+
 inline Debug& operator <<(Debug& d, Rectangle rect) {
   return d << "(" << rect.getPX() << "," << rect.getPY() << ") (" << rect.getKX() << "," << rect.getKY() << ")";
 }
@@ -735,8 +754,12 @@ vector<T> concat(const vector<vector<T>>& vectors) {
   return ret;
 }
 
-template<class T>
-inline T& operator <<(T& d, Vec2 msg) {
+// Not a template, because boost archives would use it instead of Vec2::serialize().
+inline Debug& operator <<(Debug& d, Vec2 msg) {
+  return d << "(" << msg.x << "," << msg.y << ")";
+}
+
+inline std::ostream& operator <<(std::ostream& d, Vec2 msg) {
   return d << "(" << msg.x << "," << msg.y << ")";
 }
 
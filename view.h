@@ -1,6 +1,8 @@
 #ifndef _VIEW_H
 #define _VIEW_H
 
+#include <atomic>
+
 #include "util.h"
 #include "action.h"
 #include "collective_action.h"
@@ -22,8 +24,10 @@ class View {
 
   enum SplashType { CREATING, LOADING, SAVING };
 
-  /** Displays a splash screen in an active loop until \paramname{ready} is set to true in another thread.*/
-  virtual void displaySplash(SplashType type, bool& ready) = 0;
+  /** Displays a splash screen in an active loop until \paramname{ready} is set to true in another thread.
+    * If \paramname{progress} is given, the fraction of the work done that it points to is shown as well.*/
+  virtual void displaySplash(SplashType type, const std::atomic<bool>& ready,
+      const std::atomic<double>* progress = nullptr) = 0;
 
   /** Shutdown routine.*/
   virtual void close() = 0;
@@ -5,9 +5,13 @@
 
 template <class Archive> 
 void ViewIndex::serialize(Archive& ar, const unsigned int version) {
-  ar& SVAR(objIndex)
-    & SVAR(objects)
-    & SVAR(highlight);
+  ar& SVAR(usedLayers);
+  for (int i : Range(numLayers))
+    if (usedLayers & (1 << i))
+      ar & boost::serialization::make_nvp("object", objects[i]);
+  ar& SVAR(hasHighlight);
+  if (hasHighlight)
+    ar& SVAR(highlight);
   CHECK_SERIAL;
 }
 
@@ -23,40 +27,35 @@ void ViewIndex::HighlightInfo::serialize(Archive& ar, const unsigned int version
 SERIALIZABLE(ViewIndex::HighlightInfo);
 
 ViewIndex::ViewIndex() {
-  objIndex = vector<int>(allLayers.size(), -1);
 }
+
 void ViewIndex::insert(const ViewObject& obj) {
-  int ind = objIndex[int(obj.layer())];
-  if (ind > -1)
-    objects[ind] = obj;
-  else {
-    objIndex[int(obj.layer())] = objects.size();
-    objects.push_back(obj);
-  }
+  int l = int(obj.layer());
+  CHECK(l < numLayers) << "Layer " << l << " is missing in ViewIndex";
+  objects[l] = obj;
+  usedLayers |= 1 << l;
 }
 
 bool ViewIndex::hasObject(ViewLayer l) const {
-  return objIndex[int(l)] > -1;
+  return usedLayers & (1 << int(l));
 }
 
 void ViewIndex::removeObject(ViewLayer l) {
-  objIndex[int(l)] = -1;
+  usedLayers &= ~(1 << int(l));
 }
 
 bool ViewIndex::isEmpty() const {
-  return objects.empty() && !highlight;
+  return !usedLayers && !hasHighlight;
 }
 
 const ViewObject& ViewIndex::getObject(ViewLayer l) const {
-  int ind = objIndex[int(l)];
-  CHECK(ind > -1) << "No object on layer " << int(l);
-  return objects[ind];
+  CHECK(hasObject(l)) << "No object on layer " << int(l);
+  return objects[int(l)];
 }
 
 ViewObject& ViewIndex::getObject(ViewLayer l) {
-  int ind = objIndex[int(l)];
-  CHECK(ind > -1) << "No object on layer " << int(l);
-  return objects[ind];
+  CHECK(hasObject(l)) << "No object on layer " << int(l);
+  return objects[int(l)];
 }
 
 Optional<ViewObject> ViewIndex::getTopObject(const vector<ViewLayer>& layers) const {
@@ -68,9 +67,12 @@ Optional<ViewObject> ViewIndex::getTopObject(const vector<ViewLayer>& layers) co
 
 void ViewIndex::setHighlight(HighlightType h, double amount) {
   highlight = {h, amount};
+  hasHighlight = true;
 }
 
 Optional<ViewIndex::HighlightInfo> ViewIndex::getHighlight() const {
-  return highlight;
+  if (hasHighlight)
+    return highlight;
+  else
+    return Nothing();
 }
-
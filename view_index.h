@@ -3,6 +3,8 @@
 
 #include "view_object.h"
 
+/** The objects shown on one square, at most one on every layer. Stored inline, so that copying the index
+  * doesn't allocate.*/
 class ViewIndex {
   public:
   ViewIndex();
@@ -31,9 +33,14 @@ class ViewIndex {
 
   SERIAL_CHECKER;
   private:
-  vector<int> SERIAL(objIndex);
-  vector<ViewObject> SERIAL(objects);
-  Optional<HighlightInfo> SERIAL(highlight);
+  /** Number of ViewLayer values, FLOOR_BACKGROUND is the last one.*/
+  static const int numLayers = int(ViewLayer::FLOOR_BACKGROUND) + 1;
+  /** Bit i is set if there is an object on the i-th layer.*/
+  int SERIAL2(usedLayers, 0);
+  /** The object on each layer. Only the ones with their bit set in usedLayers are valid.*/
+  ViewObject objects[numLayers];
+  bool SERIAL2(hasHighlight, false);
+  HighlightInfo SERIAL(highlight);
 };
 
 #endif
@@ -1,14 +1,22 @@
 #include "stdafx.h"
 
+#include <mutex>
+#ifndef WINDOWS
+#include <pthread.h>
+#endif
+
 #include "view_object.h"
 
 template <class Archive> 
 void ViewObject::serialize(Archive& ar, const unsigned int version) {
+  string description;
+  if (Archive::is_saving::value)
+    description = getBareDescription();
   ar& SVAR(bleeding)
     & SVAR(enemyStatus)
     & SVAR(resource_id)
     & SVAR(viewLayer)
-    & SVAR(description)
+    & BOOST_SERIALIZATION_NVP(description)
     & SVAR(burning)
     & SVAR(height)
     & SVAR(modifiers)
@@ -16,28 +24,58 @@ void ViewObject::serialize(Archive& ar, const unsigned int version) {
     & SVAR(defense)
     & SVAR(waterDepth);
   CHECK_SERIAL;
+  if (Archive::is_loading::value)
+    descriptionId = getDescriptionId(description);
 }
 
 SERIALIZABLE(ViewObject);
 
+static std::mutex descriptionMutex;
+
+#ifndef WINDOWS
+// The autosave forks the process, so the child mustn't get the mutex locked by a thread it doesn't have.
+static int descriptionMutexAtFork = pthread_atfork([] { descriptionMutex.lock(); },
+    [] { descriptionMutex.unlock(); }, [] { descriptionMutex.unlock(); });
+#endif
+
+// A deque, so that references to the descriptions stay valid when new ones are added.
+static deque<string>& getDescriptions() {
+  static deque<string> descriptions;
+  return descriptions;
+}
+
+int ViewObject::getDescriptionId(const string& description) {
+  static unordered_map<string, int> ids;
+  std::lock_guard<std::mutex> lock(descriptionMutex);
+  auto it = ids.find(description);
+  if (it != ids.end())
+    return it->second;
+  deque<string>& descriptions = getDescriptions();
+  ids[description] = descriptions.size();
+  descriptions.push_back(description);
+  return descriptions.size() - 1;
+}
+
 ViewObject::ViewObject(ViewId id, ViewLayer l, const string& d)
-    : resource_id(id), viewLayer(l), description(d) {
+    : resource_id(id), viewLayer(l) {
+  string description = d;
   if (islower(description[0]))
     description[0] = toupper(description[0]);
+  descriptionId = getDescriptionId(description);
 }
 
 ViewObject& ViewObject::setModifier(Modifier mod) {
-  modifiers.insert(mod);
+  modifiers |= 1 << mod;
   return *this;
 }
 
 ViewObject& ViewObject::removeModifier(Modifier mod) {
-  modifiers.erase(mod);
+  modifiers &= ~(1 << mod);
   return *this;
 }
 
 bool ViewObject::hasModifier(Modifier mod) const {
-  return modifiers.count(mod);
+  return modifiers & (1 << mod);
 }
 
 ViewObject& ViewObject::setWaterDepth(double depth) {
@@ -85,8 +123,10 @@ double ViewObject::getHeight() const {
   return height;
 }
 
-string ViewObject::getBareDescription() const {
-  return description;
+const string& ViewObject::getBareDescription() const {
+  CHECK(descriptionId >= 0) << "ViewObject without a description";
+  std::lock_guard<std::mutex> lock(descriptionMutex);
+  return getDescriptions()[descriptionId];
 }
 
 string ViewObject::getDescription(bool stats) const {
@@ -105,9 +145,9 @@ string ViewObject::getDescription(bool stats) const {
   if (hasModifier(PLANNED))
     mods.push_back("planned");
   if (mods.size() > 0)
-    return description + attr + "(" + combine(mods) + ")";
+    return getBareDescription() + attr + "(" + combine(mods) + ")";
   else
-    return description + attr;
+    return getBareDescription() + attr;
 }
 
 void ViewObject::setAttack(int val) {
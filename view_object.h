@@ -39,7 +39,7 @@ class ViewObject {
   double getWaterDepth() const;
 
   string getDescription(bool stats = false) const;
-  string getBareDescription() const;
+  const string& getBareDescription() const;
 
   ViewLayer layer() const;
   ViewId id() const;
@@ -51,18 +51,24 @@ class ViewObject {
   SERIALIZATION_DECL(ViewObject);
 
   private:
-  double SERIAL2(bleeding, 0);
+  /** Returns the index of the description in the list of all descriptions, adding it if it's new.*/
+  static int getDescriptionId(const string&);
+
+  float SERIAL2(bleeding, 0);
   EnemyStatus SERIAL2(enemyStatus, UNKNOWN);
-  set<Modifier> SERIAL(modifiers);
+  /** Bit i is set if the object has the i-th Modifier.*/
+  int SERIAL2(modifiers, 0);
   ViewId SERIAL(resource_id);
   ViewLayer SERIAL(viewLayer);
-  string SERIAL(description);
-  double SERIAL2(burning, false);
-  double SERIAL2(height, 0);
+  /** The description is stored only once for all objects, so that the objects can be copied without any
+    * allocations.*/
+  int descriptionId = -1;
+  float SERIAL2(burning, 0);
+  float SERIAL2(height, 0);
   int SERIAL2(attack, -1);
   int SERIAL2(defense, -1);
   int SERIAL2(level, -1);
-  double SERIAL2(waterDepth, -1);
+  float SERIAL2(waterDepth, -1);
 };
 
 
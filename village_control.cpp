@@ -285,7 +285,7 @@ class TopLevelVillageControl : public VillageControl {
       return NoMove;
     if (c->getLevel() != villain->getLevel())
       return NoMove;
-    if (Optional<Vec2> move = c->getMoveTowards(villain->getKeeper()->getPosition())) 
+    if (Optional<Vec2> move = c->getSharedMoveTowardsMoving(villain->getKeeper()->getPosition())) 
       return {1.0, [this, move, c] () {
         c->move(*move);
       }};
@@ -329,7 +329,7 @@ class DwarfVillageControl : public VillageControl {
     if (!attackTrigger->startedAttack(c))
       return NoMove;
     if (c->getLevel() == villain->getLevel()) {
-      if (Optional<Vec2> move = c->getMoveTowards(villain->getKeeper()->getPosition())) 
+      if (Optional<Vec2> move = c->getSharedMoveTowardsMoving(villain->getKeeper()->getPosition())) 
         return {1.0, [this, move, c] () {
           c->move(*move);
         }};
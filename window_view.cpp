@@ -9,6 +9,7 @@
 #include "location.h"
 #include "renderer.h"
 #include "tile.h"
+#include "profiler.h"
 
 using sf::Color;
 using sf::String;
@@ -116,6 +117,8 @@ Rectangle WindowView::getMapViewBounds() const {
 }
 
 Table<Optional<ViewIndex>> objects(maxLevelBounds.getW(), maxLevelBounds.getH());
+/** Whether the squares in objects were visible when they were last computed.*/
+Table<bool> visibleTiles(maxLevelBounds.getW(), maxLevelBounds.getH());
 
 bool tilesOk = true;
 
@@ -164,6 +167,7 @@ void WindowView::reset() {
   mapLayout = &currentTileLayout.normalLayout;
   center = {0, 0};
   gameReady = false;
+  mapCache = Nothing();
 }
 
 static vector<Vec2> splashPositions;
@@ -221,7 +225,8 @@ void displayMenuSplash() {
  // drawAndClearBuffer();
 }
 
-void WindowView::displaySplash(View::SplashType type, bool& ready) {
+void WindowView::displaySplash(View::SplashType type, const std::atomic<bool>& ready,
+    const std::atomic<double>* progress) {
   string text;
   switch (type) {
     case View::CREATING: text = "Creating a new world, just for you..."; break;
@@ -232,7 +237,8 @@ void WindowView::displaySplash(View::SplashType type, bool& ready) {
   CHECK(splash.loadFromFile(splashPaths[Random.getRandom(1, splashPaths.size())]));
   while (!ready) {
     renderer.drawImage((renderer.getWidth() - splash.getSize().x) / 2, (renderer.getHeight() - splash.getSize().y) / 2, splash);
-    renderer.drawText(white, renderer.getWidth() / 2, renderer.getHeight() - 60, text, true);
+    renderer.drawText(white, renderer.getWidth() / 2, renderer.getHeight() - 60,
+        progress ? text + " " + convertToString(int(100 * *progress)) + "%" : text, true);
     renderer.drawAndClearBuffer();
     sf::sleep(sf::milliseconds(30));
     Event event;
@@ -778,8 +784,7 @@ void WindowView::refreshViewInt(const CreatureView* collective, bool flipBuffer)
   switchTiles();
   const Level* level = collective->getLevel();
   collective->refreshGameInfo(gameInfo);
-  for (Vec2 pos : mapLayout->getAllTiles(getMapViewBounds(), maxLevelBounds))
-    objects[pos] = Nothing();
+  Rectangle oldTiles = mapLayout->getAllTiles(getMapViewBounds(), maxLevelBounds);
   if ((center.x == 0 && center.y == 0) || collective->staticPosition())
     center = {double(collective->getPosition().x), double(collective->getPosition().y)};
   Vec2 movePos = Vec2((center.x - mouseOffset.x) * mapLayout->squareWidth(),
@@ -789,9 +794,26 @@ void WindowView::refreshViewInt(const CreatureView* collective, bool flipBuffer)
   movePos.y = max(movePos.y, 0);
   movePos.y = min(movePos.y, int(collective->getLevel()->getBounds().getKY() * mapLayout->squareHeight()));
   mapLayout->updatePlayerPos(movePos);
+  Rectangle tiles = mapLayout->getAllTiles(getMapViewBounds(), maxLevelBounds);
+  bool fullRefresh = !mapCache || mapCache->creatureView != collective || mapCache->level != level
+      || mapCache->layout != mapLayout || !(mapCache->tiles == tiles)
+      || mapCache->viewVersion != collective->getViewVersion();
+  if (fullRefresh) {
+    for (Vec2 pos : oldTiles)
+      objects[pos] = Nothing();
+    if (mapCache)
+      for (Vec2 pos : mapCache->tiles)
+        objects[pos] = Nothing();
+  }
   const MapMemory* memory = &collective->getMemory(); 
-  for (Vec2 pos : mapLayout->getAllTiles(getMapViewBounds(), maxLevelBounds)) 
+  for (Vec2 pos : tiles) 
     if (level->inBounds(pos)) {
+      // Creatures can look different without moving, so their squares are always computed again.
+      bool visible = collective->canSee(pos);
+      if (!fullRefresh && visible == visibleTiles[pos] && !level->isOccupied(pos)
+          && !level->viewChangedSince(pos, mapCache->numViewChanges))
+        continue;
+      visibleTiles[pos] = visible;
       ViewIndex index = collective->getViewIndex(pos);
       if (!index.hasObject(ViewLayer::FLOOR) && !index.hasObject(ViewLayer::FLOOR_BACKGROUND) &&
           !index.isEmpty() && memory->hasViewIndex(pos)) {
@@ -805,6 +827,8 @@ void WindowView::refreshViewInt(const CreatureView* collective, bool flipBuffer)
         index = memory->getViewIndex(pos);
       objects[pos] = index;
     }
+  mapCache = MapCache{collective, level, mapLayout, tiles, level->getNumViewChanges(),
+      collective->getViewVersion()};
   mapGui->setLayout(mapLayout);
   mapGui->setSpriteMode(currentTileLayout.sprites);
   mapGui->updateObjects(memory);
@@ -834,6 +858,8 @@ void WindowView::animateObject(vector<Vec2> trajectory, ViewObject object) {
       index.removeObject(object.layer());
     index.insert(object);
   }
+  // The object stays on the map until the next refresh computes all squares again.
+  mapCache = Nothing();
 }
 
 void WindowView::animation(Vec2 pos, AnimationId id) {
@@ -983,7 +1009,34 @@ void WindowView::drawMap() {
   }
   refreshText();
   fpsCounter.addTick();
-  renderer.drawText(white, renderer.getWidth() - 70, renderer.getHeight() - 30, "FPS " + convertToString(fpsCounter.getFps()));
+  string fpsText = "FPS " + convertToString(fpsCounter.getFps()) + ", draw calls "
+      + convertToString(renderer.getNumDrawCalls());
+  renderer.drawText(white, renderer.getWidth() - 20 - renderer.getTextLength(fpsText), renderer.getHeight() - 30,
+      fpsText);
+#ifndef RELEASE
+  if (profilerOverlay) {
+    vector<string> lines = Profiler::getSummary(8);
+    for (int i : All(lines))
+      renderer.drawText(white, renderer.getWidth() - 20 - renderer.getTextLength(lines[i]),
+          renderer.getHeight() - 30 - 20 * (lines.size() - i), lines[i]);
+  }
+#endif
+}
+
+void WindowView::toggleProfilerTrace() {
+  if (!Profiler::isTracing()) {
+    Profiler::setTracing(true);
+    addMessage("Recording a profiler trace. Press F10 again to stop.");
+  } else {
+    Profiler::setTracing(false);
+    ofstream text("profile.txt");
+    Profiler::dumpText(text);
+    ofstream json("profile.json");
+    Profiler::dumpJson(json);
+    ofstream trace("profile_trace.json");
+    Profiler::dumpChromeTrace(trace);
+    addMessage("Profiler results written to profile.txt, profile.json and profile_trace.json.");
+  }
 }
 
 void WindowView::refreshScreen(bool flipBuffer) {
@@ -1445,6 +1498,8 @@ CollectiveAction WindowView::getClick(double time) {
         switch (event.key.code) {
 #ifndef RELEASE
           case Keyboard::F8: renderer.startMonkey(); break;
+          case Keyboard::F9: profilerOverlay = !profilerOverlay; break;
+          case Keyboard::F10: toggleProfilerTrace(); break;
 #endif
           case Keyboard::Up: center.y -= 2.5; break;
           case Keyboard::Down: center.y += 2.5; break;
@@ -1644,6 +1699,10 @@ Action WindowView::getAction() {
       case Keyboard::Z: unzoom(); return Action(ActionId::IDLE);
       case Keyboard::F1: legendOption = (LegendOption)(1 - (int)legendOption); return Action(ActionId::IDLE);
       case Keyboard::F2: Options::handle(this, OptionSet::GENERAL); return Action(ActionId::IDLE);
+#ifndef RELEASE
+      case Keyboard::F9: profilerOverlay = !profilerOverlay; return Action(ActionId::IDLE);
+      case Keyboard::F10: toggleProfilerTrace(); return Action(ActionId::IDLE);
+#endif
       case Keyboard::Up:
       case Keyboard::Numpad8: return Action(getDirActionId(*key), Vec2(0, -1));
       case Keyboard::Numpad9: return Action(getDirActionId(*key), Vec2(1, -1));
@@ -15,7 +15,8 @@ class WindowView: public View {
   
   virtual void initialize() override;
   virtual void reset() override;
-  virtual void displaySplash(View::SplashType, bool& ready) override;
+  virtual void displaySplash(View::SplashType, const std::atomic<bool>& ready,
+      const std::atomic<double>* progress) override;
 
   virtual void close() override;
 
@@ -126,8 +127,25 @@ class WindowView: public View {
   MapLayout* mapLayout;
   MapGui* mapGui;
 
+  /** What the objects on the map were computed from in the last refresh. Only the squares that may look
+    * different are computed again, unless the map was scrolled or zoomed, or shows something else.*/
+  struct MapCache {
+    const CreatureView* creatureView;
+    const Level* level;
+    const MapLayout* layout;
+    Rectangle tiles;
+    int numViewChanges;
+    int viewVersion;
+  };
+  Optional<MapCache> mapCache;
+
   bool gameReady = false;
 
+  /** Debug builds only: F9 shows the slowest profiler zones next to the FPS counter, F10 starts
+    * and stops a profiler trace, and writes the results to files.*/
+  bool profilerOverlay = false;
+  void toggleProfilerTrace();
+
   struct TileLayouts {
     MapLayout normalLayout;
     MapLayout unzoomLayout;